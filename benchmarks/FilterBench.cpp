@@ -0,0 +1,396 @@
+#include <StronkImage.h>
+#include <benchmark/benchmark.h>
+#include <filesystem>
+
+using namespace StronkImage;
+
+namespace
+{
+    // Deterministic test image: smooth gradients with xorshift noise so every filter sees real texture
+    ImageData syntheticImage(int width, int height)
+    {
+        ImageData image(width, height);
+        uint32_t state = 0x9e3779b9u;
+        for (int y = 0; y < height; ++y)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                state ^= state << 13;
+                state ^= state >> 17;
+                state ^= state << 5;
+                Quantum noise = state & 0x3f;
+                image.rgbPixelData[y * width + x] = {
+                    static_cast<Quantum>((x * 192) / width + noise),
+                    static_cast<Quantum>((y * 192) / height + noise),
+                    static_cast<Quantum>(((x + y) * 96) / (width + height) + noise),
+                    255};
+            }
+        }
+        return image;
+    }
+
+    ImageData syntheticGrayscale(int width, int height)
+    {
+        ImageData image = syntheticImage(width, height);
+        Filter::genGrayscaleData(image);
+        return image;
+    }
+
+    void setPixelsProcessed(benchmark::State &state, int width, int height)
+    {
+        state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(width) * height);
+    }
+
+    std::string scratchPath(const std::string &name)
+    {
+        return (std::filesystem::temp_directory_path() / ("seamcarver_bench_" + name)).string();
+    }
+}
+
+// Arg: sigma in tenths
+static void BM_GaussianBlur(benchmark::State &state)
+{
+    float sigma = state.range(0) / 10.0f;
+    ImageData source = syntheticImage(512, 512);
+    ImageData image(source);
+
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        image = source;
+        state.ResumeTiming();
+
+        Filter::gaussianBlur(image, sigma);
+        benchmark::DoNotOptimize(image.rgbPixelData);
+    }
+    setPixelsProcessed(state, 512, 512);
+}
+BENCHMARK(BM_GaussianBlur)->Arg(5)->Arg(10)->Arg(20)->Arg(30)->Unit(benchmark::kMillisecond);
+
+// Arg: sigma in tenths; the time should stay flat as sigma grows
+static void BM_BoxBlur(benchmark::State &state)
+{
+    float sigma = state.range(0) / 10.0f;
+    ImageData source = syntheticImage(512, 512);
+    ImageData image(source);
+
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        image = source;
+        state.ResumeTiming();
+
+        Filter::gaussianBlur(image, sigma, BlurMode::Box);
+        benchmark::DoNotOptimize(image.rgbPixelData);
+    }
+    setPixelsProcessed(state, 512, 512);
+}
+BENCHMARK(BM_BoxBlur)->Arg(10)->Arg(30)->Arg(50)->Arg(80)->Unit(benchmark::kMillisecond);
+
+// Arg: image side length
+static void BM_GenGrayscaleData(benchmark::State &state)
+{
+    int side = state.range(0);
+    ImageData source = syntheticImage(side, side);
+    ImageData image(source);
+
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        image = source;
+        state.ResumeTiming();
+
+        Filter::genGrayscaleData(image);
+        benchmark::DoNotOptimize(image.rgbPixelData);
+    }
+    setPixelsProcessed(state, side, side);
+}
+BENCHMARK(BM_GenGrayscaleData)->Arg(256)->Arg(1024)->Arg(2048)->Unit(benchmark::kMicrosecond);
+
+// Arg: image side length
+static void BM_GenGrayscale(benchmark::State &state)
+{
+    int side = state.range(0);
+    ImageData image = syntheticImage(side, side);
+
+    for (auto _ : state)
+    {
+        GrayImageData grayscale = Filter::genGrayscale(image);
+        benchmark::DoNotOptimize(grayscale.pixels);
+    }
+    setPixelsProcessed(state, side, side);
+}
+BENCHMARK(BM_GenGrayscale)->Arg(256)->Arg(1024)->Arg(2048)->Unit(benchmark::kMicrosecond);
+
+// Arg: image side length
+static void BM_ConvoluteSobelMatrix(benchmark::State &state)
+{
+    int side = state.range(0);
+    ImageData grayscale = syntheticGrayscale(side, side);
+
+    for (auto _ : state)
+    {
+        ImageData result = Filter::ConvoluteSobelMatrix(grayscale, sobelMatrixX);
+        benchmark::DoNotOptimize(result.rgbPixelData);
+    }
+    setPixelsProcessed(state, side, side);
+}
+BENCHMARK(BM_ConvoluteSobelMatrix)->Arg(256)->Arg(1024)->Arg(2048)->Unit(benchmark::kMicrosecond);
+
+// Arg: image side length
+template <typename Kernel>
+static void BM_ConvolveKernel(benchmark::State &state)
+{
+    int side = state.range(0);
+    GrayImageData grayscale = Filter::genGrayscale(syntheticImage(side, side));
+
+    for (auto _ : state)
+    {
+        GrayImageData result = convolve<Kernel>(grayscale);
+        benchmark::DoNotOptimize(result.pixels);
+    }
+    setPixelsProcessed(state, side, side);
+}
+BENCHMARK_TEMPLATE(BM_ConvolveKernel, Kernels::SobelX)->Arg(256)->Arg(1024)->Arg(2048)->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_ConvolveKernel, Kernels::ScharrY)->Arg(1024)->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_ConvolveKernel, Kernels::Gaussian5)->Arg(1024)->Unit(benchmark::kMicrosecond);
+
+// Arg: image side length, for comparison with the compile-time kernels
+static void BM_ConvoluteSobelMatrixGray(benchmark::State &state)
+{
+    int side = state.range(0);
+    GrayImageData grayscale = Filter::genGrayscale(syntheticImage(side, side));
+
+    for (auto _ : state)
+    {
+        GrayImageData result = Filter::ConvoluteSobelMatrix(grayscale, sobelMatrixX);
+        benchmark::DoNotOptimize(result.pixels);
+    }
+    setPixelsProcessed(state, side, side);
+}
+BENCHMARK(BM_ConvoluteSobelMatrixGray)->Arg(1024)->Unit(benchmark::kMicrosecond);
+
+// Arg: image side length
+static void BM_GenerateEnergyMap(benchmark::State &state)
+{
+    int side = state.range(0);
+    ImageData grayscale = syntheticGrayscale(side, side);
+
+    for (auto _ : state)
+    {
+        ImageData energyMap = Filter::generateEnergyMap(grayscale);
+        benchmark::DoNotOptimize(energyMap.rgbPixelData);
+    }
+    setPixelsProcessed(state, side, side);
+}
+BENCHMARK(BM_GenerateEnergyMap)->Arg(256)->Arg(1024)->Arg(2048)->Unit(benchmark::kMillisecond);
+
+// Args: image side length, 0 = stages run as declared, 1 = reordered and fused plan
+static void BM_EnergyPipeline(benchmark::State &state)
+{
+    int side = state.range(0);
+    ImageData image = syntheticImage(side, side);
+    PipelineOptions options;
+    options.reorder = options.mergeBlurs = options.fuse = state.range(1) != 0;
+    Pipeline energy = Pipeline::energyMap(1.0f);
+
+    for (auto _ : state)
+    {
+        ImageData energyMap = energy.run(image, options);
+        benchmark::DoNotOptimize(energyMap.rgbPixelData);
+    }
+    setPixelsProcessed(state, side, side);
+}
+BENCHMARK(BM_EnergyPipeline)->ArgsProduct({{1024, 2048}, {0, 1}})->Unit(benchmark::kMillisecond);
+
+// Arg: image side length; the single pass that follows a decoder, here over rows that are all present
+static void BM_StreamEnergyMap(benchmark::State &state)
+{
+    int side = state.range(0);
+    ImageData image = syntheticImage(side, side);
+
+    for (auto _ : state)
+    {
+        ImageData energyMap = Filter::streamEnergyMap(image, 1.0f, BlurMode::Exact, [](unsigned int) {});
+        benchmark::DoNotOptimize(energyMap.rgbPixelData);
+    }
+    setPixelsProcessed(state, side, side);
+}
+BENCHMARK(BM_StreamEnergyMap)->Arg(1024)->Arg(2048)->Unit(benchmark::kMillisecond);
+
+// Args: image side length, number of seams
+static void BM_RemoveSeams(benchmark::State &state)
+{
+    int side = state.range(0);
+    int numSeams = state.range(1);
+    ImageData sourceImage = syntheticImage(side, side);
+    ImageData sourceEnergy = Carver::generateEnergyMap(sourceImage);
+    ImageData image(sourceImage);
+    ImageData energyMap(sourceEnergy);
+
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        image = sourceImage;
+        energyMap = sourceEnergy;
+        state.ResumeTiming();
+
+        Filter::removeSeams(image, energyMap, numSeams);
+        benchmark::DoNotOptimize(image.rgbPixelData);
+    }
+    state.counters["seams_per_second"] = benchmark::Counter(static_cast<double>(numSeams) * state.iterations(), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_RemoveSeams)->ArgsProduct({{256, 512, 1024}, {1, 10, 50}})->Unit(benchmark::kMillisecond);
+
+// Args: image side length, number of seams; compare with BM_RemoveSeams
+static void BM_RemoveSeamsGreedy(benchmark::State &state)
+{
+    int side = state.range(0);
+    int numSeams = state.range(1);
+    ImageData sourceImage = syntheticImage(side, side);
+    ImageData sourceEnergy = Carver::generateEnergyMap(sourceImage);
+    ImageData image(sourceImage);
+    ImageData energyMap(sourceEnergy);
+    SeamRegion region;
+    region.seamMode = SeamMode::Greedy;
+
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        image = sourceImage;
+        energyMap = sourceEnergy;
+        state.ResumeTiming();
+
+        Filter::removeSeams(image, energyMap, numSeams, region);
+        benchmark::DoNotOptimize(image.rgbPixelData);
+    }
+    state.counters["seams_per_second"] = benchmark::Counter(static_cast<double>(numSeams) * state.iterations(), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_RemoveSeamsGreedy)->ArgsProduct({{512, 1024}, {10, 50}})->Unit(benchmark::kMillisecond);
+
+// Arg: number of strips; a tall image, so every strip has rows to spare. Compare with BM_RemoveSeams
+static void BM_RemoveSeamsStrips(benchmark::State &state)
+{
+    const int numSeams = 10;
+    ImageData sourceImage = syntheticImage(1024, 4096);
+    ImageData sourceEnergy = Carver::generateEnergyMap(sourceImage);
+    ImageData image(sourceImage);
+    ImageData energyMap(sourceEnergy);
+    SeamRegion region;
+    region.seamMode = SeamMode::Strips;
+    region.numStrips = state.range(0);
+
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        image = sourceImage;
+        energyMap = sourceEnergy;
+        state.ResumeTiming();
+
+        Filter::removeSeams(image, energyMap, numSeams, region);
+        benchmark::DoNotOptimize(image.rgbPixelData);
+    }
+    state.counters["seams_per_second"] = benchmark::Counter(static_cast<double>(numSeams) * state.iterations(), benchmark::Counter::kIsRate);
+
+    // The quality given up: energy of the first seam relative to the exact search
+    uint64_t exactEnergy = Filter::seamEnergy(sourceEnergy, Filter::findVerticalSeam(sourceEnergy));
+    uint64_t stripEnergy = Filter::seamEnergy(sourceEnergy, Filter::findStripSeam(sourceEnergy, region.numStrips));
+    state.counters["energy_vs_exact"] = static_cast<double>(stripEnergy) / std::max<uint64_t>(exactEnergy, 1);
+}
+BENCHMARK(BM_RemoveSeamsStrips)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+// Arg: 0 = JPEG, 1 = PNG
+static void BM_EncodeToMemory(benchmark::State &state)
+{
+    ImageFormat format = state.range(0) == 0 ? ImageFormat::Jpeg : ImageFormat::Png;
+    Image image(syntheticImage(1024, 768));
+
+    for (auto _ : state)
+    {
+        std::vector<unsigned char> encoded = image.writeToMemory(format);
+        benchmark::DoNotOptimize(encoded.data());
+    }
+    setPixelsProcessed(state, 1024, 768);
+}
+BENCHMARK(BM_EncodeToMemory)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+// Arg: 0 = JPEG, 1 = PNG
+static void BM_DecodeFromMemory(benchmark::State &state)
+{
+    ImageFormat format = state.range(0) == 0 ? ImageFormat::Jpeg : ImageFormat::Png;
+    Image source(syntheticImage(1024, 768));
+    std::vector<unsigned char> encoded = source.writeToMemory(format);
+
+    for (auto _ : state)
+    {
+        Image image;
+        image.loadFromMemory(encoded.data(), encoded.size());
+        benchmark::DoNotOptimize(image.getRawImageData().rgbPixelData);
+    }
+    setPixelsProcessed(state, 1024, 768);
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(encoded.size()));
+}
+BENCHMARK(BM_DecodeFromMemory)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+// Arg: 0 = JPEG, 1 = PNG
+static void BM_WriteToFile(benchmark::State &state)
+{
+    std::string path = scratchPath(state.range(0) == 0 ? "write.jpg" : "write.png");
+    Image image(syntheticImage(1024, 768));
+
+    for (auto _ : state)
+    {
+        image.writeToFile(path);
+    }
+    setPixelsProcessed(state, 1024, 768);
+    std::filesystem::remove(path);
+}
+BENCHMARK(BM_WriteToFile)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+// Arg: 0 = JPEG, 1 = PNG
+static void BM_LoadFromFile(benchmark::State &state)
+{
+    std::string path = scratchPath(state.range(0) == 0 ? "load.jpg" : "load.png");
+    Image source(syntheticImage(1024, 768));
+    source.writeToFile(path);
+
+    for (auto _ : state)
+    {
+        Image image(path);
+        benchmark::DoNotOptimize(image.getRawImageData().rgbPixelData);
+    }
+    setPixelsProcessed(state, 1024, 768);
+    std::filesystem::remove(path);
+}
+BENCHMARK(BM_LoadFromFile)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+// Arg: 0 = decode then compute the energy map, 1 = fused pass after the decode, 2 = energy thread following the decoder
+static void BM_LoadWithEnergyMap(benchmark::State &state)
+{
+    std::string path = scratchPath("stream.jpg");
+    Image source(syntheticImage(2048, 1536));
+    source.writeToFile(path);
+    CarveOptions options;
+
+    for (auto _ : state)
+    {
+        ImageData colourImage;
+        ImageData energyMap;
+        if (state.range(0) == 0)
+        {
+            Image image(path);
+            colourImage = std::move(image.getRawImageData());
+            energyMap = Carver::generateEnergyMap(colourImage, options);
+        }
+        else
+        {
+            energyMap = Carver::loadWithEnergyMap(path, colourImage, options, state.range(0));
+        }
+        benchmark::DoNotOptimize(energyMap.rgbPixelData);
+    }
+    setPixelsProcessed(state, 2048, 1536);
+    std::filesystem::remove(path);
+}
+BENCHMARK(BM_LoadWithEnergyMap)->Arg(0)->Arg(1)->Arg(2)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,359 @@
+#include <StronkImage.h>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace StronkImage;
+
+/*
+ * End-to-end benchmark: runs the seamcarve binary over a generated, reproducible corpus plus input.jpg
+ * and reports wall time, peak RSS and an output checksum per case. Every case runs in its own child
+ * process, so peak RSS is that of a single carve and not of the driver.
+ */
+
+namespace
+{
+    // Corpus sizes in megapixels; --max-mp selects how far up the list a run goes
+    const double corpusMegapixels[] = {0.3, 1, 4, 12, 25, 50, 100};
+
+    enum class Pattern
+    {
+        Gradient,
+        Texture,
+        Noise
+    };
+
+    const char *patternName(Pattern pattern)
+    {
+        switch (pattern)
+        {
+        case Pattern::Gradient:
+            return "gradient";
+        case Pattern::Texture:
+            return "texture";
+        default:
+            return "noise";
+        }
+    }
+
+    int triangle(int value, int period)
+    {
+        return std::abs(value % period - period / 2);
+    }
+
+    // Generates a synthetic image row by row, so even the 100 MP entries never exist whole in memory
+    class PatternSource : public ScanlineSource
+    {
+    private:
+        Pattern pattern;
+        unsigned int imageWidth, imageHeight;
+
+    public:
+        PatternSource(Pattern pattern, unsigned int width, unsigned int height)
+            : pattern(pattern), imageWidth(width), imageHeight(height) {}
+
+        unsigned int width() const override { return imageWidth; }
+
+        unsigned int height() const override { return imageHeight; }
+
+        void readRow(unsigned int y, uint8_t *rgba) override
+        {
+            // Integer-only arithmetic keeps the corpus bit-identical on every platform
+            uint32_t state = 0x9e3779b9u ^ (y * 0x85ebca6bu);
+            for (unsigned int x = 0; x < imageWidth; ++x)
+            {
+                uint8_t *pixel = rgba + x * 4;
+                switch (pattern)
+                {
+                case Pattern::Gradient:
+                    pixel[0] = static_cast<uint8_t>(uint64_t(x) * 255 / imageWidth);
+                    pixel[1] = static_cast<uint8_t>(uint64_t(y) * 255 / imageHeight);
+                    pixel[2] = static_cast<uint8_t>(uint64_t(x + y) * 255 / (imageWidth + imageHeight));
+                    break;
+                case Pattern::Texture:
+                    pixel[0] = static_cast<uint8_t>(std::min<unsigned int>(255, triangle(x, 64) * 2 + (((x / 16) ^ (y / 16)) & 1) * 60));
+                    pixel[1] = static_cast<uint8_t>(std::min<unsigned int>(255, triangle(y, 48) * 3 + 40));
+                    pixel[2] = static_cast<uint8_t>(std::min<unsigned int>(255, triangle(x + y, 80) * 2 + (((x / 96) + (y / 96)) & 1) * 90));
+                    break;
+                case Pattern::Noise:
+                    state ^= state << 13;
+                    state ^= state >> 17;
+                    state ^= state << 5;
+                    pixel[0] = static_cast<uint8_t>(state);
+                    pixel[1] = static_cast<uint8_t>(state >> 8);
+                    pixel[2] = static_cast<uint8_t>(state >> 16);
+                    break;
+                }
+                pixel[3] = 255;
+            }
+        }
+    };
+
+    // Hashes a decoded image exactly like hashPixels, without holding it in memory
+    class HashingSink : public ScanlineSink
+    {
+    private:
+        unsigned int imageWidth = 0;
+
+    public:
+        uint64_t hash = fnvOffsetBasis;
+
+        void start(unsigned int width, unsigned int height) override
+        {
+            imageWidth = width;
+            uint32_t size[2] = {width, height};
+            hash = fnv1a(size, sizeof(size));
+        }
+
+        void writeRow(unsigned int, const uint8_t *rgba) override
+        {
+            hash = fnv1a(rgba, static_cast<size_t>(imageWidth) * 4, hash);
+        }
+    };
+
+    struct CorpusImage
+    {
+        std::string name;
+        std::string path;
+        double megapixels;
+    };
+
+    struct CaseResult
+    {
+        CorpusImage image;
+        int numSeams = 0;
+        double wallSeconds = 0.0;
+        long peakRssKiB = 0;
+        int exitStatus = -1;
+        uint64_t checksum = 0;
+    };
+
+    std::vector<CorpusImage> buildCorpus(const std::filesystem::path &corpusDirectory, double maxMegapixels)
+    {
+        std::vector<CorpusImage> corpus;
+        std::filesystem::create_directories(corpusDirectory);
+
+        for (double megapixels : corpusMegapixels)
+        {
+            if (megapixels > maxMegapixels)
+            {
+                break;
+            }
+
+            // 4:3 frames of the requested area
+            unsigned int width = static_cast<unsigned int>(std::lround(std::sqrt(megapixels * 1e6 * 4.0 / 3.0)));
+            unsigned int height = width * 3 / 4;
+
+            for (Pattern pattern : {Pattern::Gradient, Pattern::Texture, Pattern::Noise})
+            {
+                std::ostringstream name;
+                name << patternName(pattern) << "_" << megapixels << "mp";
+                std::filesystem::path path = corpusDirectory / (name.str() + ".png");
+
+                // The corpus is deterministic, so images left by an earlier run are reused
+                if (!std::filesystem::exists(path))
+                {
+                    std::cerr << "generating " << path.string() << " (" << width << "x" << height << ")" << std::endl;
+                    PatternSource source(pattern, width, height);
+                    Image::encodeScanlines(path.string(), source);
+                }
+
+                corpus.push_back({name.str(), std::filesystem::absolute(path).string(), width * double(height) / 1e6});
+            }
+        }
+
+        std::filesystem::path photo = std::filesystem::path(SEAMCARVER_SOURCE_DIR) / "input.jpg";
+        if (std::filesystem::exists(photo))
+        {
+            Image image(photo.string());
+            double megapixels = image.getRawImageData().width * double(image.getRawImageData().height) / 1e6;
+            if (megapixels <= maxMegapixels)
+            {
+                corpus.push_back({"input.jpg", photo.string(), megapixels});
+            }
+        }
+
+        return corpus;
+    }
+
+    // Run one carve in a child process and collect its wall time and peak RSS through wait4
+    CaseResult runCase(const std::string &binary, const CorpusImage &image, int numSeams, const std::filesystem::path &workDirectory)
+    {
+        CaseResult result;
+        result.image = image;
+        result.numSeams = numSeams;
+
+        std::string outputPath = (workDirectory / (image.name + "_" + std::to_string(numSeams) + ".png")).string();
+        std::string seams = std::to_string(numSeams);
+
+        auto started = std::chrono::steady_clock::now();
+        pid_t child = fork();
+        if (child < 0)
+        {
+            throw std::runtime_error("fork failed");
+        }
+
+        if (child == 0)
+        {
+            // seamcarve drops energyMap.jpg in its working directory, so keep that out of the caller's way
+            int devNull = open("/dev/null", O_WRONLY);
+            if (devNull >= 0)
+            {
+                dup2(devNull, STDOUT_FILENO);
+            }
+            if (chdir(workDirectory.c_str()) != 0)
+            {
+                _exit(126);
+            }
+            execl(binary.c_str(), binary.c_str(), image.path.c_str(), outputPath.c_str(), seams.c_str(), static_cast<char *>(nullptr));
+            _exit(127);
+        }
+
+        int status = 0;
+        rusage usage = {};
+        wait4(child, &status, 0, &usage);
+        result.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        result.peakRssKiB = usage.ru_maxrss;
+        result.exitStatus = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+
+        if (result.exitStatus == 0)
+        {
+            HashingSink sink;
+            Image::decodeScanlines(outputPath, sink);
+            result.checksum = sink.hash;
+        }
+        std::filesystem::remove(outputPath);
+
+        return result;
+    }
+
+    std::string toJson(const std::string &binary, double maxMegapixels, const std::vector<CaseResult> &results)
+    {
+        std::ostringstream json;
+        json << std::setprecision(9);
+        json << "{\"seamcarve\":\"" << binary << "\",\"max_megapixels\":" << maxMegapixels << ",\"cases\":[";
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            const CaseResult &result = results[i];
+            json << (i ? "," : "")
+                 << "{\"image\":\"" << result.image.name << "\""
+                 << ",\"megapixels\":" << result.image.megapixels
+                 << ",\"seams\":" << result.numSeams
+                 << ",\"wall_seconds\":" << result.wallSeconds
+                 << ",\"peak_rss_kib\":" << result.peakRssKiB
+                 << ",\"exit_status\":" << result.exitStatus
+                 << ",\"checksum\":\"" << std::hex << std::setw(16) << std::setfill('0') << result.checksum << std::dec << std::setfill(' ') << "\"}";
+        }
+        json << "]}";
+        return json.str();
+    }
+
+    std::vector<int> parseSeamCounts(const std::string &list)
+    {
+        std::vector<int> counts;
+        std::stringstream stream(list);
+        std::string item;
+        while (std::getline(stream, item, ','))
+        {
+            counts.push_back(std::stoi(item));
+        }
+        return counts;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    double maxMegapixels = 4;
+    std::vector<int> seamCounts = {10, 50};
+    std::string corpusDirectory = "macrobench_corpus";
+    std::string jsonPath;
+    std::string binary = SEAMCARVE_BINARY;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--max-mp" && i + 1 < argc)
+        {
+            maxMegapixels = std::stod(argv[++i]);
+        }
+        else if (arg == "--seams" && i + 1 < argc)
+        {
+            seamCounts = parseSeamCounts(argv[++i]);
+        }
+        else if (arg == "--corpus" && i + 1 < argc)
+        {
+            corpusDirectory = argv[++i];
+        }
+        else if (arg == "--json" && i + 1 < argc)
+        {
+            jsonPath = argv[++i];
+        }
+        else if (arg == "--seamcarve" && i + 1 < argc)
+        {
+            binary = argv[++i];
+        }
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--max-mp N] [--seams 10,50] [--corpus dir] [--json report.json] [--seamcarve path]" << std::endl;
+            return 1;
+        }
+    }
+
+    try
+    {
+        std::vector<CorpusImage> corpus = buildCorpus(corpusDirectory, maxMegapixels);
+        std::filesystem::path workDirectory = std::filesystem::absolute(std::filesystem::path(corpusDirectory) / "work");
+        std::filesystem::create_directories(workDirectory);
+
+        std::vector<CaseResult> results;
+        int failures = 0;
+
+        std::cout << std::left << std::setw(20) << "image" << std::right << std::setw(8) << "MP" << std::setw(8) << "seams"
+                  << std::setw(12) << "wall s" << std::setw(12) << "peak MiB" << "  checksum" << std::endl;
+        for (const CorpusImage &image : corpus)
+        {
+            for (int numSeams : seamCounts)
+            {
+                CaseResult result = runCase(binary, image, numSeams, workDirectory);
+                failures += result.exitStatus != 0;
+
+                std::cout << std::left << std::setw(20) << image.name << std::right << std::fixed
+                          << std::setw(8) << std::setprecision(2) << image.megapixels
+                          << std::setw(8) << numSeams
+                          << std::setw(12) << std::setprecision(3) << result.wallSeconds
+                          << std::setw(12) << std::setprecision(1) << result.peakRssKiB / 1024.0 << "  ";
+                if (result.exitStatus == 0)
+                {
+                    std::cout << std::hex << std::setw(16) << std::setfill('0') << result.checksum << std::dec << std::setfill(' ') << std::endl;
+                }
+                else
+                {
+                    std::cout << "failed (" << result.exitStatus << ")" << std::endl;
+                }
+                results.push_back(result);
+            }
+        }
+
+        if (!jsonPath.empty())
+        {
+            std::ofstream(jsonPath) << toJson(binary, maxMegapixels, results) << std::endl;
+        }
+
+        return failures == 0 ? 0 : 1;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+}
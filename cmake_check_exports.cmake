@@ -0,0 +1,28 @@
+# Fails unless every dynamic symbol defined by LIBRARY is part of the C API (stronk_*).
+# Run with: cmake -DNM=<nm> -DLIBRARY=<path> -P cmake_check_exports.cmake
+execute_process(COMMAND ${NM} -D --defined-only ${LIBRARY} OUTPUT_VARIABLE symbols RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "Could not list the symbols of ${LIBRARY}")
+endif()
+
+string(REPLACE "\n" ";" lines "${symbols}")
+set(exported 0)
+foreach(line IN LISTS lines)
+    # nm prints "address type name"; version definitions such as STRONKIMAGE_1 are absolute (A) symbols
+    if(line MATCHES "^[0-9a-fA-F]* ([A-Za-z]) ([^ ]+)$")
+        set(type ${CMAKE_MATCH_1})
+        set(name ${CMAKE_MATCH_2})
+        string(REGEX REPLACE "@.*" "" name "${name}")
+        if(NOT type STREQUAL "A" AND NOT name MATCHES "^stronk_")
+            message(FATAL_ERROR "${LIBRARY} exports ${name}, which is not part of the C API")
+        endif()
+        if(name MATCHES "^stronk_")
+            math(EXPR exported "${exported} + 1")
+        endif()
+    endif()
+endforeach()
+
+if(exported EQUAL 0)
+    message(FATAL_ERROR "${LIBRARY} exports no stronk_ functions")
+endif()
+message(STATUS "${LIBRARY} exports ${exported} stronk_ functions and nothing else")
@@ -0,0 +1,144 @@
+#pragma once
+#ifndef STRONKIMAGE_ADMISSION
+#define STRONKIMAGE_ADMISSION
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+#include <Carver.h>
+#include <Image.h>
+#include <TiledImage.h>
+
+namespace StronkImage
+{
+	// What to do with a job whose estimated peak memory is over the budget
+	enum class OverBudgetPolicy
+	{
+		// Refuse the job
+		Reject,
+
+		// Decode the input at a fraction of its size and carve that
+		Downscale,
+
+		// Carve out of core with TiledCarver, shrinking the band size until it fits
+		Tiled
+	};
+
+	// How an admitted job runs
+	enum class CarveStrategy
+	{
+		InMemory,
+		Downscaled,
+		Tiled
+	};
+
+	// Thrown when a job cannot be made to fit its memory budget
+	class MemoryBudgetExceeded : public std::runtime_error
+	{
+	public:
+		// Estimated peak of the cheapest strategy that was considered
+		uint64_t estimatedBytes;
+		uint64_t budgetBytes;
+
+		MemoryBudgetExceeded(const std::string &what, uint64_t estimatedBytes, uint64_t budgetBytes)
+			: std::runtime_error(what), estimatedBytes(estimatedBytes), budgetBytes(budgetBytes) {}
+	};
+
+	// The way an admitted job will run, with the options adjusted to fit the budget
+	struct AdmissionDecision
+	{
+		CarveStrategy strategy = CarveStrategy::InMemory;
+
+		// Estimated peak bytes of the job as it will run
+		uint64_t estimatedBytes = 0;
+
+		// The input is decoded at 1 / downscale of its width and height; 1 keeps the full size
+		unsigned int downscale = 1;
+
+		// Seams to remove from the decoded image
+		int numSeams = 0;
+
+		// Options for the in-memory and downscaled strategies; columns are scaled with the image
+		CarveOptions options;
+
+		// Options for the tiled strategy, with the band size that fits the budget
+		TiledCarveOptions tiledOptions;
+	};
+
+	/**
+	 * @brief Predicts the peak memory of a carve from the image size and admits it under a budget.
+	 *
+	 * The size comes from Image::probe, which reads only the header, so a job is sized, and if need be
+	 * rejected, downscaled or moved out of core, before any pixel buffer is allocated. Estimates follow the
+	 * buffers each stage keeps alive, rounded to the size classes of the BufferPool, and take the largest
+	 * stage. They cover the decoded images and working buffers, not the code, the stack or a mapped input
+	 * file, whose pages the kernel can drop at any time.
+	 */
+	class MemoryBudget
+	{
+	private:
+		uint64_t maxBytes;
+		OverBudgetPolicy policy;
+
+	public:
+		MemoryBudget(uint64_t maxBytes, OverBudgetPolicy policy = OverBudgetPolicy::Reject);
+
+		uint64_t budgetBytes() const { return maxBytes; }
+
+		/**
+		 * @brief Estimates the peak memory of an in-memory carve: decode, energy map, seams and encode.
+		 *
+		 * @param width The width of the decoded image.
+		 * @param height The height of the decoded image.
+		 * @param options The pipeline options; a mask in the region is counted at this size.
+		 * @param outputFormat The format of the output, which decides the size of the encoded buffer.
+		 * @return The estimated peak in bytes.
+		 */
+		static uint64_t estimateInMemory(unsigned int width, unsigned int height, const CarveOptions &options, ImageFormat outputFormat);
+
+		/**
+		 * @brief Estimates the peak resident memory of TiledCarver::carveFile.
+		 *
+		 * @param width The width of the image.
+		 * @param height The height of the image.
+		 * @param options The tiled options; the resident set is a few bands plus some rows of working buffers.
+		 * @return The estimated peak in bytes.
+		 */
+		static uint64_t estimateTiled(unsigned int width, unsigned int height, const TiledCarveOptions &options);
+
+		/**
+		 * @brief Decides how a job runs within the budget.
+		 *
+		 * A job that fits in memory runs as requested. Otherwise the policy picks the smallest integer
+		 * downscale factor that fits, or the largest band size that fits out of core.
+		 *
+		 * @param input The size of the input, from Image::probe.
+		 * @param numSeams The seams to remove at the full size.
+		 * @param options The pipeline options.
+		 * @param outputFormat The format of the output.
+		 * @param tiledOptions The options to start from if the job moves out of core.
+		 * @return The strategy and the options to run it with.
+		 * @throws MemoryBudgetExceeded if the policy is Reject, or no downscale factor or band size fits, or
+		 * the options cannot be carried over: a mask prevents downscaling, and the tiled path has no regions
+		 * and runs only the exact blur and seam search, without a time budget.
+		 */
+		AdmissionDecision admit(const ImageInfo &input, int numSeams, const CarveOptions &options, ImageFormat outputFormat,
+								const TiledCarveOptions &tiledOptions = TiledCarveOptions()) const;
+
+		/**
+		 * @brief Decodes an image at 1 / factor of its width and height without holding it at full size.
+		 *
+		 * Rows are streamed from the decoder and every factor x factor block is averaged into one pixel, so
+		 * only the downscaled image and one row of sums are allocated. Partial blocks at the right and bottom
+		 * edges average the pixels they have.
+		 *
+		 * @param imageSpec The path of the image.
+		 * @param factor The downscale factor; 1 decodes at full size.
+		 * @return The downscaled image.
+		 */
+		static ImageData loadDownscaled(const std::string &imageSpec, unsigned int factor);
+	};
+}
+
+#endif
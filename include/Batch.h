@@ -0,0 +1,84 @@
+#pragma once
+#ifndef STRONKIMAGE_BATCH
+#define STRONKIMAGE_BATCH
+
+#include <string>
+#include <vector>
+
+#include <Carver.h>
+
+namespace StronkImage
+{
+	// A single image to carve as part of a batch
+	struct BatchJob
+	{
+		std::string inputPath;
+		std::string outputPath;
+		int numSeams;
+	};
+
+	struct BatchOptions
+	{
+		// Worker threads shared by the decode, carve and encode stages (0 = one per hardware thread)
+		unsigned int numThreads = 0;
+
+		// Upper bound on images decoded but not yet written, which bounds peak memory (0 = twice numThreads)
+		unsigned int maxInFlight = 0;
+
+		CarveOptions carveOptions;
+	};
+
+	// Outcome of a single batch job; failures are reported here instead of aborting the batch
+	struct BatchResult
+	{
+		BatchJob job;
+		bool success = false;
+		std::string error;
+		double seconds = 0.0;
+	};
+
+	/**
+	 * @brief The Batch class carves many images in one process.
+	 *
+	 * Decode, carve and encode run as separate stages on a shared thread pool so different images
+	 * overlap in different stages. A new image is only admitted for decoding once the number of
+	 * images in flight drops below BatchOptions::maxInFlight, which provides backpressure and keeps
+	 * peak memory proportional to that limit rather than to the size of the batch.
+	 */
+	class Batch
+	{
+	public:
+		/**
+		 * @brief Reads a manifest file with one "<input> <output> <numSeams>" job per line.
+		 *
+		 * Blank lines and lines starting with '#' are ignored.
+		 *
+		 * @param manifestPath Path of the manifest file.
+		 * @return The jobs in manifest order.
+		 */
+		static std::vector<BatchJob> readManifest(const std::string &manifestPath);
+
+		/**
+		 * @brief Builds one job per JPEG or PNG file found directly inside inputDir.
+		 *
+		 * Outputs keep their file name and are placed in outputDir, which is created if needed.
+		 *
+		 * @param inputDir Directory to scan for images.
+		 * @param outputDir Directory receiving the carved images.
+		 * @param numSeams The number of seams to remove from every image.
+		 * @return The jobs sorted by input path.
+		 */
+		static std::vector<BatchJob> jobsFromDirectory(const std::string &inputDir, const std::string &outputDir, int numSeams);
+
+		/**
+		 * @brief Runs every job through the pipelined decode, carve and encode stages.
+		 *
+		 * @param jobs The jobs to run.
+		 * @param options Thread count, in-flight limit and carving options.
+		 * @return One result per job, in the same order as jobs.
+		 */
+		static std::vector<BatchResult> run(const std::vector<BatchJob> &jobs, const BatchOptions &options = BatchOptions());
+	};
+}
+
+#endif
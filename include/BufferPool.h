@@ -0,0 +1,86 @@
+#pragma once
+#ifndef STRONKIMAGE_BUFFERPOOL
+#define STRONKIMAGE_BUFFERPOOL
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace StronkImage
+{
+	// Counters describing how well a BufferPool is recycling memory
+	struct BufferPoolStats
+	{
+		// Acquisitions served from a cached buffer
+		uint64_t hits = 0;
+
+		// Acquisitions that had to go to the system allocator
+		uint64_t misses = 0;
+
+		// Bytes handed out and not yet released, and the highest that figure has been
+		size_t bytesInUse = 0;
+		size_t peakBytesInUse = 0;
+
+		// Bytes held in free lists waiting to be reused
+		size_t bytesCached = 0;
+	};
+
+	/**
+	 * @brief Size-class pool of large, 64-byte aligned buffers.
+	 *
+	 * Requests are rounded up to one of four classes per power of two (at most 25% slack), and released
+	 * buffers are kept on a per-class free list instead of being returned to the heap. ImageData and
+	 * the filter temporaries allocate from the global pool, so the full-size buffers of one pipeline
+	 * stage, seam iteration or image are recycled by the next instead of fragmenting the heap.
+	 */
+	class BufferPool
+	{
+	private:
+		mutable std::mutex mutex;
+		std::unordered_map<size_t, std::vector<void *>> freeLists;
+		size_t maxCachedBytes;
+		BufferPoolStats counters;
+
+	public:
+		// Default limit on bytes kept cached by the global pool
+		static const size_t defaultMaxCachedBytes = size_t(512) << 20;
+
+		// Create a pool that caches at most maxCachedBytes of released buffers
+		explicit BufferPool(size_t maxCachedBytes = defaultMaxCachedBytes);
+
+		// Free every cached buffer
+		~BufferPool();
+
+		BufferPool(const BufferPool &) = delete;
+		BufferPool &operator=(const BufferPool &) = delete;
+
+		// Process-wide pool used by ImageData
+		static BufferPool &global();
+
+		// Round a request up to the size of the class that will serve it
+		static size_t sizeClass(size_t bytes);
+
+		// Get a buffer of at least bytes bytes; the contents are unspecified
+		void *acquire(size_t bytes);
+
+		// Return a buffer obtained from acquire with the same byte count
+		void release(void *buffer, size_t bytes);
+
+		// Free every cached buffer back to the system allocator
+		void trim();
+
+		// Change the cache limit, trimming if the pool is already above it
+		void setMaxCachedBytes(size_t bytes);
+
+		// Snapshot of the pool counters
+		BufferPoolStats stats() const;
+
+		// Running totals of acquisitions made by the calling thread from any pool, for per-stage accounting
+		static uint64_t threadAllocations();
+		static uint64_t threadBytesAllocated();
+	};
+}
+
+#endif
@@ -0,0 +1,82 @@
+#pragma once
+#ifndef STRONKIMAGE_CACHE
+#define STRONKIMAGE_CACHE
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <Carver.h>
+
+namespace StronkImage
+{
+	// Counters describing how well a ResultCache is doing
+	struct CacheStats
+	{
+		uint64_t energyHits = 0;
+		uint64_t energyMisses = 0;
+		uint64_t outputHits = 0;
+		uint64_t outputMisses = 0;
+
+		// Entries deleted to stay under the size limit
+		uint64_t evictions = 0;
+	};
+
+	/**
+	 * @brief Size-bounded on-disk cache of energy maps and carved outputs.
+	 *
+	 * Entries are content addressed: the energy key hashes the encoded input bytes together with the blur
+	 * settings, and the output key adds the seam count, region and output format. A changed input or
+	 * parameter therefore never hits a stale entry, and entries need no invalidation. Reading an entry
+	 * refreshes its modification time, and once the directory grows past its limit the entries with the
+	 * oldest times are deleted first. Entries are written to a temporary file and renamed into place, so
+	 * several processes can share one directory.
+	 */
+	class ResultCache
+	{
+	private:
+		std::string directory;
+		uint64_t maxBytes;
+
+		mutable std::mutex mutex;
+		CacheStats counters;
+
+		std::string entryPath(uint64_t key, const char *extension) const;
+		bool readEntry(const std::string &path, std::vector<unsigned char> &bytes) const;
+		void writeEntry(const std::string &path, const void *data, size_t size);
+
+	public:
+		// Default limit on the total size of the cache directory
+		static const uint64_t defaultMaxBytes = uint64_t(1) << 30;
+
+		// Use directory for the cache, creating it if needed
+		explicit ResultCache(const std::string &directory, uint64_t maxBytes = defaultMaxBytes);
+
+		// Key of the energy map of an encoded input image under the given blur settings
+		static uint64_t energyKey(const unsigned char *inputBytes, size_t inputSize, const CarveOptions &options);
+
+		// Key of the carved output derived from an energy key; the region mask is hashed by content
+		static uint64_t outputKey(uint64_t energyKey, int numSeams, const CarveOptions &options, ImageFormat format);
+
+		// Fill energyMap and return true if an energy map is stored under key
+		bool loadEnergy(uint64_t key, ImageData &energyMap);
+
+		// Store an energy map; only its first channel is kept, which holds the whole energy value
+		void storeEnergy(uint64_t key, const ImageData &energyMap);
+
+		// Fill encoded with the stored output image and return true if one is stored under key
+		bool loadOutput(uint64_t key, std::vector<unsigned char> &encoded);
+
+		// Store an encoded output image
+		void storeOutput(uint64_t key, const std::vector<unsigned char> &encoded);
+
+		// Delete the least recently used entries until the directory fits in maxBytes
+		void evict();
+
+		// Snapshot of the hit, miss and eviction counters
+		CacheStats stats() const;
+	};
+}
+
+#endif
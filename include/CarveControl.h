@@ -0,0 +1,157 @@
+#pragma once
+#ifndef STRONKIMAGE_CARVECONTROL
+#define STRONKIMAGE_CARVECONTROL
+
+#include <atomic>
+#include <exception>
+#include <functional>
+
+namespace StronkImage
+{
+	// Pipeline stage a carve is currently in
+	enum class CarveStage
+	{
+		Idle,
+		Blur,
+		Grayscale,
+		Energy,
+		Seams,
+		Resample
+	};
+
+	// Name of a stage for reports, such as "seams"
+	const char *carveStageName(CarveStage stage);
+
+	// Snapshot of a carve's progress
+	struct CarveProgress
+	{
+		CarveStage stage = CarveStage::Idle;
+
+		// Seams removed so far and seams requested by the running seam loop
+		int seamsDone = 0;
+		int seamsTotal = 0;
+	};
+
+	// Thrown from the pipeline at the next checkpoint after CarveControl::cancel(). It does not derive from
+	// std::runtime_error, so the handlers the filters use for search failures never swallow it.
+	class CarveCancelled : public std::exception
+	{
+	public:
+		const char *what() const noexcept override { return "Carve cancelled"; }
+	};
+
+	/**
+	 * @brief Cancellation token and progress counters for one carve.
+	 *
+	 * Install it on the carving thread with CarveControlScope. The filters then poll it once per band of
+	 * checkpointRows rows and once per seam, and throw CarveCancelled after cancel() has been called.
+	 * Polling is a relaxed atomic load, and progress is kept in relaxed atomics. Any thread can therefore
+	 * call cancel() or read progress() without locking and without slowing the carve. The image being
+	 * carved is left valid but partly carved when a carve is cancelled.
+	 */
+	class CarveControl
+	{
+	private:
+		std::atomic<bool> cancelled{false};
+		std::atomic<int> stage{static_cast<int>(CarveStage::Idle)};
+		std::atomic<int> seamsDone{0};
+		std::atomic<int> seamsTotal{0};
+		std::function<void(const CarveProgress &)> callback;
+
+		static thread_local CarveControl *active;
+
+		friend class CarveControlScope;
+
+	public:
+		// Rows processed between two cancellation checks inside a filter
+		static const unsigned int checkpointRows = 64;
+
+		CarveControl() = default;
+
+		// The callback runs on the carving thread at every stage change and after every seam, so keep it short
+		explicit CarveControl(std::function<void(const CarveProgress &)> callback);
+
+		CarveControl(const CarveControl &) = delete;
+		CarveControl &operator=(const CarveControl &) = delete;
+
+		// Ask the carve to stop at its next checkpoint; safe to call from any thread
+		void cancel() { cancelled.store(true, std::memory_order_relaxed); }
+
+		bool cancelRequested() const { return cancelled.load(std::memory_order_relaxed); }
+
+		// Current stage and seam counts; safe to call from any thread
+		CarveProgress progress() const;
+
+		// Throw CarveCancelled if cancel() has been called
+		void checkpoint() const
+		{
+			if (cancelRequested())
+			{
+				throw CarveCancelled();
+			}
+		}
+
+		// Called by the pipeline as it moves between stages and seams
+		void enterStage(CarveStage newStage);
+		void setSeams(int done, int total);
+
+		// The control installed on the calling thread, or nullptr
+		static CarveControl *current() { return active; }
+	};
+
+	/**
+	 * @brief Installs a CarveControl on the calling thread for the lifetime of the scope.
+	 *
+	 * Scopes nest; the previous control is restored when the scope ends.
+	 */
+	class CarveControlScope
+	{
+	private:
+		CarveControl *previous;
+
+	public:
+		explicit CarveControlScope(CarveControl &control) : previous(CarveControl::active) { CarveControl::active = &control; }
+
+		~CarveControlScope() { CarveControl::active = previous; }
+
+		CarveControlScope(const CarveControlScope &) = delete;
+		CarveControlScope &operator=(const CarveControlScope &) = delete;
+	};
+
+	// Hooks used inside the pipeline; they do nothing unless a CarveControlScope is active on this thread
+
+	inline void carveCheckpoint()
+	{
+		if (CarveControl *control = CarveControl::current())
+		{
+			control->checkpoint();
+		}
+	}
+
+	// Check for cancellation once every CarveControl::checkpointRows rows
+	inline void carveCheckpoint(unsigned int row)
+	{
+		if (row % CarveControl::checkpointRows == 0)
+		{
+			carveCheckpoint();
+		}
+	}
+
+	inline void reportCarveStage(CarveStage stage)
+	{
+		if (CarveControl *control = CarveControl::current())
+		{
+			control->enterStage(stage);
+		}
+	}
+
+	inline void reportCarveSeams(int done, int total)
+	{
+		if (CarveControl *control = CarveControl::current())
+		{
+			control->setSeams(done, total);
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,132 @@
+#pragma once
+#ifndef STRONKIMAGE_CARVER
+#define STRONKIMAGE_CARVER
+
+#include <chrono>
+
+#include <Filter.h>
+#include <Image.h>
+
+namespace StronkImage
+{
+	/**
+	 * @brief Tunables for the full seam carving pipeline.
+	 */
+	struct CarveOptions
+	{
+		// Sigma of the Gaussian blur applied before computing the energy map
+		float blurSigma = 1.0f;
+
+		// Exact convolution, or the box approximation whose cost does not grow with blurSigma
+		BlurMode blurMode = BlurMode::Exact;
+
+		// Columns and pixels vertical seams may pass through; height reduction ignores it
+		SeamRegion region;
+
+		// Wall-clock budget in seconds for a carve, 0 for none; once it runs out the remaining seams
+		// are replaced by resampling the seam region, so the carve finishes in about the budget plus one
+		// resampling pass; resampling does not honour the region's mask
+		double timeBudgetSeconds = 0.0;
+	};
+
+	// How a carve reached its target size
+	struct CarveResult
+	{
+		// Seams removed by the exact search
+		int exactSeams = 0;
+
+		// Columns or rows removed by resampling after the time budget ran out
+		int resampledSeams = 0;
+	};
+
+	/**
+	 * @brief The Carver class runs the complete blur, grayscale, energy and seam removal pipeline.
+	 *
+	 * This is the single entry point shared by the command line tool and the batch runner so every
+	 * front end carves images exactly the same way.
+	 */
+	class Carver
+	{
+	public:
+		/**
+		 * @brief Computes the energy map used to pick seams for the given colour image.
+		 *
+		 * The colour image is left untouched. The stages run through Pipeline::energyMap, so the blur works on the
+		 * luminance only and no intermediate image is stored.
+		 *
+		 * @param colourImage The ImageData object representing the colour image.
+		 * @param options The pipeline options.
+		 * @return An ImageData object representing the energy map.
+		 */
+		static ImageData generateEnergyMap(const ImageData &colourImage, const CarveOptions &options = CarveOptions());
+
+		/**
+		 * @brief Decodes an image file and computes its energy map while the rows are still arriving.
+		 *
+		 * The decoder runs on the calling thread and a second thread follows it down the image with
+		 * Filter::streamEnergyMap, so the energy map is ready shortly after the last row is decoded. The result
+		 * is identical to decoding the file and then calling generateEnergyMap.
+		 *
+		 * @param imageSpec The path of the image.
+		 * @param colourImage Receives the decoded colour image.
+		 * @param options The pipeline options.
+		 * @param numThreads 2 runs the energy pass on its own thread, 1 runs it after the decode, and 0 picks 2
+		 * when the machine has more than one hardware thread.
+		 * @return An ImageData object representing the energy map.
+		 * @throws std::runtime_error if the file cannot be decoded; CarveCancelled if the installed control is
+		 * cancelled.
+		 */
+		static ImageData loadWithEnergyMap(const std::string &imageSpec, ImageData &colourImage, const CarveOptions &options = CarveOptions(),
+										   unsigned int numThreads = 0);
+
+		/**
+		 * @brief The time by which a carve started now must finish its exact seams.
+		 *
+		 * @param options The pipeline options.
+		 * @return Now plus the time budget, or time_point::max() if there is no budget.
+		 */
+		static std::chrono::steady_clock::time_point deadline(const CarveOptions &options);
+
+		/**
+		 * @brief Removes numSeams vertical seams using an energy map that has already been computed.
+		 *
+		 * Seams are removed exactly until the deadline passes. The rest of the width is then taken out of the
+		 * seam region in one resampling pass.
+		 *
+		 * @param colourImage The ImageData object representing the colour image to carve.
+		 * @param energyMap The energy map of colourImage; it is narrowed together with the image.
+		 * @param numSeams The number of seams to be removed from the image.
+		 * @param options The pipeline options.
+		 * @param deadline No new exact seam is started after this time.
+		 * @return How many seams were removed exactly and how many columns by resampling.
+		 */
+		static CarveResult removeSeams(ImageData &colourImage, ImageData &energyMap, int numSeams, const CarveOptions &options,
+									   std::chrono::steady_clock::time_point deadline);
+
+		/**
+		 * @brief Removes numSeams vertical seams from the colour image in place.
+		 *
+		 * @param colourImage The ImageData object representing the colour image to carve.
+		 * @param numSeams The number of seams to be removed from the image.
+		 * @param options The pipeline options.
+		 * @return How many seams were removed exactly and how many columns by resampling.
+		 */
+		static CarveResult carve(ImageData &colourImage, int numSeams, const CarveOptions &options = CarveOptions());
+
+		/**
+		 * @brief Carves the colour image down to targetWidth x targetHeight in place.
+		 *
+		 * Width is reduced with vertical seams; height is reduced by carving the transposed image.
+		 *
+		 * @param colourImage The ImageData object representing the colour image to carve.
+		 * @param targetWidth The requested width, no larger than the current width.
+		 * @param targetHeight The requested height, no larger than the current height.
+		 * @param options The pipeline options.
+		 * @return The seams removed by both passes; the time budget covers the two passes together.
+		 * @throws std::invalid_argument if a target dimension is zero or larger than the image.
+		 */
+		static CarveResult carveTo(ImageData &colourImage, unsigned int targetWidth, unsigned int targetHeight, const CarveOptions &options = CarveOptions());
+	};
+}
+
+#endif
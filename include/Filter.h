@@ -2,27 +2,96 @@
 #ifndef STRONKIMAGE_FILTER
 #define STRONKIMAGE_FILTER
 
+#include <chrono>
+#include <functional>
 #include <vector>
 
 #include <Image.h>
+#include <GrayImage.h>
+#include <Kernels.h>
 
 namespace StronkImage
 {
-	// SobelMatrixX for horizontal matrix calculation
-	static int sobelMatrixX[3][3] = {
-		{-1, 0, 1},
-		{-2, 0, 2},
-		{-1, 0, 1}};
+	// SobelMatrixX for horizontal matrix calculation, shared with the compile-time kernel
+	inline constexpr const int (&sobelMatrixX)[3][3] = Kernels::SobelX::taps;
 
 	// SobelMatrixY for vertical matrix calculation
-	static int sobelMatrixY[3][3] = {
-		{-1, -2, -1},
-		{0, 0, 0},
-		{1, 2, 1}};
+	inline constexpr const int (&sobelMatrixY)[3][3] = Kernels::SobelY::taps;
+
+	// Fixed-point luminance weights: 0.299, 0.587 and 0.114 scaled by 2^16, chosen to sum to exactly 65536
+	static const uint32_t lumaWeightRed = 19595;
+	static const uint32_t lumaWeightGreen = 38470;
+	static const uint32_t lumaWeightBlue = 7471;
+
+	/**
+	 * @brief Reference luminance conversion shared by every grayscale path.
+	 *
+	 * Computes round(0.299 * R + 0.587 * G + 0.114 * B) in 16.16 fixed point, so results are bit-identical
+	 * on every platform and compiler. Equal channels map to themselves, and 8-bit input never exceeds 255.
+	 */
+	inline uint8_t luma(Quantum red, Quantum green, Quantum blue)
+	{
+		return static_cast<uint8_t>((lumaWeightRed * red + lumaWeightGreen * green + lumaWeightBlue * blue + 32768) >> 16);
+	}
 
-	
     std::vector<std::vector<float>> generateGaussianKernel(int kernelSize, float sigma);
 
+	// Algorithm used by Filter::gaussianBlur
+	enum class BlurMode
+	{
+		// Direct convolution with the sampled Gaussian; cost grows with sigma squared
+		Exact,
+
+		// Three successive box filters computed with running sums; constant cost per pixel for any sigma,
+		// within a few grey levels of Exact from sigma 2 upwards but too coarse below that
+		Box
+	};
+
+	// Seam search used by Filter::removeSeams
+	enum class SeamMode
+	{
+		// Dynamic programming over the whole region; always finds the lowest energy seam
+		Exact,
+
+		// Follows the cheapest of the three cells below from a few of the lowest energy cells of the top row;
+		// O(height) per seam instead of O(width x height), at the cost of seams with more energy
+		Greedy,
+
+		// Dynamic programming over horizontal strips searched in parallel and stitched into one connected
+		// seam; scales with the cores at the cost of slightly more energy where the strips meet
+		Strips
+	};
+
+	/**
+	 * @brief Restricts seam removal to part of an image.
+	 *
+	 * Columns are given in the coordinates of the image passed to removeSeams; the range narrows by one
+	 * column for every seam removed from it. The default region covers the whole image.
+	 */
+	struct SeamRegion
+	{
+		// First column that may lose pixels
+		unsigned int columnBegin = 0;
+
+		// One past the last column that may lose pixels, or 0 for the right edge of the image
+		unsigned int columnEnd = 0;
+
+		// Optional per-pixel mask of the same size as the image; pixels where it is 0 are never removed
+		const GrayImageData *mask = nullptr;
+
+		// Optional seams taken from a similar image, such as the previous video frame; seam i is only
+		// searched within bandRadius columns of guides[i], and seams past the end of the list search freely
+		const std::vector<std::vector<int>> *guides = nullptr;
+		unsigned int bandRadius = 8;
+
+		// How each seam is searched for; guides only apply to SeamMode::Exact
+		SeamMode seamMode = SeamMode::Exact;
+
+		// Strips for SeamMode::Strips, or 0 for one per hardware thread; images too short to give every
+		// strip Filter::minimumStripRows rows get fewer
+		unsigned int numStrips = 0;
+	};
+
 	/**
 	 * @brief The Filter class provides various image filtering operations.
 	 */
@@ -39,8 +108,44 @@ namespace StronkImage
 		 * @param sourceImage The input ImageData object to be blurred.
 		 * @param sigmaValue The sigma value to be used for the Gaussian blur filter. If sigmaValue is NULL, the default
 		 *                  sigma value of 1.0 is used.
+		 * @param mode BlurMode::Box approximates the Gaussian with three box filters whose widths match its variance.
+		 *             Its cost does not depend on sigma, and it stays within a few grey levels of BlurMode::Exact.
+		 */
+		static void gaussianBlur(ImageData &sourceImage, float sigmaValue = 1.0, BlurMode mode = BlurMode::Exact);
+
+		/**
+		 * @brief Applies the Gaussian blur to a single-channel image.
+		 *
+		 * Exact mode uses the separable form of the kernel, so it costs 2 * kernelSize taps per pixel instead of
+		 * kernelSize squared, and keeps only kernelSize rows of intermediate values.
+		 *
+		 * @param grayscaleImage The single-channel image to be blurred in place.
+		 * @param sigmaValue The sigma value of the Gaussian; zero leaves the image unchanged.
+		 * @param mode The blur implementation, as for the colour overload.
+		 */
+		static void gaussianBlur(GrayImageData &grayscaleImage, float sigmaValue = 1.0, BlurMode mode = BlurMode::Exact);
+
+		/**
+		 * @brief Returns the blurred luminance of a colour image.
+		 *
+		 * The grayscale conversion is fused into the blur: each colour row is converted as the blur loads it, so
+		 * the colour image is read once, only one channel is blurred, and no intermediate image is stored. The
+		 * result matches genGrayscale followed by the single-channel gaussianBlur.
+		 *
+		 * @param colourImage The colour image, left unchanged.
+		 * @param sigmaValue The sigma value of the Gaussian; zero returns the plain luminance.
+		 * @param mode The blur implementation, as for gaussianBlur.
+		 * @return A GrayImageData object holding the blurred luminance.
+		 */
+		static GrayImageData blurredGrayscale(const ImageData &colourImage, float sigmaValue = 1.0, BlurMode mode = BlurMode::Exact);
+
+		/**
+		 * @brief Widths of the three box filters whose combined variance is closest to sigma squared.
+		 *
+		 * @param sigma The standard deviation of the Gaussian to approximate.
+		 * @return Three odd widths, in the order they are applied.
 		 */
-		static void gaussianBlur(ImageData &sourceImage, float sigmaValue = 1.0);
+		static std::vector<int> boxBlurWidths(float sigma);
 
 		/**
 		 * @brief Convolute the current sobel matrix over the provided grayscale pixel data.
@@ -54,7 +159,20 @@ namespace StronkImage
 		 * @param matrix The 3x3 Sobel filter matrix to be used for convolution.
 		 * @return A new ImageData object representing the convoluted image.
 		 */
-		static ImageData ConvoluteSobelMatrix(ImageData &sourceImage, int matrix[3][3]);
+		static ImageData ConvoluteSobelMatrix(ImageData &sourceImage, const int matrix[3][3]);
+
+		/**
+		 * @brief Convolute a 3x3 matrix over a single-channel grayscale image.
+		 *
+		 * Borders are handled by clamping to the nearest edge pixel and results are clamped to [0, 255].
+		 * This is the path for matrices only known at run time; convolve() in Kernels.h is much faster
+		 * for the fixed kernels.
+		 *
+		 * @param grayscaleImage The single-channel grayscale image to be convoluted.
+		 * @param matrix The 3x3 filter matrix to be used for convolution.
+		 * @return A new GrayImageData object representing the convoluted image.
+		 */
+		static GrayImageData ConvoluteSobelMatrix(const GrayImageData &grayscaleImage, const int matrix[3][3]);
 
 		/**
 		 * @brief Changes the image passed in into a grayscale image.
@@ -66,17 +184,57 @@ namespace StronkImage
 		 */
 		static void genGrayscaleData(ImageData &colourImage);
 
+		/**
+		 * @brief Returns the luminance of a colour image as a single-channel image.
+		 *
+		 * Uses the same fixed-point luma() conversion as genGrayscaleData but writes one byte per pixel and
+		 * leaves the colour image untouched, so the pipeline converts to grayscale exactly once per image.
+		 *
+		 * @param colourImage The ImageData object representing the color image.
+		 * @return A GrayImageData object holding the luminance of every pixel.
+		 */
+		static GrayImageData genGrayscale(const ImageData &colourImage);
+
 		/**
 		 * @brief Returns energy map of an image as an ImageData structure.
 		 *
-		 * This function takes an ImageData object representing a grayscale image as input and computes an energy
-		 * map of the image. The energy map represents the magnitude of the gradient at each pixel in the image.
-		 * The function returns an ImageData object representing the energy map.
+		 * This function takes an ImageData object as input and computes an energy map of the image. The energy map
+		 * represents the magnitude of the gradient of the luminance at each pixel in the image. The luminance is
+		 * computed row by row inside the gradient pass, so no grayscale copy of the image is stored.
 		 *
-		 * @param sourceImage The ImageData object representing the grayscale image to be used for computing the energy map.
+		 * @param colourImage The ImageData object to be used for computing the energy map, left unchanged.
 		 * @return An ImageData object representing the energy map.
 		 */
-		static ImageData generateEnergyMap(ImageData &sourceImage);
+		static ImageData generateEnergyMap(const ImageData &colourImage);
+
+		/**
+		 * @brief Returns energy map of an image that has already been converted to grayscale.
+		 *
+		 * This is the overload the pipeline uses, so the grayscale conversion is not repeated. Both Sobel
+		 * gradients and their magnitude are computed in one pass over a three-row window, and the result is
+		 * identical to clamping the two convolve() outputs and combining them.
+		 *
+		 * @param grayscaleImage The single-channel grayscale image.
+		 * @return An ImageData object representing the energy map.
+		 */
+		static ImageData generateEnergyMap(const GrayImageData &grayscaleImage);
+
+		/**
+		 * @brief Returns the energy map of a colour image whose rows are still arriving.
+		 *
+		 * Grayscale, blur and both Sobel gradients run as one top-to-bottom pass: each row is converted as it
+		 * is read, the exact blur keeps a window of kernel-height rows and the gradient a window of three, so
+		 * neither the luminance nor the blurred image is stored. Box blurs need the whole channel and store
+		 * the blurred luminance. The result is identical to Carver::generateEnergyMap.
+		 *
+		 * @param colourImage The colour image, already sized; rows are read only after awaitRow returns.
+		 * @param sigmaValue The sigma of the Gaussian blur; zero skips the blur.
+		 * @param mode The blur implementation, as for gaussianBlur.
+		 * @param awaitRow Called with y, in increasing order, before row y is first read; it blocks until the
+		 * row has been written and may throw to abandon the pass.
+		 * @return An ImageData object representing the energy map.
+		 */
+		static ImageData streamEnergyMap(const ImageData &colourImage, float sigmaValue, BlurMode mode, const std::function<void(unsigned int)> &awaitRow);
 
 		/**
 		 * @brief Remove the desired number of seams from the source image provided as required using a minimum
@@ -93,6 +251,112 @@ namespace StronkImage
 		 * @param numSeams The number of seams to be removed from the image.
 		 */
 		static void removeSeams(ImageData &sourceImage, ImageData &energyMap, int numSeams);
+
+		/**
+		 * @brief Remove seams that stay inside a column range and avoid masked pixels.
+		 *
+		 * The search, traceback and cost rows only cover the columns of the region, so per-seam work
+		 * scales with the width of the region rather than the width of the image. Seams are deleted lazily:
+		 * between seams only a byte of energy and the original column of each live pixel are shifted, and the
+		 * image and energy map are compacted once before returning, also when the search throws.
+		 *
+		 * @param sourceImage The ImageData object representing the source image.
+		 * @param energyMap The ImageData object representing the energy map of the source image.
+		 * @param numSeams The number of seams to be removed from the image.
+		 * @param region The columns and pixels that seams may pass through.
+		 * @param removedSeams If given, receives the column of every removed seam in each row, in removal order.
+		 * @param deadline No new seam is started once this time has passed.
+		 * @return The number of seams removed, which is less than numSeams only if the deadline passed.
+		 * @throws std::runtime_error if the region runs out of seams that avoid the mask.
+		 * @throws std::invalid_argument if the energy map or mask does not match the image.
+		 */
+		static int removeSeams(ImageData &sourceImage, ImageData &energyMap, int numSeams, const SeamRegion &region,
+							   std::vector<std::vector<int>> *removedSeams = nullptr,
+							   std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max());
+
+		/**
+		 * @brief Narrows a range of columns by resampling instead of removing seams.
+		 *
+		 * Each output pixel averages the source pixels it covers, weighted by how much of each it covers. The cost
+		 * is one pass over the image whatever the number of columns removed, but content is squeezed evenly rather
+		 * than taken from low energy areas. Columns outside the range are left untouched.
+		 *
+		 * @param sourceImage The ImageData object to narrow in place.
+		 * @param numColumns The number of columns to remove.
+		 * @param columnBegin First column of the range.
+		 * @param columnEnd One past the last column of the range, or 0 for the right edge of the image.
+		 * @throws std::invalid_argument if the range is empty or not wider than numColumns.
+		 */
+		static void resampleWidth(ImageData &sourceImage, unsigned int numColumns, unsigned int columnBegin = 0, unsigned int columnEnd = 0);
+
+		/**
+		 * @brief Finds the lowest energy vertical seam of an energy map.
+		 *
+		 * The forward pass keeps only two rows of path costs and records, for every cell, which of the
+		 * three cells above it the cheapest path came from (two bits per cell). The seam is then recovered
+		 * by following those records from the cheapest bottom cell in a single O(height) walk. The first
+		 * and last rows and columns are excluded from the search, matching the border of the Sobel pass.
+		 *
+		 * @param energyMap The ImageData object representing the energy map; only the red channel is read.
+		 * @return The column of the seam in every row, from top to bottom.
+		 * @throws std::invalid_argument if the energy map is narrower than three columns.
+		 */
+		static std::vector<int> findVerticalSeam(const ImageData &energyMap);
+
+		/**
+		 * @brief Finds a low energy vertical seam greedily in O(height) per start.
+		 *
+		 * Starts from the lowest energy cells of the first searched row and always steps to the cheapest of
+		 * the three cells below, keeping the cheapest of the resulting paths. The seam is connected and
+		 * respects the same borders as findVerticalSeam, but its energy may be higher.
+		 *
+		 * @param energyMap The ImageData object representing the energy map; only the red channel is read.
+		 * @return The column of the seam in every row, from top to bottom.
+		 * @throws std::invalid_argument if the energy map is narrower than three columns.
+		 */
+		static std::vector<int> findGreedySeam(const ImageData &energyMap);
+
+		/**
+		 * @brief Finds a low energy vertical seam by searching horizontal strips in parallel.
+		 *
+		 * The rows are cut into strips, and the forward pass of each strip runs on its own thread as if the
+		 * seam could enter the strip anywhere, noting the column each path entered at. The strips are then
+		 * stitched from the top: a path through a strip joins the cheapest stitched path of the strip above
+		 * that ends within one column of its entry, so the seam stays connected. The paths within a strip
+		 * do not know about the strips above them, so the seam can carry more energy than findVerticalSeam,
+		 * a few percent with a handful of strips on photographs. With one strip it is the same seam.
+		 *
+		 * @param energyMap The ImageData object representing the energy map; only the red channel is read.
+		 * @param numStrips The number of strips, or 0 for one per hardware thread; fewer are used if a strip
+		 * would get less than minimumStripRows rows.
+		 * @return The column of the seam in every row, from top to bottom.
+		 * @throws std::invalid_argument if the energy map is narrower than three columns.
+		 */
+		static std::vector<int> findStripSeam(const ImageData &energyMap, unsigned int numStrips = 0);
+
+		// Fewest rows a strip of findStripSeam is given; below this, stitching costs more than it saves
+		static const unsigned int minimumStripRows = 64;
+
+		/**
+		 * @brief Energy of a seam, as minimised by findVerticalSeam.
+		 *
+		 * The first and last rows are not counted, matching the rows the seam search scores.
+		 *
+		 * @param energyMap The ImageData object representing the energy map; only the red channel is read.
+		 * @param seam The column of the seam in every row.
+		 * @return The summed energy of the seam.
+		 */
+		static uint64_t seamEnergy(const ImageData &energyMap, const std::vector<int> &seam);
+
+		/**
+		 * @brief Returns the transpose of an image, swapping its rows and columns.
+		 *
+		 * Horizontal seams are removed by transposing, removing vertical seams and transposing back.
+		 *
+		 * @param sourceImage The ImageData object to be transposed.
+		 * @return A new ImageData object of size height x width.
+		 */
+		static ImageData transpose(const ImageData &sourceImage);
 	};
 }
 
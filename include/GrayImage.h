@@ -0,0 +1,62 @@
+#pragma once
+#ifndef STRONKIMAGE_GRAYIMAGE
+#define STRONKIMAGE_GRAYIMAGE
+
+#include <cstddef>
+#include <cstdint>
+
+namespace StronkImage
+{
+	/**
+	 * @brief Single-channel 8-bit image used for luminance, gradients and energy.
+	 *
+	 * One byte per pixel instead of the sixteen of ImageData, allocated from the global buffer pool.
+	 */
+	class GrayImageData
+	{
+	private:
+		// Number of pixels the buffer was allocated for
+		size_t pixelCapacity;
+
+		void allocatePixels(size_t pixelCount);
+		void releasePixels();
+
+	public:
+		unsigned int width, height;
+
+		// 1D array of height * width luminance values
+		uint8_t *pixels;
+
+		// Empty image with width and height of 0
+		GrayImageData();
+
+		// Allocate image with given width and height; the contents are unspecified
+		GrayImageData(int width, int height);
+
+		// Allocate image of given size filled with value
+		GrayImageData(int width, int height, uint8_t value);
+
+		GrayImageData(const GrayImageData &other);
+		GrayImageData(GrayImageData &&other) noexcept;
+		~GrayImageData();
+
+		GrayImageData &operator=(const GrayImageData &other);
+		GrayImageData &operator=(GrayImageData &&other) noexcept;
+
+		unsigned int getWidth() const { return width; }
+
+		unsigned int getHeight() const { return height; }
+
+		// Pointer to the first pixel of row y
+		uint8_t *row(unsigned int y) { return pixels + static_cast<size_t>(y) * width; }
+		const uint8_t *row(unsigned int y) const { return pixels + static_cast<size_t>(y) * width; }
+
+		// Get pixel at (x, y) position
+		uint8_t getPixel(int x, int y) const;
+
+		// Set pixel at (x, y) position
+		void setPixel(int x, int y, uint8_t value);
+	};
+}
+
+#endif
@@ -0,0 +1,45 @@
+#pragma once
+#ifndef STRONKIMAGE_HASH
+#define STRONKIMAGE_HASH
+
+#include <cstddef>
+#include <cstdint>
+
+#include <Image.h>
+
+namespace StronkImage
+{
+	// 64-bit FNV-1a parameters
+	static const uint64_t fnvOffsetBasis = 14695981039346656037ULL;
+	static const uint64_t fnvPrime = 1099511628211ULL;
+
+	// Fold size bytes into an FNV-1a hash; pass the previous result as hash to continue a running hash
+	inline uint64_t fnv1a(const void *data, size_t size, uint64_t hash = fnvOffsetBasis)
+	{
+		const unsigned char *bytes = static_cast<const unsigned char *>(data);
+		for (size_t i = 0; i < size; ++i)
+		{
+			hash ^= bytes[i];
+			hash *= fnvPrime;
+		}
+		return hash;
+	}
+
+	// Fingerprint of an image: its size followed by every pixel as 8-bit RGBA, independent of the in-memory layout
+	inline uint64_t hashPixels(const ImageData &imageData)
+	{
+		uint32_t size[2] = {imageData.width, imageData.height};
+		uint64_t hash = fnv1a(size, sizeof(size));
+
+		size_t pixelCount = static_cast<size_t>(imageData.width) * imageData.height;
+		for (size_t i = 0; i < pixelCount; ++i)
+		{
+			const RGBPixelBuf &pixel = imageData.rgbPixelData[i];
+			uint8_t rgba[4] = {static_cast<uint8_t>(pixel.red), static_cast<uint8_t>(pixel.green), static_cast<uint8_t>(pixel.blue), static_cast<uint8_t>(pixel.opacity)};
+			hash = fnv1a(rgba, sizeof(rgba), hash);
+		}
+		return hash;
+	}
+}
+
+#endif
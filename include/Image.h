@@ -4,6 +4,7 @@
 
 #include <string>
 #include <stdexcept>
+#include <vector>
 
 #include <Pixel.h>
 
@@ -12,6 +13,15 @@ namespace StronkImage
 	class ImageData
 	{
 	private:
+		// Number of pixels the buffer was allocated for, which may exceed width * height after a shrink
+		size_t pixelCapacity;
+
+		// Get a buffer for pixelCount pixels from the global buffer pool, reusing the current one if it fits
+		void allocatePixels(size_t pixelCount);
+
+		// Return the buffer to the global buffer pool
+		void releasePixels();
+
 	public:
 		// FIXME: change code to use only getters and setters
 		unsigned int width, height;
@@ -35,9 +45,15 @@ namespace StronkImage
 		// Destructor
 		~ImageData();
 
+		// Move constructor, taking over the other image's buffer
+		ImageData(ImageData &&other) noexcept;
+
 		// Copy operator
 		ImageData &operator=(const ImageData &other);
 
+		// Move operator
+		ImageData &operator=(ImageData &&other) noexcept;
+
 		// Change buffer size for new height and width and set new height and width
 		void resizeBuffer(int newWidth, int newHeight);
 
@@ -51,11 +67,63 @@ namespace StronkImage
 
 		// Set pixel at (x, y) position
 		void setPixel(int x, int y, const RGBPixelBuf &pixel);
+
+		// Remove the pixel at column seam[y] from every row y, compacting the buffer in place
+		void removeSeam(const std::vector<int> &seam);
 	};
 }
 
 namespace StronkImage
 {
+	// Encoded image formats understood by Image
+	enum class ImageFormat
+	{
+		Unknown,
+		Jpeg,
+		Png,
+
+		// Uncompressed and lossless, for intermediate files: PAM (P7) keeps alpha, PPM (P6, or P5 gray when
+		// loading) does not, and Raw is the ImageData pixel buffer behind a 16-byte header in host byte order
+		Pam,
+		Ppm,
+		Raw
+	};
+
+	// Size and format of an encoded image, read from its header without decoding the pixels
+	struct ImageInfo
+	{
+		unsigned int width = 0;
+		unsigned int height = 0;
+		ImageFormat format = ImageFormat::Unknown;
+	};
+
+	// Receives a decoded image one row at a time, as packed 8-bit RGBA
+	class ScanlineSink
+	{
+	public:
+		virtual ~ScanlineSink() = default;
+
+		// Called once with the image size before the first row
+		virtual void start(unsigned int width, unsigned int height) = 0;
+
+		// Row y, top to bottom, of width * 4 bytes
+		virtual void writeRow(unsigned int y, const uint8_t *rgba) = 0;
+	};
+
+	// Supplies an image to an encoder one row at a time, as packed 8-bit RGBA
+	class ScanlineSource
+	{
+	public:
+		virtual ~ScanlineSource() = default;
+
+		virtual unsigned int width() const = 0;
+
+		virtual unsigned int height() const = 0;
+
+		// Fill rgba with the width * 4 bytes of row y; rows are requested top to bottom
+		virtual void readRow(unsigned int y, uint8_t *rgba) = 0;
+	};
+
 	class Image
 	{
 	private:
@@ -75,12 +143,41 @@ namespace StronkImage
 		// Default destructor
 		virtual ~Image();
 
-		// Load image from jpeg or png
+		// Load image from a file in any ImageFormat, chosen by extension; the file is memory mapped, and
+		// PAM, PPM and raw pixels are copied out of the mapping without decoding
 		void loadFromFile(const std::string &imageSpec);
 
-		// Write to file as jpeg or png
+		// Write to file in the format named by the extension, with a single write call
 		bool writeToFile(const std::string &imageSpec);
 
+		// Decode image bytes held in memory, detecting the format from its signature
+		void loadFromMemory(const unsigned char *data, size_t size);
+
+		// Encode to an in-memory image of the given format
+		std::vector<unsigned char> writeToMemory(ImageFormat format);
+
+		// Decode a file row by row into sink, without holding the whole image in memory
+		static void decodeScanlines(const std::string &imageSpec, ScanlineSink &sink);
+
+		// Encode rows from source straight to a file
+		static void encodeScanlines(const std::string &imageSpec, ScanlineSource &source);
+
+		// Read the size of an image from its header only; the file is mapped, so only the header pages are read
+		static ImageInfo probe(const std::string &imageSpec);
+
+		// Read the size of an in-memory image from its header, detecting the format from its signature
+		static ImageInfo probe(const unsigned char *data, size_t size);
+
+		// Pick the encoded format from a file name's extension
+		static ImageFormat formatFromPath(const std::string &imageSpec);
+
+		// Pick the format a file of this name is written in; throws for .pgm, which is only read, since the
+		// writers always produce colour
+		static ImageFormat formatForWriting(const std::string &imageSpec);
+
+		// Detect the encoded format from the leading signature bytes
+		static ImageFormat formatFromSignature(const unsigned char *data, size_t size);
+
 		// Return a raw reference to the local ImageData structure
 		ImageData &getRawImageData();
 
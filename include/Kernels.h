@@ -0,0 +1,223 @@
+#pragma once
+#ifndef STRONKIMAGE_KERNELS
+#define STRONKIMAGE_KERNELS
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+
+#include <GrayImage.h>
+
+namespace StronkImage
+{
+	/**
+	 * @brief Convolution kernels whose size and coefficients are known at compile time.
+	 *
+	 * Each kernel provides size, the square taps, and the divisor applied to the weighted sum. Passing one
+	 * to convolve() produces a fully unrolled loop in which zero taps cost nothing and unit taps skip the
+	 * multiply. Filter::ConvoluteSobelMatrix remains the path for matrices only known at run time.
+	 */
+	namespace Kernels
+	{
+		struct SobelX
+		{
+			static constexpr int size = 3;
+			static constexpr int divisor = 1;
+			static constexpr int taps[3][3] = {
+				{-1, 0, 1},
+				{-2, 0, 2},
+				{-1, 0, 1}};
+		};
+
+		struct SobelY
+		{
+			static constexpr int size = 3;
+			static constexpr int divisor = 1;
+			static constexpr int taps[3][3] = {
+				{-1, -2, -1},
+				{0, 0, 0},
+				{1, 2, 1}};
+		};
+
+		struct ScharrX
+		{
+			static constexpr int size = 3;
+			static constexpr int divisor = 1;
+			static constexpr int taps[3][3] = {
+				{-3, 0, 3},
+				{-10, 0, 10},
+				{-3, 0, 3}};
+		};
+
+		struct ScharrY
+		{
+			static constexpr int size = 3;
+			static constexpr int divisor = 1;
+			static constexpr int taps[3][3] = {
+				{-3, -10, -3},
+				{0, 0, 0},
+				{3, 10, 3}};
+		};
+
+		struct PrewittX
+		{
+			static constexpr int size = 3;
+			static constexpr int divisor = 1;
+			static constexpr int taps[3][3] = {
+				{-1, 0, 1},
+				{-1, 0, 1},
+				{-1, 0, 1}};
+		};
+
+		struct PrewittY
+		{
+			static constexpr int size = 3;
+			static constexpr int divisor = 1;
+			static constexpr int taps[3][3] = {
+				{-1, -1, -1},
+				{0, 0, 0},
+				{1, 1, 1}};
+		};
+
+		// Binomial approximations of a Gaussian with sigma of roughly 0.85 and 1.0
+		struct Gaussian3
+		{
+			static constexpr int size = 3;
+			static constexpr int divisor = 16;
+			static constexpr int taps[3][3] = {
+				{1, 2, 1},
+				{2, 4, 2},
+				{1, 2, 1}};
+		};
+
+		struct Gaussian5
+		{
+			static constexpr int size = 5;
+			static constexpr int divisor = 256;
+			static constexpr int taps[5][5] = {
+				{1, 4, 6, 4, 1},
+				{4, 16, 24, 16, 4},
+				{6, 24, 36, 24, 6},
+				{4, 16, 24, 16, 4},
+				{1, 4, 6, 4, 1}};
+		};
+	}
+
+	namespace detail
+	{
+		// Contribution of tap number Tap, resolved entirely at compile time
+		template <typename Kernel, int Tap>
+		inline int kernelTap(const uint8_t *const *rows, const int *columns)
+		{
+			constexpr int j = Tap / Kernel::size;
+			constexpr int i = Tap % Kernel::size;
+			constexpr int weight = Kernel::taps[j][i];
+
+			if constexpr (weight == 0)
+			{
+				return 0;
+			}
+			else if constexpr (weight == 1)
+			{
+				return rows[j][columns[i]];
+			}
+			else if constexpr (weight == -1)
+			{
+				return -rows[j][columns[i]];
+			}
+			else
+			{
+				return rows[j][columns[i]] * weight;
+			}
+		}
+
+		template <typename Kernel, int... Taps>
+		inline int applyKernel(const uint8_t *const *rows, const int *columns, std::integer_sequence<int, Taps...>)
+		{
+			return (kernelTap<Kernel, Taps>(rows, columns) + ...);
+		}
+
+		// Divide by the kernel's divisor with rounding and clamp to a pixel value
+		template <typename Kernel>
+		inline uint8_t kernelResult(int sum)
+		{
+			if constexpr (Kernel::divisor != 1)
+			{
+				sum = (sum + Kernel::divisor / 2) / Kernel::divisor;
+			}
+			return static_cast<uint8_t>(std::min(std::max(sum, 0), 255));
+		}
+	}
+
+	/**
+	 * @brief Convolves a compile-time kernel over a single-channel image.
+	 *
+	 * Borders clamp to the nearest edge pixel, and results are rounded and clamped to [0, 255], exactly like
+	 * Filter::ConvoluteSobelMatrix. Interior columns skip the clamping entirely.
+	 *
+	 * @tparam Kernel One of the Kernels structs, or any type with the same members.
+	 * @param source The single-channel image to convolve.
+	 * @return A new GrayImageData object holding the result.
+	 */
+	template <typename Kernel>
+	GrayImageData convolve(const GrayImageData &source)
+	{
+		constexpr int size = Kernel::size;
+		constexpr int radius = size / 2;
+		using Taps = std::make_integer_sequence<int, size * size>;
+
+		const int width = source.width;
+		const int height = source.height;
+		GrayImageData result(width, height);
+
+		for (int y = 0; y < height; ++y)
+		{
+			const uint8_t *rows[size];
+			for (int j = 0; j < size; ++j)
+			{
+				rows[j] = source.row(std::clamp(y + j - radius, 0, height - 1));
+			}
+			uint8_t *output = result.row(y);
+
+			int columns[size];
+			auto clampedColumn = [&](int x)
+			{
+				for (int i = 0; i < size; ++i)
+				{
+					columns[i] = std::clamp(x + i - radius, 0, width - 1);
+				}
+				output[x] = detail::kernelResult<Kernel>(detail::applyKernel<Kernel>(rows, columns, Taps()));
+			};
+
+			int interiorEnd = std::max(width - radius, radius);
+			for (int x = 0; x < std::min(radius, width); ++x)
+			{
+				clampedColumn(x);
+			}
+
+			// Interior: offsets are fixed, so the rows are advanced instead of the columns recomputed
+			for (int i = 0; i < size; ++i)
+			{
+				columns[i] = i - radius;
+			}
+			for (int x = radius; x < interiorEnd; ++x)
+			{
+				const uint8_t *shifted[size];
+				for (int j = 0; j < size; ++j)
+				{
+					shifted[j] = rows[j] + x;
+				}
+				output[x] = detail::kernelResult<Kernel>(detail::applyKernel<Kernel>(shifted, columns, Taps()));
+			}
+
+			for (int x = std::max(interiorEnd, std::min(radius, width)); x < width; ++x)
+			{
+				clampedColumn(x);
+			}
+		}
+
+		return result;
+	}
+}
+
+#endif
@@ -0,0 +1,114 @@
+#pragma once
+#ifndef STRONKIMAGE_PIPELINE
+#define STRONKIMAGE_PIPELINE
+
+#include <string>
+#include <vector>
+
+#include <Filter.h>
+#include <Image.h>
+
+namespace StronkImage
+{
+	// Kind of image a pipeline stage reads or writes
+	enum class PixelFormat
+	{
+		// Four channels per pixel, as decoded
+		Colour,
+
+		// One luminance byte per pixel
+		Gray,
+
+		// Gradient magnitude, the input of the seam search
+		Energy
+	};
+
+	/**
+	 * @brief One step of a Pipeline.
+	 *
+	 * Blur keeps the format it is given, Grayscale turns Colour into Gray and Gradient turns Gray into Energy.
+	 * A stage with readsColour set has had the grayscale conversion before it fused into it: it reads
+	 * Colour and converts each row to luminance as it loads it.
+	 */
+	struct PipelineStage
+	{
+		enum class Kind
+		{
+			Blur,
+			Grayscale,
+			Gradient
+		};
+
+		Kind kind;
+
+		// Blur parameters; unused by the other kinds
+		float sigma = 0.0f;
+		BlurMode mode = BlurMode::Exact;
+
+		bool readsColour = false;
+
+		// Name used in plans and reports, such as "grayscale+blur" for a fused stage
+		std::string name() const;
+	};
+
+	// Rewrites Pipeline::plan may apply; the stages are always run in an order that gives the same result
+	// up to rounding
+	struct PipelineOptions
+	{
+		// Move the grayscale conversion in front of blurs, so one channel is blurred instead of three
+		bool reorder = true;
+
+		// Replace adjacent blurs of the same mode with one blur of the combined sigma
+		bool mergeBlurs = true;
+
+		// Fold the grayscale conversion into the stage after it, so the Gray image is never stored
+		bool fuse = true;
+	};
+
+	/**
+	 * @brief A declared sequence of image stages that is planned before it runs.
+	 *
+	 * Stages are listed in the order the caller thinks of them, for example blur, grayscale, gradient. plan()
+	 * follows the pixel format through the list: it drops stages that would do nothing, such as a blur with
+	 * sigma 0 or a grayscale conversion of a Gray image, inserts the conversion a gradient of a Colour image
+	 * needs, and then applies the rewrites enabled in PipelineOptions. run() executes the plan. Only the
+	 * image a stage produces is kept, and the input is copied only when a Colour stage must modify it.
+	 */
+	class Pipeline
+	{
+	private:
+		std::vector<PipelineStage> stages;
+
+	public:
+		Pipeline &blur(float sigma, BlurMode mode = BlurMode::Exact);
+		Pipeline &grayscale();
+		Pipeline &gradient();
+
+		// The stages as declared
+		const std::vector<PipelineStage> &declared() const { return stages; }
+
+		// Blur, grayscale and gradient: the energy map used for seam carving
+		static Pipeline energyMap(float sigma, BlurMode mode = BlurMode::Exact);
+
+		/**
+		 * @brief The stages run() would execute for a Colour input.
+		 *
+		 * @param options The rewrites to apply.
+		 * @return The optimized stages, in execution order.
+		 * @throws std::invalid_argument if a stage follows the gradient.
+		 */
+		std::vector<PipelineStage> plan(const PipelineOptions &options = PipelineOptions()) const;
+
+		/**
+		 * @brief Runs the planned stages on a colour image.
+		 *
+		 * @param colourImage The input, left unchanged.
+		 * @param options The rewrites to apply.
+		 * @return The last stage's image; a Gray result is expanded to four equal channels.
+		 * @throws std::invalid_argument if a stage follows the gradient.
+		 */
+		ImageData run(const ImageData &colourImage, const PipelineOptions &options = PipelineOptions()) const;
+	};
+}
+
+#endif
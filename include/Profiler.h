@@ -0,0 +1,166 @@
+#pragma once
+#ifndef STRONKIMAGE_PROFILER
+#define STRONKIMAGE_PROFILER
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <BufferPool.h>
+
+namespace StronkImage
+{
+	// CPU and kernel events counted while a stage ran, on the calling thread
+	struct StageCounters
+	{
+		uint64_t cycles = 0;
+		uint64_t instructions = 0;
+		uint64_t cacheMisses = 0;
+		uint64_t branchMisses = 0;
+		uint64_t pageFaults = 0;
+	};
+
+	inline StageCounters operator-(const StageCounters &end, const StageCounters &start)
+	{
+		StageCounters counters;
+		counters.cycles = end.cycles - start.cycles;
+		counters.instructions = end.instructions - start.instructions;
+		counters.cacheMisses = end.cacheMisses - start.cacheMisses;
+		counters.branchMisses = end.branchMisses - start.branchMisses;
+		counters.pageFaults = end.pageFaults - start.pageFaults;
+		return counters;
+	}
+
+	// Accumulated cost of one named pipeline stage
+	struct StageProfile
+	{
+		std::string name;
+		uint64_t calls = 0;
+		double seconds = 0.0;
+
+		// Buffers taken from the buffer pool while the stage was running, on the calling thread
+		uint64_t allocations = 0;
+		uint64_t bytesAllocated = 0;
+
+		// Events counted while the stage ran; zero unless counters were enabled on its thread
+		StageCounters counters;
+
+		// Calls that were counted; fewer than calls if a thread could not open its counters
+		uint64_t countedCalls = 0;
+	};
+
+	/**
+	 * @brief Process-wide collector of per-stage timings and allocation counts.
+	 *
+	 * Stages are measured with STRONK_PROFILE_SCOPE, which costs a single relaxed atomic load while
+	 * profiling is disabled and compiles to nothing when STRONKIMAGE_PROFILING is not defined. Times
+	 * are inclusive, so a stage that calls another (energy calling sobel) includes its cost.
+	 *
+	 * Counters add cycles, instructions, cache misses, branch misses and page faults to every scope. They
+	 * come from a perf_event_open group per thread that is opened on the thread's first profiled scope and
+	 * read at the start and end of each one. Events the kernel or the machine does not provide are left out
+	 * of the report, and without any of them the report says why.
+	 */
+	class Profiler
+	{
+	private:
+		static std::atomic<bool> active;
+		static std::atomic<bool> counting;
+
+	public:
+		// Whether scopes were compiled into this build
+		static bool compiledIn();
+
+		// Turn collection on or off at run time
+		static void setEnabled(bool enabled);
+
+		static bool enabled() { return active.load(std::memory_order_relaxed); }
+
+		// Count CPU events around every scope as well; returns false, leaving counting off, if no event can be
+		// opened on the calling thread
+		static bool enableCounters(bool enabled);
+
+		static bool countersEnabled() { return counting.load(std::memory_order_relaxed); }
+
+		// The events being counted, or why there are none
+		static std::string countersStatus();
+
+		// Running totals of the calling thread's counters, opened on first use; false if they cannot be
+		static bool readCounters(StageCounters &counters);
+
+		// Add one measurement to the named stage; counters is null when the scope was not counted
+		static void record(const char *stage, double seconds, uint64_t allocations, uint64_t bytesAllocated,
+						   const StageCounters *counters = nullptr);
+
+		// All stages measured so far, in the order they were first seen
+		static std::vector<StageProfile> snapshot();
+
+		// Forget every measurement
+		static void reset();
+
+		// Human-readable table of the stages and buffer pool counters
+		static std::string summary();
+
+		// The same report as a JSON object
+		static std::string toJson();
+	};
+
+	/**
+	 * @brief Measures the lifetime of a scope and records it under a stage name.
+	 */
+	class ScopedTimer
+	{
+	private:
+		using Clock = std::chrono::steady_clock;
+
+		const char *stage;
+		Clock::time_point started;
+		uint64_t allocationsAtStart;
+		uint64_t bytesAtStart;
+		StageCounters countersAtStart;
+		bool counted;
+
+	public:
+		explicit ScopedTimer(const char *stage)
+			: stage(Profiler::enabled() ? stage : nullptr), counted(false)
+		{
+			if (this->stage)
+			{
+				allocationsAtStart = BufferPool::threadAllocations();
+				bytesAtStart = BufferPool::threadBytesAllocated();
+				counted = Profiler::countersEnabled() && Profiler::readCounters(countersAtStart);
+				started = Clock::now();
+			}
+		}
+
+		~ScopedTimer()
+		{
+			if (stage)
+			{
+				double seconds = std::chrono::duration<double>(Clock::now() - started).count();
+				StageCounters countersAtEnd;
+				counted = counted && Profiler::readCounters(countersAtEnd);
+				StageCounters counters = countersAtEnd - countersAtStart;
+				Profiler::record(stage, seconds, BufferPool::threadAllocations() - allocationsAtStart, BufferPool::threadBytesAllocated() - bytesAtStart,
+								 counted ? &counters : nullptr);
+			}
+		}
+
+		ScopedTimer(const ScopedTimer &) = delete;
+		ScopedTimer &operator=(const ScopedTimer &) = delete;
+	};
+}
+
+#define STRONK_PROFILE_CONCAT_INNER(a, b) a##b
+#define STRONK_PROFILE_CONCAT(a, b) STRONK_PROFILE_CONCAT_INNER(a, b)
+
+#ifdef STRONKIMAGE_PROFILING
+// Time the rest of the enclosing scope as the given stage
+#define STRONK_PROFILE_SCOPE(stage) ::StronkImage::ScopedTimer STRONK_PROFILE_CONCAT(stronkProfileScope, __LINE__)(stage)
+#else
+#define STRONK_PROFILE_SCOPE(stage) ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,96 @@
+#pragma once
+#ifndef STRONKIMAGE_SEQUENCE
+#define STRONKIMAGE_SEQUENCE
+
+#include <string>
+#include <vector>
+
+#include <Carver.h>
+
+namespace StronkImage
+{
+	struct SequenceOptions
+	{
+		// Columns either side of the previous frame's seam searched for the matching seam
+		unsigned int bandRadius = 8;
+
+		// Every keyframeInterval-th frame gets a full search so seams can follow large changes (0 = first frame only)
+		unsigned int keyframeInterval = 30;
+
+		CarveOptions carveOptions;
+	};
+
+	// Counters describing how much work a SequenceCarver saved
+	struct SequenceStats
+	{
+		unsigned int frames = 0;
+
+		// Frames carved with a full seam search
+		unsigned int keyframes = 0;
+
+		// Frames identical to their predecessor, answered from the previous result
+		unsigned int reusedFrames = 0;
+
+		// Time spent carving, excluding decode and encode
+		double seconds = 0.0;
+	};
+
+	/**
+	 * @brief Carves the frames of a clip so consecutive frames lose matching seams.
+	 *
+	 * The first frame, and every keyframe after it, is carved with a full seam search. Every other
+	 * frame searches each seam only within SequenceOptions::bandRadius columns of the same seam in the
+	 * previous frame. That is a fraction of the work of a cold search, and it stops seams jumping
+	 * between frames, which shows up as jitter. A frame identical to its predecessor reuses the
+	 * previous result without computing an energy map.
+	 */
+	class SequenceCarver
+	{
+	private:
+		int numSeams;
+		SequenceOptions options;
+		SequenceStats counters;
+
+		std::vector<std::vector<int>> previousSeams;
+		ImageData previousInput;
+		ImageData previousOutput;
+
+	public:
+		SequenceCarver(int numSeams, const SequenceOptions &options = SequenceOptions());
+
+		/**
+		 * @brief Removes the seams from the next frame of the sequence in place.
+		 *
+		 * @param frame The ImageData object representing the frame to carve.
+		 */
+		void carveFrame(ImageData &frame);
+
+		const SequenceStats &stats() const { return counters; }
+
+		/**
+		 * @brief Expands a printf-style frame pattern such as "frames/%04d.png".
+		 *
+		 * The pattern is parsed rather than passed to printf: it must hold exactly one %d, optionally with a
+		 * zero flag and a width of up to three digits, and may use %% for a literal percent sign.
+		 *
+		 * @throws std::invalid_argument if the pattern has no %d, more than one, or any other conversion.
+		 */
+		static std::string framePath(const std::string &pattern, int index);
+
+		/**
+		 * @brief Loads, carves and writes numFrames numbered frames starting at firstFrame.
+		 *
+		 * @param inputPattern Pattern of the input frame paths.
+		 * @param outputPattern Pattern of the output frame paths.
+		 * @param firstFrame Index of the first frame.
+		 * @param numFrames The number of frames to process.
+		 * @param numSeams The number of seams to remove from every frame.
+		 * @param options Band, keyframe and carving options.
+		 * @return The counters of the run.
+		 */
+		static SequenceStats run(const std::string &inputPattern, const std::string &outputPattern, int firstFrame, int numFrames,
+								 int numSeams, const SequenceOptions &options = SequenceOptions());
+	};
+}
+
+#endif
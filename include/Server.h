@@ -0,0 +1,157 @@
+#pragma once
+#ifndef STRONKIMAGE_SERVER
+#define STRONKIMAGE_SERVER
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <Carver.h>
+#include <ThreadPool.h>
+
+namespace StronkImage
+{
+	// A request to carve an encoded image down to the given dimensions
+	struct CarveRequest
+	{
+		std::vector<unsigned char> imageBytes;
+		unsigned int targetWidth = 0;
+		unsigned int targetHeight = 0;
+		ImageFormat outputFormat = ImageFormat::Png;
+	};
+
+	struct CarveResponse
+	{
+		bool success = false;
+		std::string error;
+		std::vector<unsigned char> imageBytes;
+
+		// Time the server spent on the request, from the last request byte to the first response byte
+		double serverSeconds = 0.0;
+	};
+
+	// Latency figures accumulated over the lifetime of a server
+	struct ServerStats
+	{
+		uint64_t requests = 0;
+		uint64_t failures = 0;
+		double totalSeconds = 0.0;
+		double minSeconds = 0.0;
+		double maxSeconds = 0.0;
+
+		double meanSeconds() const { return requests ? totalSeconds / requests : 0.0; }
+	};
+
+	/**
+	 * @brief The Server class carves images for local clients over a Unix domain socket.
+	 *
+	 * A connection carries any number of framed requests, each holding the encoded image bytes and
+	 * the target dimensions; every request is answered with the encoded result or an error message.
+	 * One thread polls the listening socket and every idle connection, reading request frames without
+	 * blocking. Only a complete frame is handed to the thread pool, which lives as long as the server. The
+	 * worker only frames the response; the same thread writes it out as the client takes it, so idle or
+	 * slow clients never hold a worker and threads and allocator state stay warm between requests. A
+	 * connection is not read while its request is being carved or its response is being sent, so its
+	 * responses keep their order.
+	 */
+	class Server
+	{
+	private:
+		// A connection and the request frame being read from it; defined in server.cpp
+		struct Connection;
+
+		std::string socketPath;
+		int listenFd;
+		std::atomic<bool> running;
+		std::thread pollThread;
+		std::unique_ptr<ThreadPool> pool;
+		CarveOptions carveOptions;
+
+		// Open connections, owned by the poll thread; a connection whose request is being carved is skipped
+		std::map<int, std::unique_ptr<Connection>> connections;
+
+		// Written by workers and stop() to wake the poll thread
+		int wakeFds[2];
+
+		// Connections whose request has been answered, and whether they can take another one
+		std::mutex answeredMutex;
+		std::vector<std::pair<int, bool>> answeredConnections;
+
+		mutable std::mutex statsMutex;
+		ServerStats serverStats;
+
+		void pollLoop();
+		bool readRequest(Connection &connection);
+		bool writeResponse(Connection &connection);
+		void answer(Connection &connection);
+		void wake();
+		void recordLatency(double seconds, bool success);
+
+	public:
+		// Prepare a server for socketPath using numThreads connection workers (0 = one per hardware thread)
+		Server(const std::string &socketPath, unsigned int numThreads = 0, const CarveOptions &carveOptions = CarveOptions());
+
+		// Stops the server if it is still running
+		~Server();
+
+		Server(const Server &) = delete;
+		Server &operator=(const Server &) = delete;
+
+		/**
+		 * @brief Binds the socket and starts accepting connections.
+		 *
+		 * A socket file left behind by a server that is no longer running is replaced.
+		 *
+		 * @throws std::runtime_error if the path exists and is not a socket, or another server is listening on it.
+		 */
+		void start();
+
+		// Stop accepting, finish in-flight requests and remove the socket file
+		void stop();
+
+		// Snapshot of the per-request latency metrics
+		ServerStats stats() const;
+
+		/**
+		 * @brief Carves a single request; this is what the server runs for every framed request.
+		 *
+		 * @param request The request to process.
+		 * @param carveOptions The pipeline options.
+		 * @return The response; failures are reported in CarveResponse::error rather than thrown.
+		 */
+		static CarveResponse process(const CarveRequest &request, const CarveOptions &carveOptions = CarveOptions());
+	};
+
+	/**
+	 * @brief Minimal client for Server, used by tools and tests on the same host.
+	 */
+	class Client
+	{
+	private:
+		int connectionFd;
+
+	public:
+		// Connect to the server listening on socketPath
+		explicit Client(const std::string &socketPath);
+
+		// Close the connection
+		~Client();
+
+		Client(const Client &) = delete;
+		Client &operator=(const Client &) = delete;
+
+		// Send a carve request and wait for its response
+		CarveResponse carve(const CarveRequest &request);
+
+		// Ask the server for its latency metrics
+		ServerStats stats();
+	};
+}
+
+#endif
@@ -3,7 +3,22 @@
 #define STRONKIMAGE
 
 #include <Image.h>
+#include <GrayImage.h>
 #include <Filter.h>
+#include <Kernels.h>
+#include <Hash.h>
 #include <Pixel.h>
+#include <BufferPool.h>
+#include <Profiler.h>
+#include <CarveControl.h>
+#include <Pipeline.h>
+#include <Carver.h>
+#include <Cache.h>
+#include <ThreadPool.h>
+#include <Batch.h>
+#include <Sequence.h>
+#include <TiledImage.h>
+#include <Admission.h>
+#include <Server.h>
 
 #endif
\ No newline at end of file
@@ -0,0 +1,127 @@
+#pragma once
+#ifndef STRONKIMAGE_C_API
+#define STRONKIMAGE_C_API
+
+/*
+ * Stable C interface to libstronkimage, for embedding the carver in-process.
+ *
+ * Every function reports failure through its return value and never lets a C++ exception escape;
+ * stronk_last_error() describes the most recent failure on the calling thread. Handles are opaque,
+ * and a context may be shared between threads. Buffers returned by the library are released with
+ * stronk_buffer_free().
+ */
+
+#include <stddef.h>
+
+#if defined(_WIN32)
+#define STRONK_API __declspec(dllexport)
+#else
+#define STRONK_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+	// Bumped whenever a function or struct in this header changes incompatibly
+#define STRONK_API_VERSION 1
+
+	typedef struct stronk_context stronk_context;
+	typedef struct stronk_image stronk_image;
+
+	typedef enum stronk_status
+	{
+		STRONK_OK = 0,
+		STRONK_ERROR_INVALID_ARGUMENT = 1,
+		STRONK_ERROR_DECODE = 2,
+		STRONK_ERROR_CARVE = 3,
+		STRONK_ERROR_ENCODE = 4,
+		STRONK_ERROR_OUT_OF_MEMORY = 5
+	} stronk_status;
+
+	typedef enum stronk_format
+	{
+		// Encode in the format the image was decoded from
+		STRONK_FORMAT_SOURCE = 0,
+		STRONK_FORMAT_JPEG = 1,
+		STRONK_FORMAT_PNG = 2
+	} stronk_format;
+
+	// Fields are only ever appended, and struct_size tells the library which ones the caller knows about;
+	// stronk_options_init sets it, and fields past it keep their defaults
+	typedef struct stronk_options
+	{
+		// sizeof(stronk_options) as the caller was compiled
+		size_t struct_size;
+
+		// Worker threads used by stronk_carve_many (0 = one per hardware thread)
+		unsigned int num_threads;
+
+		// Sigma of the blur applied before the energy map
+		float blur_sigma;
+
+		// Non-zero to use the box approximation of the blur, whose cost does not grow with blur_sigma
+		int box_blur;
+	} stronk_options;
+
+	// One buffer-to-buffer carve for stronk_carve_many; the library fills in the output fields
+	typedef struct stronk_job
+	{
+		const unsigned char *input;
+		size_t input_size;
+		unsigned int target_width;
+		unsigned int target_height;
+		stronk_format format;
+
+		unsigned char *output;
+		size_t output_size;
+		stronk_status status;
+	} stronk_job;
+
+	// Version of the header the library was built from, to compare against STRONK_API_VERSION
+	STRONK_API int stronk_api_version(void);
+
+	// Message describing the last failed call made by this thread, or "" if none has failed
+	STRONK_API const char *stronk_last_error(void);
+
+	// Fill options with the defaults used by the seamcarve tool, and set struct_size
+	STRONK_API void stronk_options_init(stronk_options *options);
+
+	// Create a context whose worker threads stay alive until it is destroyed; options may be NULL, and
+	// must otherwise have been set up with stronk_options_init
+	STRONK_API stronk_status stronk_context_create(const stronk_options *options, stronk_context **context);
+
+	// Wait for outstanding work and release the context
+	STRONK_API void stronk_context_destroy(stronk_context *context);
+
+	// Decode a JPEG or PNG held in memory
+	STRONK_API stronk_status stronk_image_load(stronk_context *context, const unsigned char *data, size_t size, stronk_image **image);
+
+	STRONK_API stronk_status stronk_image_size(const stronk_image *image, unsigned int *width, unsigned int *height);
+
+	// Carve the image in place down to width x height; 0 keeps that dimension unchanged
+	STRONK_API stronk_status stronk_image_carve(stronk_context *context, stronk_image *image, unsigned int width, unsigned int height);
+
+	// Encode the image into a new buffer, to be released with stronk_buffer_free
+	STRONK_API stronk_status stronk_image_encode(stronk_context *context, const stronk_image *image, stronk_format format,
+												 unsigned char **data, size_t *size);
+
+	STRONK_API void stronk_image_free(stronk_image *image);
+
+	STRONK_API void stronk_buffer_free(unsigned char *data);
+
+	// Decode, carve and encode in one call
+	STRONK_API stronk_status stronk_carve_buffer(stronk_context *context, const unsigned char *data, size_t size,
+												 unsigned int width, unsigned int height, stronk_format format,
+												 unsigned char **output, size_t *output_size);
+
+	// Run every job on the context's worker threads and return once all have finished; jobs fail
+	// independently, and the result is STRONK_OK only if every job succeeded
+	STRONK_API stronk_status stronk_carve_many(stronk_context *context, stronk_job *jobs, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,65 @@
+#pragma once
+#ifndef STRONKIMAGE_THREADPOOL
+#define STRONKIMAGE_THREADPOOL
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace StronkImage
+{
+	/**
+	 * @brief Fixed-size pool of worker threads executing submitted tasks in FIFO order.
+	 *
+	 * Tasks may submit further tasks. The pool is intended to be created once and kept warm across
+	 * many images, so thread creation is not paid per job. An exception that escapes a task is kept,
+	 * and the next wait() rethrows the first one, so a lost job cannot pass for a finished one.
+	 */
+	class ThreadPool
+	{
+	private:
+		std::vector<std::thread> workers;
+		std::deque<std::function<void()>> tasks;
+		std::mutex mutex;
+		std::condition_variable taskAvailable;
+		std::condition_variable allIdle;
+		unsigned int outstanding;
+		bool stopping;
+		std::exception_ptr firstError;
+
+		void workerLoop();
+
+		// Finish queued tasks and join the workers
+		void stop();
+
+	public:
+		// Most workers a pool will start
+		static const unsigned int maxThreads = 256;
+
+		// Start numThreads workers, or one per hardware thread if numThreads is 0; throws
+		// std::invalid_argument above maxThreads, and joins the workers it started if one fails to start
+		explicit ThreadPool(unsigned int numThreads = 0);
+
+		// Finish queued tasks and join all workers
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool &) = delete;
+		ThreadPool &operator=(const ThreadPool &) = delete;
+
+		// Queue a task for execution on one of the workers
+		void submit(std::function<void()> task);
+
+		// Block until every submitted task, including tasks submitted by tasks, has finished, then rethrow
+		// the first exception a task let escape since the last wait(), if any
+		void wait();
+
+		// Number of worker threads
+		unsigned int size() const { return static_cast<unsigned int>(workers.size()); }
+	};
+}
+
+#endif
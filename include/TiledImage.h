@@ -0,0 +1,134 @@
+#pragma once
+#ifndef STRONKIMAGE_TILEDIMAGE
+#define STRONKIMAGE_TILEDIMAGE
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <Image.h>
+
+namespace StronkImage
+{
+	/**
+	 * @brief Row-major 8-bit image whose pixels live in a memory-mapped scratch file.
+	 *
+	 * Colour images use four bytes per pixel (RGBA) instead of the sixteen of ImageData, and the pages
+	 * are backed by an unlinked temporary file rather than anonymous memory. The kernel can write them
+	 * out and drop them, so an image much larger than RAM can be processed one band of rows at a time.
+	 * Rows keep their original pitch as seams are removed, so compaction only moves the tail of each
+	 * row instead of the whole buffer.
+	 */
+	class TiledImage
+	{
+	private:
+		int fd;
+		uint8_t *mapping;
+		size_t mappedBytes;
+		size_t rowPitch;
+
+		void unmap();
+
+	public:
+		unsigned int width, height;
+
+		// Bytes per pixel: 4 for RGBA colour, 1 for grayscale and energy
+		unsigned int channels;
+
+		// Default size of the bands of rows that are processed and then evicted
+		static const size_t defaultBandBytes = size_t(64) << 20;
+
+		// Empty image with no mapping
+		TiledImage();
+
+		// Map a zero-filled width x height image, backed by a scratch file in scratchDirectory ($TMPDIR or /tmp if empty)
+		TiledImage(unsigned int width, unsigned int height, unsigned int channels, const std::string &scratchDirectory = "");
+
+		TiledImage(TiledImage &&other) noexcept;
+		TiledImage &operator=(TiledImage &&other) noexcept;
+		~TiledImage();
+
+		TiledImage(const TiledImage &) = delete;
+		TiledImage &operator=(const TiledImage &) = delete;
+
+		// Bytes between the starts of consecutive rows; fixed at construction
+		size_t pitch() const { return rowPitch; }
+
+		uint8_t *row(unsigned int y) { return mapping + y * rowPitch; }
+		const uint8_t *row(unsigned int y) const { return mapping + y * rowPitch; }
+
+		// Drop rows [rowBegin, rowEnd) from the resident set; their contents stay in the scratch file
+		void evict(unsigned int rowBegin, unsigned int rowEnd) const;
+
+		// Remove the pixel at column seam[y] from every row y in place, narrowing the image by one;
+		// with bandRows set, every band of that many rows is evicted once it has been compacted
+		void removeSeam(const std::vector<int> &seam, unsigned int bandRows = 0);
+
+		// Decode a jpeg or png file straight into a colour image, one scanline at a time, evicting every band of bandBytes
+		static TiledImage load(const std::string &imageSpec, const std::string &scratchDirectory = "", size_t bandBytes = defaultBandBytes);
+
+		// Encode a colour image to a jpeg or png file, one scanline at a time, evicting every band of bandBytes
+		void write(const std::string &imageSpec, size_t bandBytes = defaultBandBytes) const;
+
+		// Conversions for images that do fit in memory
+		static TiledImage fromImageData(const ImageData &imageData, const std::string &scratchDirectory = "");
+		ImageData toImageData() const;
+	};
+
+	struct TiledCarveOptions
+	{
+		// Sigma of the Gaussian blur applied before computing the energy map
+		float blurSigma = 1.0f;
+
+		// Target size of the row bands that are processed and then evicted
+		size_t bandBytes = TiledImage::defaultBandBytes;
+
+		// Directory for the scratch files ($TMPDIR or /tmp if empty)
+		std::string scratchDirectory;
+	};
+
+	/**
+	 * @brief Seam carving over TiledImage with memory bounded by the width of the image.
+	 *
+	 * The blur, grayscale, Sobel and energy passes are fused into one top-to-bottom stream that keeps
+	 * only a window of kernel-height rows in memory. The seam search keeps two rows of path costs and
+	 * writes packed two-bit backpointers to another scratch file. Results match Carver up to the rounding
+	 * of the separable blur.
+	 */
+	class TiledCarver
+	{
+	public:
+		/**
+		 * @brief Computes the single-channel energy map of a colour image.
+		 *
+		 * @param colourImage The TiledImage object representing the RGBA colour image.
+		 * @param options Blur sigma, band size and scratch directory.
+		 * @return A one-channel TiledImage holding the energy of every pixel.
+		 */
+		static TiledImage generateEnergyMap(const TiledImage &colourImage, const TiledCarveOptions &options = TiledCarveOptions());
+
+		/**
+		 * @brief Finds the lowest energy vertical seam, with the same tie-breaking as Filter::findVerticalSeam.
+		 *
+		 * @param energyMap The one-channel energy map.
+		 * @param directions Scratch image of at least (width + 3) / 4 by height bytes for the backpointers.
+		 * @param bandRows Rows processed between evictions.
+		 * @return The column of the seam in every row.
+		 */
+		static std::vector<int> findVerticalSeam(const TiledImage &energyMap, TiledImage &directions, unsigned int bandRows);
+
+		/**
+		 * @brief Removes numSeams vertical seams from the colour image in place.
+		 */
+		static void carve(TiledImage &colourImage, int numSeams, const TiledCarveOptions &options = TiledCarveOptions());
+
+		/**
+		 * @brief Loads, carves and writes an image without ever holding it whole in memory.
+		 */
+		static void carveFile(const std::string &inputPath, const std::string &outputPath, int numSeams,
+							  const TiledCarveOptions &options = TiledCarveOptions());
+	};
+}
+
+#endif
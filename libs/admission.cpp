@@ -0,0 +1,239 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <Admission.h>
+#include <BufferPool.h>
+
+namespace StronkImage
+{
+	namespace
+	{
+		uint64_t pooled(uint64_t bytes)
+		{
+			return bytes ? BufferPool::sizeClass(bytes) : 0;
+		}
+
+		// Rows in the ring of the separable blur, as in Filter::gaussianBlur
+		uint64_t kernelRows(float sigma)
+		{
+			int kernelSize = static_cast<int>(std::ceil(6 * sigma));
+			return kernelSize % 2 == 0 ? kernelSize + 1 : kernelSize;
+		}
+
+		// Capacity of the buffer an encoder writes into; vectors grow by doubling, so the capacity can reach
+		// twice the encoded size, and raw files are written straight from the pixels
+		uint64_t encodedBytes(ImageFormat format, uint64_t pixels)
+		{
+			switch (format)
+			{
+			case ImageFormat::Raw:
+				return 0;
+			case ImageFormat::Jpeg:
+				return 2 * pixels;
+			case ImageFormat::Ppm:
+				return 2 * 3 * pixels;
+			default:
+				return 2 * 4 * pixels;
+			}
+		}
+
+		unsigned int divideRoundingUp(unsigned int value, unsigned int divisor)
+		{
+			return (value + divisor - 1) / divisor;
+		}
+
+		// Sink that averages every factor x factor block of the decoded rows into one pixel of the target
+		class DownscalingSink : public ScanlineSink
+		{
+		private:
+			ImageData &target;
+			unsigned int factor;
+			unsigned int sourceWidth = 0;
+			unsigned int sourceHeight = 0;
+			std::vector<uint32_t> sums;
+
+		public:
+			DownscalingSink(ImageData &target, unsigned int factor)
+				: target(target), factor(factor) {}
+
+			void start(unsigned int width, unsigned int height) override
+			{
+				sourceWidth = width;
+				sourceHeight = height;
+				target.resizeBuffer(divideRoundingUp(width, factor), divideRoundingUp(height, factor));
+				sums.assign(static_cast<size_t>(target.width) * 4, 0);
+			}
+
+			void writeRow(unsigned int y, const uint8_t *rgba) override
+			{
+				for (unsigned int x = 0; x < sourceWidth; ++x)
+				{
+					uint32_t *sum = &sums[(x / factor) * 4];
+					for (int channel = 0; channel < 4; ++channel)
+					{
+						sum[channel] += rgba[x * 4 + channel];
+					}
+				}
+
+				// Emit the row of blocks once its last source row, or the last row of the image, has arrived
+				if ((y + 1) % factor != 0 && y + 1 != sourceHeight)
+				{
+					return;
+				}
+
+				unsigned int blockRows = y % factor + 1;
+				RGBPixelBuf *pixels = target.rgbPixelData + static_cast<size_t>(y / factor) * target.width;
+				for (unsigned int x = 0; x < target.width; ++x)
+				{
+					unsigned int blockColumns = std::min(factor, sourceWidth - x * factor);
+					uint32_t count = blockRows * blockColumns;
+					const uint32_t *sum = &sums[x * 4];
+					pixels[x] = {(sum[0] + count / 2) / count, (sum[1] + count / 2) / count, (sum[2] + count / 2) / count, (sum[3] + count / 2) / count};
+				}
+				std::fill(sums.begin(), sums.end(), 0);
+			}
+		};
+	}
+
+	MemoryBudget::MemoryBudget(uint64_t maxBytes, OverBudgetPolicy policy)
+		: maxBytes(maxBytes), policy(policy) {}
+
+	uint64_t MemoryBudget::estimateInMemory(unsigned int width, unsigned int height, const CarveOptions &options, ImageFormat outputFormat)
+	{
+		const uint64_t pixels = static_cast<uint64_t>(width) * height;
+		const uint64_t colour = pooled(pixels * sizeof(RGBPixelBuf));
+		const uint64_t energy = colour;
+		const uint64_t gray = pooled(pixels);
+
+		// The blurred luminance, with the ring of blurred rows or the float copy the box sweeps need
+		uint64_t blurScratch = 0;
+		if (options.blurSigma > 0.0f)
+		{
+			blurScratch = options.blurMode == BlurMode::Box ? 2 * pixels * sizeof(float) : (kernelRows(options.blurSigma) + 1) * width * sizeof(float);
+		}
+		const uint64_t blurStage = colour + gray + blurScratch;
+
+		// The gradient reads the blurred luminance into the energy map
+		const uint64_t energyStage = colour + gray + energy;
+
+		// Once released, the luminance stays cached in the pool, so it counts against the later stages too.
+		// Removing seams adds the live energy bytes and original columns, and two-bit backpointers per pixel.
+		const uint64_t seamStage = colour + gray + energy + pixels * (sizeof(uint8_t) + sizeof(uint32_t)) + pixels / 4 + 8 * static_cast<uint64_t>(width);
+
+		// The energy map and the output are each encoded into a buffer before they are written
+		const uint64_t encodeStage = colour + gray + energy + std::max(encodedBytes(ImageFormat::Jpeg, pixels), encodedBytes(outputFormat, pixels));
+
+		const uint64_t mask = options.region.mask ? pooled(pixels) : 0;
+		return std::max({blurStage, energyStage, seamStage, encodeStage}) + mask;
+	}
+
+	uint64_t MemoryBudget::estimateTiled(unsigned int width, unsigned int height, const TiledCarveOptions &options)
+	{
+		// A band each of the colour image, the energy map and the backpointers can be resident before it is
+		// evicted, next to rows of blurred luminance, path costs, the seam and the decoder's scanline
+		uint64_t rows = (options.blurSigma > 0.0f ? kernelRows(options.blurSigma) : 1) * width * sizeof(float);
+		rows += static_cast<uint64_t>(width) * (sizeof(float) + 3 + 2 * sizeof(uint32_t) + 4);
+		return 3 * static_cast<uint64_t>(options.bandBytes) + rows + static_cast<uint64_t>(height) * sizeof(int);
+	}
+
+	AdmissionDecision MemoryBudget::admit(const ImageInfo &input, int numSeams, const CarveOptions &options, ImageFormat outputFormat,
+										  const TiledCarveOptions &tiledOptions) const
+	{
+		AdmissionDecision decision;
+		decision.numSeams = numSeams;
+		decision.options = options;
+		decision.tiledOptions = tiledOptions;
+		decision.estimatedBytes = estimateInMemory(input.width, input.height, options, outputFormat);
+		if (decision.estimatedBytes <= maxBytes)
+		{
+			return decision;
+		}
+
+		const std::string over = "Estimated peak memory of " + std::to_string(decision.estimatedBytes >> 20) + " MiB for a " +
+								 std::to_string(input.width) + "x" + std::to_string(input.height) + " image exceeds the budget of " +
+								 std::to_string(maxBytes >> 20) + " MiB";
+
+		const SeamRegion &region = options.region;
+		switch (policy)
+		{
+		case OverBudgetPolicy::Reject:
+			throw MemoryBudgetExceeded(over, decision.estimatedBytes, maxBytes);
+
+		case OverBudgetPolicy::Downscale:
+		{
+			if (region.mask)
+			{
+				throw MemoryBudgetExceeded(over + "; a mask cannot be downscaled with the image", decision.estimatedBytes, maxBytes);
+			}
+
+			// The estimate shrinks with the square of the factor, so the search is short
+			for (unsigned int factor = 2; factor <= std::min(input.width, input.height); ++factor)
+			{
+				unsigned int width = divideRoundingUp(input.width, factor);
+				unsigned int height = divideRoundingUp(input.height, factor);
+				uint64_t estimate = estimateInMemory(width, height, options, outputFormat);
+				if (estimate > maxBytes)
+				{
+					continue;
+				}
+
+				decision.strategy = CarveStrategy::Downscaled;
+				decision.estimatedBytes = estimate;
+				decision.downscale = factor;
+				decision.numSeams = std::min(static_cast<int>(std::lround(static_cast<double>(numSeams) / factor)), static_cast<int>(width) - 1);
+				decision.options.region.columnBegin = region.columnBegin / factor;
+				decision.options.region.columnEnd = divideRoundingUp(region.columnEnd, factor);
+				return decision;
+			}
+			throw MemoryBudgetExceeded(over + " at any downscale factor", decision.estimatedBytes, maxBytes);
+		}
+
+		case OverBudgetPolicy::Tiled:
+		{
+			if (region.mask || region.columnBegin || region.columnEnd)
+			{
+				throw MemoryBudgetExceeded(over + "; the tiled path cannot honour a seam region", decision.estimatedBytes, maxBytes);
+			}
+			if (options.blurMode != BlurMode::Exact || region.seamMode != SeamMode::Exact || region.numStrips || options.timeBudgetSeconds > 0.0)
+			{
+				throw MemoryBudgetExceeded(over + "; the tiled path always runs the exact blur and seam search without a time budget",
+										   decision.estimatedBytes, maxBytes);
+			}
+
+			// Halve the bands until they fit, down to a single row of the colour image
+			TiledCarveOptions fitted = tiledOptions;
+			const size_t rowBytes = static_cast<size_t>(input.width) * 4;
+			uint64_t estimate = estimateTiled(input.width, input.height, fitted);
+			while (estimate > maxBytes && fitted.bandBytes / 2 >= rowBytes)
+			{
+				fitted.bandBytes /= 2;
+				estimate = estimateTiled(input.width, input.height, fitted);
+			}
+			if (estimate > maxBytes)
+			{
+				throw MemoryBudgetExceeded(over + ", even out of core", estimate, maxBytes);
+			}
+
+			decision.strategy = CarveStrategy::Tiled;
+			decision.estimatedBytes = estimate;
+			decision.tiledOptions = fitted;
+			return decision;
+		}
+		}
+		return decision;
+	}
+
+	ImageData MemoryBudget::loadDownscaled(const std::string &imageSpec, unsigned int factor)
+	{
+		if (factor == 0)
+		{
+			throw std::invalid_argument("The downscale factor must be at least 1");
+		}
+
+		ImageData image;
+		DownscalingSink sink(image, factor);
+		Image::decodeScanlines(imageSpec, sink);
+		return image;
+	}
+}
@@ -0,0 +1,207 @@
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <sstream>
+
+#include <Batch.h>
+#include <ThreadPool.h>
+
+namespace StronkImage
+{
+	namespace
+	{
+		bool hasImageExtension(const std::filesystem::path &path)
+		{
+			std::string extension = path.extension().string();
+			std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+			return Image::formatFromPath(extension) != ImageFormat::Unknown;
+		}
+
+		// Shared state of one Batch::run invocation
+		class BatchPipeline
+		{
+		private:
+			const std::vector<BatchJob> &jobs;
+			const BatchOptions &options;
+			std::vector<BatchResult> &results;
+			ThreadPool &pool;
+
+			std::mutex mutex;
+			size_t nextJob;
+			unsigned int inFlight;
+			unsigned int maxInFlight;
+
+			using Clock = std::chrono::steady_clock;
+
+			void fail(size_t index, const std::string &message, Clock::time_point started)
+			{
+				results[index].success = false;
+				results[index].error = message;
+				finish(index, started);
+			}
+
+			void finish(size_t index, Clock::time_point started)
+			{
+				results[index].seconds = std::chrono::duration<double>(Clock::now() - started).count();
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					--inFlight;
+				}
+				admit();
+			}
+
+			void decode(size_t index)
+			{
+				Clock::time_point started = Clock::now();
+				try
+				{
+					// The image moves from stage to stage, so each stage holds the only reference to it
+					auto image = std::make_shared<Image>(jobs[index].inputPath);
+					pool.submit([this, index, image = std::move(image), started]() mutable
+								{ carve(index, std::move(image), started); });
+				}
+				catch (const std::exception &e)
+				{
+					fail(index, e.what(), started);
+				}
+			}
+
+			void carve(size_t index, std::shared_ptr<Image> image, Clock::time_point started)
+			{
+				try
+				{
+					Carver::carve(image->getRawImageData(), jobs[index].numSeams, options.carveOptions);
+					pool.submit([this, index, image = std::move(image), started]() mutable
+								{ encode(index, std::move(image), started); });
+				}
+				catch (const std::exception &e)
+				{
+					fail(index, e.what(), started);
+				}
+			}
+
+			void encode(size_t index, std::shared_ptr<Image> image, Clock::time_point started)
+			{
+				try
+				{
+					image->writeToFile(jobs[index].outputPath);
+					results[index].success = true;
+				}
+				catch (const std::exception &e)
+				{
+					results[index].error = e.what();
+				}
+
+				// The job is done either way, so an error admitting the next one must not be charged to it. Release
+				// the pixels before admitting; the task no longer holds a copy
+				image.reset();
+				finish(index, started);
+			}
+
+		public:
+			BatchPipeline(const std::vector<BatchJob> &jobs, const BatchOptions &options, std::vector<BatchResult> &results, ThreadPool &pool)
+				: jobs(jobs), options(options), results(results), pool(pool), nextJob(0), inFlight(0)
+			{
+				maxInFlight = options.maxInFlight > 0 ? options.maxInFlight : 2 * pool.size();
+			}
+
+			// Start decoding as many pending jobs as the in-flight limit allows
+			void admit()
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				while (nextJob < jobs.size() && inFlight < maxInFlight)
+				{
+					size_t index = nextJob++;
+					++inFlight;
+					pool.submit([this, index]
+								{ decode(index); });
+				}
+			}
+		};
+	}
+
+	std::vector<BatchJob> Batch::readManifest(const std::string &manifestPath)
+	{
+		std::ifstream manifest(manifestPath);
+		if (!manifest)
+		{
+			throw std::runtime_error("Error opening manifest file");
+		}
+
+		std::vector<BatchJob> jobs;
+		std::string line;
+		int lineNumber = 0;
+		while (std::getline(manifest, line))
+		{
+			++lineNumber;
+
+			size_t first = line.find_first_not_of(" \t\r");
+			if (first == std::string::npos || line[first] == '#')
+			{
+				continue;
+			}
+
+			std::istringstream fields(line);
+			BatchJob job;
+			std::string trailing;
+			if (!(fields >> job.inputPath >> job.outputPath >> job.numSeams) || (fields >> trailing))
+			{
+				throw std::runtime_error("Malformed manifest line " + std::to_string(lineNumber));
+			}
+
+			jobs.push_back(job);
+		}
+
+		return jobs;
+	}
+
+	std::vector<BatchJob> Batch::jobsFromDirectory(const std::string &inputDir, const std::string &outputDir, int numSeams)
+	{
+		if (!std::filesystem::is_directory(inputDir))
+		{
+			throw std::runtime_error("Input path is not a directory");
+		}
+
+		std::filesystem::create_directories(outputDir);
+
+		std::vector<BatchJob> jobs;
+		for (const auto &entry : std::filesystem::directory_iterator(inputDir))
+		{
+			if (entry.is_regular_file() && hasImageExtension(entry.path()))
+			{
+				// Gray .pgm inputs come out in colour, so they are written as .ppm
+				std::filesystem::path output = std::filesystem::path(outputDir) / entry.path().filename();
+				if (output.extension() == ".pgm")
+				{
+					output.replace_extension(".ppm");
+				}
+				jobs.push_back({entry.path().string(), output.string(), numSeams});
+			}
+		}
+
+		std::sort(jobs.begin(), jobs.end(), [](const BatchJob &a, const BatchJob &b)
+				  { return a.inputPath < b.inputPath; });
+
+		return jobs;
+	}
+
+	std::vector<BatchResult> Batch::run(const std::vector<BatchJob> &jobs, const BatchOptions &options)
+	{
+		std::vector<BatchResult> results(jobs.size());
+		for (size_t i = 0; i < jobs.size(); ++i)
+		{
+			results[i].job = jobs[i];
+		}
+
+		ThreadPool pool(options.numThreads);
+		BatchPipeline pipeline(jobs, options, results, pool);
+
+		pipeline.admit();
+		pool.wait();
+
+		return results;
+	}
+}
@@ -0,0 +1,159 @@
+#include <algorithm>
+#include <new>
+
+#include <BufferPool.h>
+
+namespace StronkImage
+{
+	namespace
+	{
+		// Requests at or below this size all share the smallest class
+		const size_t minClassBytes = 4096;
+
+		// Cache-line alignment keeps rows of different buffers from sharing lines across threads
+		const std::align_val_t bufferAlignment = std::align_val_t(64);
+
+		// Per-thread acquisition totals read by the profiler without taking the pool lock
+		thread_local uint64_t allocationsOnThread = 0;
+		thread_local uint64_t bytesOnThread = 0;
+	}
+
+	BufferPool::BufferPool(size_t maxCachedBytes)
+		: maxCachedBytes(maxCachedBytes) {}
+
+	BufferPool::~BufferPool()
+	{
+		trim();
+	}
+
+	BufferPool &BufferPool::global()
+	{
+		// Never destroyed, so images with static storage duration can still release into it at exit
+		static BufferPool *pool = new BufferPool();
+		return *pool;
+	}
+
+	size_t BufferPool::sizeClass(size_t bytes)
+	{
+		if (bytes <= minClassBytes)
+		{
+			return minClassBytes;
+		}
+
+		// Four classes per power of two: the step is a quarter of the largest power of two below bytes
+		size_t highestBit = size_t(1) << (63 - __builtin_clzll(bytes));
+		size_t step = highestBit / 4;
+		return (bytes + step - 1) & ~(step - 1);
+	}
+
+	void *BufferPool::acquire(size_t bytes)
+	{
+		size_t classBytes = sizeClass(bytes);
+
+		++allocationsOnThread;
+		bytesOnThread += classBytes;
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			counters.bytesInUse += classBytes;
+			counters.peakBytesInUse = std::max(counters.peakBytesInUse, counters.bytesInUse);
+
+			auto freeList = freeLists.find(classBytes);
+			if (freeList != freeLists.end() && !freeList->second.empty())
+			{
+				void *buffer = freeList->second.back();
+				freeList->second.pop_back();
+				counters.bytesCached -= classBytes;
+				++counters.hits;
+				return buffer;
+			}
+
+			++counters.misses;
+		}
+
+		try
+		{
+			return ::operator new(classBytes, bufferAlignment);
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			counters.bytesInUse -= classBytes;
+			throw;
+		}
+	}
+
+	void BufferPool::release(void *buffer, size_t bytes)
+	{
+		if (!buffer)
+		{
+			return;
+		}
+
+		size_t classBytes = sizeClass(bytes);
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			counters.bytesInUse -= classBytes;
+
+			if (counters.bytesCached + classBytes <= maxCachedBytes)
+			{
+				freeLists[classBytes].push_back(buffer);
+				counters.bytesCached += classBytes;
+				return;
+			}
+		}
+
+		::operator delete(buffer, bufferAlignment);
+	}
+
+	void BufferPool::trim()
+	{
+		std::unordered_map<size_t, std::vector<void *>> released;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			released.swap(freeLists);
+			counters.bytesCached = 0;
+		}
+
+		for (auto &freeList : released)
+		{
+			for (void *buffer : freeList.second)
+			{
+				::operator delete(buffer, bufferAlignment);
+			}
+		}
+	}
+
+	void BufferPool::setMaxCachedBytes(size_t bytes)
+	{
+		bool overLimit;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			maxCachedBytes = bytes;
+			overLimit = counters.bytesCached > maxCachedBytes;
+		}
+
+		if (overLimit)
+		{
+			trim();
+		}
+	}
+
+	BufferPoolStats BufferPool::stats() const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return counters;
+	}
+
+	uint64_t BufferPool::threadAllocations()
+	{
+		return allocationsOnThread;
+	}
+
+	uint64_t BufferPool::threadBytesAllocated()
+	{
+		return bytesOnThread;
+	}
+}
@@ -0,0 +1,247 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+
+#include <unistd.h>
+
+#include <Cache.h>
+#include <Hash.h>
+
+namespace StronkImage
+{
+	namespace
+	{
+		const uint32_t energyMagic = 0x4e454353; // "SCEN"
+
+		struct EnergyHeader
+		{
+			uint32_t magic;
+			uint32_t width;
+			uint32_t height;
+		};
+
+		template <typename T>
+		uint64_t hashValue(const T &value, uint64_t hash)
+		{
+			return fnv1a(&value, sizeof(value), hash);
+		}
+	}
+
+	ResultCache::ResultCache(const std::string &directory, uint64_t maxBytes)
+		: directory(directory), maxBytes(maxBytes)
+	{
+		std::filesystem::create_directories(directory);
+	}
+
+	uint64_t ResultCache::energyKey(const unsigned char *inputBytes, size_t inputSize, const CarveOptions &options)
+	{
+		uint64_t hash = fnv1a(inputBytes, inputSize);
+		hash = hashValue(options.blurSigma, hash);
+		return hashValue(static_cast<int>(options.blurMode), hash);
+	}
+
+	uint64_t ResultCache::outputKey(uint64_t energyKey, int numSeams, const CarveOptions &options, ImageFormat format)
+	{
+		uint64_t hash = hashValue(energyKey, fnvOffsetBasis);
+		hash = hashValue(numSeams, hash);
+		hash = hashValue(static_cast<int>(format), hash);
+		hash = hashValue(options.region.columnBegin, hash);
+		hash = hashValue(options.region.columnEnd, hash);
+		hash = hashValue(static_cast<int>(options.region.seamMode), hash);
+		if (options.region.seamMode == SeamMode::Strips)
+		{
+			hash = hashValue(options.region.numStrips, hash);
+		}
+
+		if (const GrayImageData *mask = options.region.mask)
+		{
+			hash = hashValue(mask->width, hash);
+			hash = hashValue(mask->height, hash);
+			hash = fnv1a(mask->pixels, static_cast<size_t>(mask->width) * mask->height, hash);
+		}
+		if (const std::vector<std::vector<int>> *guides = options.region.guides)
+		{
+			hash = hashValue(options.region.bandRadius, hash);
+			for (const std::vector<int> &guide : *guides)
+			{
+				hash = fnv1a(guide.data(), guide.size() * sizeof(int), hash);
+			}
+		}
+		return hash;
+	}
+
+	std::string ResultCache::entryPath(uint64_t key, const char *extension) const
+	{
+		char name[32];
+		std::snprintf(name, sizeof(name), "%016llx.%s", static_cast<unsigned long long>(key), extension);
+		return (std::filesystem::path(directory) / name).string();
+	}
+
+	bool ResultCache::readEntry(const std::string &path, std::vector<unsigned char> &bytes) const
+	{
+		FILE *file = std::fopen(path.c_str(), "rb");
+		if (!file)
+		{
+			return false;
+		}
+
+		std::fseek(file, 0, SEEK_END);
+		long size = std::ftell(file);
+		std::fseek(file, 0, SEEK_SET);
+		bytes.resize(size > 0 ? size : 0);
+		bool complete = size > 0 && std::fread(bytes.data(), 1, bytes.size(), file) == bytes.size();
+		std::fclose(file);
+
+		if (complete)
+		{
+			// Mark the entry as recently used for eviction
+			std::error_code error;
+			std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), error);
+		}
+		return complete;
+	}
+
+	void ResultCache::writeEntry(const std::string &path, const void *data, size_t size)
+	{
+		// Write under a private name and rename, so readers in other processes never see a partial entry.
+		// A full or read-only directory only costs the cache its entry, never the carve.
+		std::string temporaryPath = path + ".tmp" + std::to_string(::getpid());
+		FILE *file = std::fopen(temporaryPath.c_str(), "wb");
+		if (!file)
+		{
+			return;
+		}
+
+		bool written = std::fwrite(data, 1, size, file) == size;
+		written = std::fclose(file) == 0 && written;
+
+		std::error_code error;
+		if (written)
+		{
+			std::filesystem::rename(temporaryPath, path, error);
+		}
+		if (!written || error)
+		{
+			std::filesystem::remove(temporaryPath, error);
+			return;
+		}
+
+		evict();
+	}
+
+	bool ResultCache::loadEnergy(uint64_t key, ImageData &energyMap)
+	{
+		std::vector<unsigned char> bytes;
+		EnergyHeader header = {};
+		bool found = readEntry(entryPath(key, "energy"), bytes) && bytes.size() >= sizeof(header);
+		if (found)
+		{
+			std::memcpy(&header, bytes.data(), sizeof(header));
+			found = header.magic == energyMagic && header.width && header.height &&
+					bytes.size() == sizeof(header) + static_cast<size_t>(header.width) * header.height;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			++(found ? counters.energyHits : counters.energyMisses);
+		}
+		if (!found)
+		{
+			return false;
+		}
+
+		energyMap.resizeBuffer(header.width, header.height);
+		const unsigned char *values = bytes.data() + sizeof(header);
+		size_t pixelCount = static_cast<size_t>(header.width) * header.height;
+		for (size_t i = 0; i < pixelCount; ++i)
+		{
+			Quantum value = values[i];
+			energyMap.rgbPixelData[i] = {value, value, value, 255};
+		}
+		return true;
+	}
+
+	void ResultCache::storeEnergy(uint64_t key, const ImageData &energyMap)
+	{
+		EnergyHeader header = {energyMagic, energyMap.width, energyMap.height};
+		size_t pixelCount = static_cast<size_t>(energyMap.width) * energyMap.height;
+
+		std::vector<unsigned char> bytes(sizeof(header) + pixelCount);
+		std::memcpy(bytes.data(), &header, sizeof(header));
+		for (size_t i = 0; i < pixelCount; ++i)
+		{
+			bytes[sizeof(header) + i] = static_cast<unsigned char>(energyMap.rgbPixelData[i].red);
+		}
+		writeEntry(entryPath(key, "energy"), bytes.data(), bytes.size());
+	}
+
+	bool ResultCache::loadOutput(uint64_t key, std::vector<unsigned char> &encoded)
+	{
+		bool found = readEntry(entryPath(key, "out"), encoded);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		++(found ? counters.outputHits : counters.outputMisses);
+		return found;
+	}
+
+	void ResultCache::storeOutput(uint64_t key, const std::vector<unsigned char> &encoded)
+	{
+		writeEntry(entryPath(key, "out"), encoded.data(), encoded.size());
+	}
+
+	void ResultCache::evict()
+	{
+		struct Entry
+		{
+			std::filesystem::path path;
+			std::filesystem::file_time_type lastUsed;
+			uint64_t size;
+		};
+
+		std::vector<Entry> entries;
+		uint64_t totalBytes = 0;
+		std::error_code error;
+		for (const std::filesystem::directory_entry &entry : std::filesystem::directory_iterator(directory, error))
+		{
+			std::string extension = entry.path().extension().string();
+			if (entry.is_regular_file(error) && (extension == ".energy" || extension == ".out"))
+			{
+				entries.push_back({entry.path(), entry.last_write_time(error), entry.file_size(error)});
+				totalBytes += entries.back().size;
+			}
+		}
+
+		if (totalBytes <= maxBytes)
+		{
+			return;
+		}
+
+		std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b)
+				  { return a.lastUsed < b.lastUsed; });
+
+		uint64_t evicted = 0;
+		for (const Entry &entry : entries)
+		{
+			if (totalBytes <= maxBytes)
+			{
+				break;
+			}
+			if (std::filesystem::remove(entry.path, error))
+			{
+				totalBytes -= entry.size;
+				++evicted;
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		counters.evictions += evicted;
+	}
+
+	CacheStats ResultCache::stats() const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return counters;
+	}
+}
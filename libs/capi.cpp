@@ -0,0 +1,327 @@
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <string>
+
+#include <Carver.h>
+#include <Image.h>
+#include <StronkImageC.h>
+#include <ThreadPool.h>
+
+struct stronk_context
+{
+	StronkImage::CarveOptions carveOptions;
+	StronkImage::ThreadPool pool;
+
+	stronk_context(const stronk_options &options) : pool(options.num_threads)
+	{
+		carveOptions.blurSigma = options.blur_sigma;
+		carveOptions.blurMode = options.box_blur ? StronkImage::BlurMode::Box : StronkImage::BlurMode::Exact;
+	}
+};
+
+struct stronk_image
+{
+	StronkImage::Image image;
+	StronkImage::ImageFormat sourceFormat = StronkImage::ImageFormat::Unknown;
+};
+
+namespace
+{
+	using namespace StronkImage;
+
+	thread_local std::string lastError;
+
+	// Run body, turning any exception into a status code and the thread's last error message
+	template <typename Body>
+	stronk_status guarded(stronk_status failure, Body body)
+	{
+		try
+		{
+			body();
+			lastError.clear();
+			return STRONK_OK;
+		}
+		catch (const std::bad_alloc &)
+		{
+			lastError = "Out of memory";
+			return STRONK_ERROR_OUT_OF_MEMORY;
+		}
+		catch (const std::invalid_argument &e)
+		{
+			lastError = e.what();
+			return STRONK_ERROR_INVALID_ARGUMENT;
+		}
+		catch (const std::exception &e)
+		{
+			lastError = e.what();
+			return failure;
+		}
+		catch (...)
+		{
+			lastError = "Unknown error";
+			return failure;
+		}
+	}
+
+	stronk_status invalidArgument(const char *message)
+	{
+		lastError = message;
+		return STRONK_ERROR_INVALID_ARGUMENT;
+	}
+
+	std::unique_ptr<stronk_image> decode(const unsigned char *data, size_t size)
+	{
+		std::unique_ptr<stronk_image> image(new stronk_image());
+		image->sourceFormat = Image::formatFromSignature(data, size);
+		image->image.loadFromMemory(data, size);
+		return image;
+	}
+
+	void carve(const stronk_context &context, stronk_image &image, unsigned int width, unsigned int height)
+	{
+		ImageData &imageData = image.image.getRawImageData();
+		Carver::carveTo(imageData, width ? width : imageData.getWidth(), height ? height : imageData.getHeight(), context.carveOptions);
+	}
+
+	// Encode into a malloc'd buffer so C callers can release it without knowing about std::vector
+	void encode(const stronk_image &image, stronk_format format, unsigned char **data, size_t *size)
+	{
+		ImageFormat imageFormat = format == STRONK_FORMAT_JPEG  ? ImageFormat::Jpeg
+								  : format == STRONK_FORMAT_PNG ? ImageFormat::Png
+																: image.sourceFormat;
+		if (imageFormat == ImageFormat::Unknown)
+		{
+			throw std::invalid_argument("No output format given and the source format is unknown");
+		}
+
+		// writeToMemory does not modify the image, but is not declared const
+		std::vector<unsigned char> encoded = const_cast<Image &>(image.image).writeToMemory(imageFormat);
+		unsigned char *buffer = static_cast<unsigned char *>(std::malloc(encoded.size() ? encoded.size() : 1));
+		if (!buffer)
+		{
+			throw std::bad_alloc();
+		}
+		std::memcpy(buffer, encoded.data(), encoded.size());
+		*data = buffer;
+		*size = encoded.size();
+	}
+
+	stronk_status carveBuffer(stronk_context &context, const unsigned char *data, size_t size, unsigned int width, unsigned int height,
+							  stronk_format format, unsigned char **output, size_t *outputSize)
+	{
+		std::unique_ptr<stronk_image> image;
+		stronk_status status = guarded(STRONK_ERROR_DECODE, [&]
+									   { image = decode(data, size); });
+		if (status == STRONK_OK)
+		{
+			status = guarded(STRONK_ERROR_CARVE, [&]
+							 { carve(context, *image, width, height); });
+		}
+		if (status == STRONK_OK)
+		{
+			status = guarded(STRONK_ERROR_ENCODE, [&]
+							 { encode(*image, format, output, outputSize); });
+		}
+		return status;
+	}
+}
+
+extern "C"
+{
+	int stronk_api_version(void)
+	{
+		return STRONK_API_VERSION;
+	}
+
+	const char *stronk_last_error(void)
+	{
+		return lastError.c_str();
+	}
+
+	void stronk_options_init(stronk_options *options)
+	{
+		if (options)
+		{
+			CarveOptions defaults;
+			options->struct_size = sizeof(stronk_options);
+			options->num_threads = 0;
+			options->blur_sigma = defaults.blurSigma;
+			options->box_blur = defaults.blurMode == BlurMode::Box;
+		}
+	}
+
+	stronk_status stronk_context_create(const stronk_options *options, stronk_context **context)
+	{
+		if (!context)
+		{
+			return invalidArgument("context must not be NULL");
+		}
+
+		stronk_options resolved;
+		stronk_options_init(&resolved);
+		if (options)
+		{
+			// A caller built against a later header passes a longer struct, whose extra fields are ignored; the
+			// fields of version 1 are always there, and fields added since then keep their defaults if missing
+			if (options->struct_size < offsetof(stronk_options, box_blur) + sizeof(options->box_blur))
+			{
+				return invalidArgument("options must be set up with stronk_options_init");
+			}
+			std::memcpy(&resolved, options, std::min(options->struct_size, sizeof(stronk_options)));
+			resolved.struct_size = sizeof(stronk_options);
+		}
+		if (!(resolved.blur_sigma > 0.0f))
+		{
+			return invalidArgument("blur_sigma must be positive");
+		}
+
+		return guarded(STRONK_ERROR_OUT_OF_MEMORY, [&]
+					   { *context = new stronk_context(resolved); });
+	}
+
+	void stronk_context_destroy(stronk_context *context)
+	{
+		delete context;
+	}
+
+	stronk_status stronk_image_load(stronk_context *context, const unsigned char *data, size_t size, stronk_image **image)
+	{
+		if (!context || !data || !image)
+		{
+			return invalidArgument("context, data and image must not be NULL");
+		}
+		return guarded(STRONK_ERROR_DECODE, [&]
+					   { *image = decode(data, size).release(); });
+	}
+
+	stronk_status stronk_image_size(const stronk_image *image, unsigned int *width, unsigned int *height)
+	{
+		if (!image || !width || !height)
+		{
+			return invalidArgument("image, width and height must not be NULL");
+		}
+		const ImageData &imageData = const_cast<stronk_image *>(image)->image.getRawImageData();
+		*width = imageData.width;
+		*height = imageData.height;
+		return STRONK_OK;
+	}
+
+	stronk_status stronk_image_carve(stronk_context *context, stronk_image *image, unsigned int width, unsigned int height)
+	{
+		if (!context || !image)
+		{
+			return invalidArgument("context and image must not be NULL");
+		}
+		return guarded(STRONK_ERROR_CARVE, [&]
+					   { carve(*context, *image, width, height); });
+	}
+
+	stronk_status stronk_image_encode(stronk_context *context, const stronk_image *image, stronk_format format,
+									  unsigned char **data, size_t *size)
+	{
+		if (!context || !image || !data || !size)
+		{
+			return invalidArgument("context, image, data and size must not be NULL");
+		}
+		return guarded(STRONK_ERROR_ENCODE, [&]
+					   { encode(*image, format, data, size); });
+	}
+
+	void stronk_image_free(stronk_image *image)
+	{
+		delete image;
+	}
+
+	void stronk_buffer_free(unsigned char *data)
+	{
+		std::free(data);
+	}
+
+	stronk_status stronk_carve_buffer(stronk_context *context, const unsigned char *data, size_t size,
+									  unsigned int width, unsigned int height, stronk_format format,
+									  unsigned char **output, size_t *output_size)
+	{
+		if (!context || !data || !output || !output_size)
+		{
+			return invalidArgument("context, data, output and output_size must not be NULL");
+		}
+		return carveBuffer(*context, data, size, width, height, format, output, output_size);
+	}
+
+	stronk_status stronk_carve_many(stronk_context *context, stronk_job *jobs, size_t count)
+	{
+		if (!context || (!jobs && count))
+		{
+			return invalidArgument("context and jobs must not be NULL");
+		}
+
+		// Counted locally rather than with ThreadPool::wait, so concurrent calls on one context do not wait for
+		// each other. The tasks share the counters rather than pointing into this frame.
+		struct Progress
+		{
+			std::mutex mutex;
+			std::condition_variable finished;
+			size_t remaining = 0;
+			bool allSucceeded = true;
+		};
+		std::shared_ptr<Progress> progress;
+		stronk_status created = guarded(STRONK_ERROR_OUT_OF_MEMORY, [&]
+										{ progress = std::make_shared<Progress>(); });
+		if (created != STRONK_OK)
+		{
+			return created;
+		}
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			stronk_job *job = &jobs[i];
+			job->output = nullptr;
+			job->output_size = 0;
+			{
+				std::lock_guard<std::mutex> lock(progress->mutex);
+				++progress->remaining;
+			}
+
+			// A job that cannot be queued fails on its own, and the ones already queued are still waited for
+			stronk_status queued = guarded(STRONK_ERROR_CARVE, [&]
+										   { context->pool.submit([context, job, progress]
+																  {
+																	  job->status = job->input ? carveBuffer(*context, job->input, job->input_size, job->target_width, job->target_height,
+																											 job->format, &job->output, &job->output_size)
+																							   : invalidArgument("job input must not be NULL");
+
+																	  std::lock_guard<std::mutex> lock(progress->mutex);
+																	  progress->allSucceeded = progress->allSucceeded && job->status == STRONK_OK;
+																	  if (--progress->remaining == 0)
+																	  {
+																		  progress->finished.notify_all();
+																	  }
+																  }); });
+			if (queued != STRONK_OK)
+			{
+				job->status = queued;
+				std::lock_guard<std::mutex> lock(progress->mutex);
+				progress->allSucceeded = false;
+				--progress->remaining;
+			}
+		}
+
+		std::unique_lock<std::mutex> lock(progress->mutex);
+		progress->finished.wait(lock, [&]
+								{ return progress->remaining == 0; });
+		if (!progress->allSucceeded)
+		{
+			lastError = "One or more jobs failed; see their status";
+			return STRONK_ERROR_CARVE;
+		}
+		lastError.clear();
+		return STRONK_OK;
+	}
+}
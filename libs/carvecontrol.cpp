@@ -0,0 +1,59 @@
+#include <utility>
+
+#include <CarveControl.h>
+
+namespace StronkImage
+{
+	thread_local CarveControl *CarveControl::active = nullptr;
+
+	const char *carveStageName(CarveStage stage)
+	{
+		switch (stage)
+		{
+		case CarveStage::Blur:
+			return "blur";
+		case CarveStage::Grayscale:
+			return "grayscale";
+		case CarveStage::Energy:
+			return "energy";
+		case CarveStage::Seams:
+			return "seams";
+		case CarveStage::Resample:
+			return "resample";
+		default:
+			return "idle";
+		}
+	}
+
+	CarveControl::CarveControl(std::function<void(const CarveProgress &)> callback)
+		: callback(std::move(callback)) {}
+
+	CarveProgress CarveControl::progress() const
+	{
+		CarveProgress snapshot;
+		snapshot.stage = static_cast<CarveStage>(stage.load(std::memory_order_relaxed));
+		snapshot.seamsDone = seamsDone.load(std::memory_order_relaxed);
+		snapshot.seamsTotal = seamsTotal.load(std::memory_order_relaxed);
+		return snapshot;
+	}
+
+	void CarveControl::enterStage(CarveStage newStage)
+	{
+		checkpoint();
+		stage.store(static_cast<int>(newStage), std::memory_order_relaxed);
+		if (callback)
+		{
+			callback(progress());
+		}
+	}
+
+	void CarveControl::setSeams(int done, int total)
+	{
+		seamsDone.store(done, std::memory_order_relaxed);
+		seamsTotal.store(total, std::memory_order_relaxed);
+		if (callback)
+		{
+			callback(progress());
+		}
+	}
+}
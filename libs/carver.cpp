@@ -0,0 +1,253 @@
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <CarveControl.h>
+#include <Carver.h>
+#include <Filter.h>
+#include <Pipeline.h>
+
+namespace StronkImage
+{
+	namespace
+	{
+		CarveResult carveUntil(ImageData &colourImage, int numSeams, const CarveOptions &options, std::chrono::steady_clock::time_point deadline)
+		{
+			if (numSeams <= 0)
+			{
+				return CarveResult();
+			}
+
+			// Out of time already, so skip the energy map as well
+			if (std::chrono::steady_clock::now() >= deadline)
+			{
+				Filter::resampleWidth(colourImage, numSeams, options.region.columnBegin, options.region.columnEnd);
+				CarveResult result;
+				result.resampledSeams = numSeams;
+				return result;
+			}
+
+			ImageData energyMap = Carver::generateEnergyMap(colourImage, options);
+			return Carver::removeSeams(colourImage, energyMap, numSeams, options, deadline);
+		}
+
+		// Thrown on the energy thread when the decode it follows has failed
+		struct DecodeAbandoned
+		{
+		};
+
+		/*
+		 * Sink that stores decoded rows in a colour image and publishes each one to an energy thread, which
+		 * follows the decoder down the image. The thread is started once the size is known and inherits the
+		 * caller's CarveControl, so cancelling the carve stops it as well.
+		 */
+		class EnergyStreamSink : public ScanlineSink
+		{
+		private:
+			static const unsigned int publishRows = 16;
+
+			ImageData &colourImage;
+			const CarveOptions &options;
+			CarveControl *control;
+
+			std::mutex mutex;
+			std::condition_variable rowArrived;
+			unsigned int rowsDecoded = 0;
+			bool abandoned = false;
+
+			std::thread worker;
+			std::exception_ptr workerError;
+			ImageData energyMap;
+
+			void awaitRow(unsigned int y)
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				rowArrived.wait(lock, [this, y]
+								{ return rowsDecoded > y || abandoned; });
+				if (rowsDecoded <= y)
+				{
+					throw DecodeAbandoned();
+				}
+			}
+
+			void computeEnergy()
+			{
+				std::unique_ptr<CarveControlScope> controlScope;
+				if (control)
+				{
+					controlScope.reset(new CarveControlScope(*control));
+				}
+
+				try
+				{
+					energyMap = Filter::streamEnergyMap(colourImage, options.blurSigma, options.blurMode, [this](unsigned int y)
+														{ awaitRow(y); });
+				}
+				catch (...)
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					workerError = std::current_exception();
+				}
+			}
+
+		public:
+			EnergyStreamSink(ImageData &colourImage, const CarveOptions &options)
+				: colourImage(colourImage), options(options), control(CarveControl::current()) {}
+
+			~EnergyStreamSink() { abandon(); }
+
+			void start(unsigned int width, unsigned int height) override
+			{
+				colourImage.resizeBuffer(width, height);
+				worker = std::thread(&EnergyStreamSink::computeEnergy, this);
+			}
+
+			void writeRow(unsigned int y, const uint8_t *rgba) override
+			{
+				RGBPixelBuf *pixels = colourImage.rgbPixelData + static_cast<size_t>(y) * colourImage.width;
+				for (unsigned int x = 0; x < colourImage.width; ++x)
+				{
+					pixels[x] = {rgba[x * 4 + 0], rgba[x * 4 + 1], rgba[x * 4 + 2], rgba[x * 4 + 3]};
+				}
+
+				// Rows are published in small batches to keep the two threads from waking each other for every row
+				if ((y + 1) % publishRows != 0 && y + 1 != colourImage.height)
+				{
+					return;
+				}
+
+				// Releasing the lock publishes the rows; a failed energy pass stops the decode early
+				std::lock_guard<std::mutex> lock(mutex);
+				if (workerError)
+				{
+					std::rethrow_exception(workerError);
+				}
+				rowsDecoded = y + 1;
+				rowArrived.notify_one();
+			}
+
+			// Wait for the energy thread and return its map, or rethrow what stopped it
+			ImageData finish()
+			{
+				worker.join();
+				if (workerError)
+				{
+					std::rethrow_exception(workerError);
+				}
+				return std::move(energyMap);
+			}
+
+			// Stop the energy thread after a failed decode
+			void abandon()
+			{
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					abandoned = true;
+				}
+				rowArrived.notify_one();
+				if (worker.joinable())
+				{
+					worker.join();
+				}
+			}
+		};
+	}
+
+	ImageData Carver::generateEnergyMap(const ImageData &colourImage, const CarveOptions &options)
+	{
+		// Planned as a single-channel blur that converts each colour row as it loads it, then the gradient
+		return Pipeline::energyMap(options.blurSigma, options.blurMode).run(colourImage);
+	}
+
+	ImageData Carver::loadWithEnergyMap(const std::string &imageSpec, ImageData &colourImage, const CarveOptions &options, unsigned int numThreads)
+	{
+		// With a single hardware thread the two passes cannot overlap, so decode first and run the same fused pass
+		if (numThreads == 0)
+		{
+			numThreads = std::thread::hardware_concurrency() > 1 ? 2 : 1;
+		}
+		if (numThreads == 1)
+		{
+			Image image;
+			image.loadFromFile(imageSpec);
+			colourImage = std::move(image.getRawImageData());
+			return Filter::streamEnergyMap(colourImage, options.blurSigma, options.blurMode, [](unsigned int) {});
+		}
+
+		EnergyStreamSink sink(colourImage, options);
+		try
+		{
+			Image::decodeScanlines(imageSpec, sink);
+		}
+		catch (...)
+		{
+			sink.abandon();
+			throw;
+		}
+		return sink.finish();
+	}
+
+	std::chrono::steady_clock::time_point Carver::deadline(const CarveOptions &options)
+	{
+		if (options.timeBudgetSeconds <= 0.0)
+		{
+			return std::chrono::steady_clock::time_point::max();
+		}
+		return std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+													  std::chrono::duration<double>(options.timeBudgetSeconds));
+	}
+
+	CarveResult Carver::removeSeams(ImageData &colourImage, ImageData &energyMap, int numSeams, const CarveOptions &options,
+									std::chrono::steady_clock::time_point deadline)
+	{
+		CarveResult result;
+		result.exactSeams = Filter::removeSeams(colourImage, energyMap, numSeams, options.region, nullptr, deadline);
+		result.resampledSeams = std::max(numSeams, 0) - result.exactSeams;
+
+		if (result.resampledSeams > 0)
+		{
+			// The region lost a column with every exact seam
+			unsigned int columnEnd = options.region.columnEnd == 0 ? 0 : options.region.columnEnd - result.exactSeams;
+			Filter::resampleWidth(colourImage, result.resampledSeams, options.region.columnBegin, columnEnd);
+		}
+
+		return result;
+	}
+
+	CarveResult Carver::carve(ImageData &colourImage, int numSeams, const CarveOptions &options)
+	{
+		return carveUntil(colourImage, numSeams, options, deadline(options));
+	}
+
+	CarveResult Carver::carveTo(ImageData &colourImage, unsigned int targetWidth, unsigned int targetHeight, const CarveOptions &options)
+	{
+		if (targetWidth == 0 || targetHeight == 0 || targetWidth > colourImage.width || targetHeight > colourImage.height)
+		{
+			throw std::invalid_argument("Target dimensions must be positive and no larger than the image");
+		}
+
+		std::chrono::steady_clock::time_point carveDeadline = deadline(options);
+		CarveResult result = carveUntil(colourImage, colourImage.width - targetWidth, options, carveDeadline);
+
+		if (targetHeight < colourImage.height)
+		{
+			// The region describes columns of the original image, which are rows once transposed; only the search mode and strips carry over
+			CarveOptions heightOptions = options;
+			heightOptions.region = SeamRegion();
+			heightOptions.region.seamMode = options.region.seamMode;
+			heightOptions.region.numStrips = options.region.numStrips;
+
+			ImageData transposed = Filter::transpose(colourImage);
+			CarveResult heightResult = carveUntil(transposed, transposed.width - targetHeight, heightOptions, carveDeadline);
+			colourImage = Filter::transpose(transposed);
+
+			result.exactSeams += heightResult.exactSeams;
+			result.resampledSeams += heightResult.resampledSeams;
+		}
+
+		return result;
+	}
+}
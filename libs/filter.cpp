@@ -1,9 +1,18 @@
 #include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <thread>
 #include <vector>
 #include <limits>
+#include <numeric>
 #include <algorithm>
 
+#include <CarveControl.h>
 #include <Filter.h>
+#include <Profiler.h>
+#include <ThreadPool.h>
 
 namespace StronkImage
 {
@@ -36,13 +45,357 @@ namespace StronkImage
         return kernel;
     }
 
-    void Filter::gaussianBlur(ImageData &sourceImage, float sigmaValue)
+    std::vector<int> Filter::boxBlurWidths(float sigma)
+    {
+        // Three boxes of width w have variance 3 * (w * w - 1) / 12; mix the two odd widths around the ideal one
+        const int passes = 3;
+        float idealWidth = std::sqrt(12.0f * sigma * sigma / passes + 1.0f);
+        int lowerWidth = static_cast<int>(std::floor(idealWidth));
+        if (lowerWidth % 2 == 0)
+        {
+            --lowerWidth;
+        }
+        int upperWidth = lowerWidth + 2;
+
+        float lowerPasses = (12.0f * sigma * sigma - passes * lowerWidth * lowerWidth - 4.0f * passes * lowerWidth - 3.0f * passes) / (-4.0f * lowerWidth - 4.0f);
+        int lowerCount = std::clamp(static_cast<int>(std::lround(lowerPasses)), 0, passes);
+
+        std::vector<int> widths;
+        for (int i = 0; i < passes; ++i)
+        {
+            widths.push_back(i < lowerCount ? lowerWidth : upperWidth);
+        }
+        return widths;
+    }
+
+    namespace
+    {
+        // Box filter rows of interleaved float channels in place with a running sum, replicating edge pixels
+        void boxBlurRows(std::vector<float> &pixels, std::vector<float> &line, int width, int height, int channels, int radius)
+        {
+            const float scale = 1.0f / (2 * radius + 1);
+            const size_t rowLength = static_cast<size_t>(width) * channels;
+            line.resize(rowLength);
+
+            for (int y = 0; y < height; ++y)
+            {
+                carveCheckpoint(y);
+                float *row = &pixels[static_cast<size_t>(y) * rowLength];
+                std::copy(row, row + rowLength, line.begin());
+
+                for (int c = 0; c < channels; ++c)
+                {
+                    float sum = (radius + 1) * line[c];
+                    for (int i = 1; i <= radius; ++i)
+                    {
+                        sum += line[std::min(i, width - 1) * channels + c];
+                    }
+
+                    for (int x = 0; x < width; ++x)
+                    {
+                        row[x * channels + c] = sum * scale;
+                        sum += line[std::min(x + radius + 1, width - 1) * channels + c] - line[std::max(x - radius, 0) * channels + c];
+                    }
+                }
+            }
+        }
+
+        // Box filter columns the same way, sweeping whole rows so memory is read in order
+        void boxBlurColumns(std::vector<float> &pixels, std::vector<float> &source, std::vector<float> &sums, int width, int height, int channels, int radius)
+        {
+            const float scale = 1.0f / (2 * radius + 1);
+            const size_t rowLength = static_cast<size_t>(width) * channels;
+            source = pixels;
+            sums.assign(rowLength, 0.0f);
+
+            auto sourceRow = [&](int y)
+            {
+                return &source[static_cast<size_t>(std::clamp(y, 0, height - 1)) * rowLength];
+            };
+
+            for (int j = -radius; j <= radius; ++j)
+            {
+                const float *row = sourceRow(j);
+                for (size_t i = 0; i < rowLength; ++i)
+                {
+                    sums[i] += row[i];
+                }
+            }
+
+            for (int y = 0; y < height; ++y)
+            {
+                carveCheckpoint(y);
+                float *output = &pixels[static_cast<size_t>(y) * rowLength];
+                const float *entering = sourceRow(y + radius + 1);
+                const float *leaving = sourceRow(y - radius);
+                for (size_t i = 0; i < rowLength; ++i)
+                {
+                    output[i] = sums[i] * scale;
+                    sums[i] += entering[i] - leaving[i];
+                }
+            }
+        }
+
+        void boxBlur(ImageData &sourceImage, float sigmaValue)
+        {
+            const int width = sourceImage.width;
+            const int height = sourceImage.height;
+            const size_t pixelCount = static_cast<size_t>(width) * height;
+
+            // Floats between the passes keep the three roundings from compounding
+            std::vector<float> pixels(pixelCount * 3);
+            for (size_t i = 0; i < pixelCount; ++i)
+            {
+                pixels[i * 3 + 0] = sourceImage.rgbPixelData[i].red;
+                pixels[i * 3 + 1] = sourceImage.rgbPixelData[i].green;
+                pixels[i * 3 + 2] = sourceImage.rgbPixelData[i].blue;
+            }
+
+            std::vector<float> scratch, sums;
+            for (int boxWidth : Filter::boxBlurWidths(sigmaValue))
+            {
+                int radius = boxWidth / 2;
+                boxBlurRows(pixels, scratch, width, height, 3, radius);
+                boxBlurColumns(pixels, scratch, sums, width, height, 3, radius);
+            }
+
+            // Round rather than truncate: the running sums drift by a few ulps, which would turn flat 128 into 127
+            auto toQuantum = [](float value)
+            {
+                return static_cast<Quantum>(std::clamp(std::lround(value), 0L, 255L));
+            };
+            for (size_t i = 0; i < pixelCount; ++i)
+            {
+                sourceImage.rgbPixelData[i] = {toQuantum(pixels[i * 3 + 0]), toQuantum(pixels[i * 3 + 1]), toQuantum(pixels[i * 3 + 2]), 255};
+            }
+        }
+    }
+
+    namespace
+    {
+        // Normalised 1D Gaussian whose outer product with itself is the 2D kernel of generateGaussianKernel
+        std::vector<float> gaussianWeights(float sigma)
+        {
+            int kernelSize = static_cast<int>(std::ceil(6 * sigma)) | 1;
+            int centre = kernelSize / 2;
+            std::vector<float> weights(kernelSize);
+            float sum = 0.0f;
+            for (int i = 0; i < kernelSize; ++i)
+            {
+                weights[i] = std::exp(-((i - centre) * (i - centre)) / (2 * sigma * sigma));
+                sum += weights[i];
+            }
+            for (float &weight : weights)
+            {
+                weight /= sum;
+            }
+            return weights;
+        }
+
+        /*
+         * The separable form of the exact 2D Gaussian over one channel, produced one row at a time from the
+         * top. Source rows are pulled through loadRow(y, float *row) only when the window reaches them and
+         * are blurred horizontally into a ring of kernelSize rows, so each is read once and no full-size
+         * float copy exists. Results are truncated like the colour blur.
+         */
+        template <typename LoadRow>
+        class GaussianRows
+        {
+        private:
+            int width, height;
+            LoadRow loadRow;
+            std::vector<float> weights;
+            int kernelSize, centre;
+            std::vector<float> ring;
+            std::vector<int> ringRow;
+            std::vector<float> line;
+            int nextRow = 0;
+
+        public:
+            GaussianRows(int width, int height, float sigma, LoadRow loadRow)
+                : width(width), height(height), loadRow(loadRow), weights(gaussianWeights(sigma)),
+                  kernelSize(static_cast<int>(weights.size())), centre(kernelSize / 2),
+                  ring(static_cast<size_t>(kernelSize) * width), ringRow(kernelSize, -1), line(width) {}
+
+            // Write the next blurred row to output
+            void next(uint8_t *output)
+            {
+                const int y = nextRow++;
+
+                // Locals, since a byte-wide output may alias the members and would force them to be reloaded
+                const int width = this->width;
+                const int height = this->height;
+                const int kernelSize = this->kernelSize;
+                const int centre = this->centre;
+                const float *weights = this->weights.data();
+                float *ring = this->ring.data();
+                float *line = this->line.data();
+
+                // Bring the window of horizontally blurred rows up to date
+                for (int j = -centre; j <= centre; ++j)
+                {
+                    int sourceY = std::clamp(y + j, 0, height - 1);
+                    int slot = sourceY % kernelSize;
+                    if (ringRow[slot] == sourceY)
+                    {
+                        continue;
+                    }
+
+                    loadRow(sourceY, line);
+                    float *blurred = &ring[static_cast<size_t>(slot) * width];
+                    for (int x = 0; x < width; ++x)
+                    {
+                        float sum = 0.0f;
+                        for (int i = 0; i < kernelSize; ++i)
+                        {
+                            sum += line[std::clamp(x + i - centre, 0, width - 1)] * weights[i];
+                        }
+                        blurred[x] = sum;
+                    }
+                    ringRow[slot] = sourceY;
+                }
+
+                for (int x = 0; x < width; ++x)
+                {
+                    float sum = 0.0f;
+                    for (int j = 0; j < kernelSize; ++j)
+                    {
+                        sum += ring[static_cast<size_t>(std::clamp(y + j - centre, 0, height - 1) % kernelSize) * width + x] * weights[j];
+                    }
+                    output[x] = static_cast<uint8_t>(std::min(sum, 255.0f));
+                }
+            }
+        };
+
+        /*
+         * Blur one channel supplied row by row through loadRow(y, float *row). Exact mode streams through
+         * GaussianRows. Box mode needs the whole channel for its column sweeps.
+         */
+        template <typename LoadRow>
+        GrayImageData blurChannel(int width, int height, float sigma, BlurMode mode, LoadRow loadRow)
+        {
+            GrayImageData result(width, height);
+
+            if (mode == BlurMode::Box)
+            {
+                std::vector<float> pixels(static_cast<size_t>(width) * height);
+                for (int y = 0; y < height; ++y)
+                {
+                    loadRow(y, &pixels[static_cast<size_t>(y) * width]);
+                }
+
+                std::vector<float> scratch, sums;
+                for (int boxWidth : Filter::boxBlurWidths(sigma))
+                {
+                    boxBlurRows(pixels, scratch, width, height, 1, boxWidth / 2);
+                    boxBlurColumns(pixels, scratch, sums, width, height, 1, boxWidth / 2);
+                }
+
+                for (size_t i = 0; i < pixels.size(); ++i)
+                {
+                    result.pixels[i] = static_cast<uint8_t>(std::clamp(std::lround(pixels[i]), 0L, 255L));
+                }
+                return result;
+            }
+
+            GaussianRows<LoadRow> rows(width, height, sigma, loadRow);
+            for (int y = 0; y < height; ++y)
+            {
+                carveCheckpoint(y);
+                rows.next(result.row(y));
+            }
+            return result;
+        }
+
+        /*
+         * Sobel X, Sobel Y and the gradient magnitude in one pass over rows supplied by
+         * loadRow(y, scratch), which returns the row either in place or converted into scratch. Only a
+         * three-row window is kept, and neither gradient image is materialised.
+         */
+        template <typename LoadRow>
+        ImageData gradientMagnitude(int width, int height, LoadRow loadRow)
+        {
+            using Taps = std::make_integer_sequence<int, 9>;
+
+            ImageData energyMap(width, height);
+            std::vector<uint8_t> scratch(static_cast<size_t>(3) * width);
+            const uint8_t *window[3] = {nullptr, nullptr, nullptr};
+            int windowRow[3] = {-1, -1, -1};
+
+            auto fetch = [&](int y)
+            {
+                int slot = y % 3;
+                if (windowRow[slot] != y)
+                {
+                    window[slot] = loadRow(y, &scratch[static_cast<size_t>(slot) * width]);
+                    windowRow[slot] = y;
+                }
+                return window[slot];
+            };
+
+            // Same clamping as the separate passes: each gradient to [0, 255], then the magnitude
+            auto energy = [](int sumX, int sumY)
+            {
+                int sobelX = detail::kernelResult<Kernels::SobelX>(sumX);
+                int sobelY = detail::kernelResult<Kernels::SobelY>(sumY);
+                Quantum value = static_cast<Quantum>(std::min(static_cast<int>(std::sqrt(sobelX * sobelX + sobelY * sobelY)), 255));
+                return RGBPixelBuf{value, value, value, 255};
+            };
+
+            for (int y = 0; y < height; ++y)
+            {
+                carveCheckpoint(y);
+
+                const uint8_t *rows[3];
+                rows[0] = fetch(std::max(y - 1, 0));
+                rows[1] = fetch(y);
+                rows[2] = fetch(std::min(y + 1, height - 1));
+                RGBPixelBuf *output = energyMap.rgbPixelData + static_cast<size_t>(y) * width;
+
+                auto clampedColumn = [&](int x)
+                {
+                    int columns[3] = {std::max(x - 1, 0), x, std::min(x + 1, width - 1)};
+                    output[x] = energy(detail::applyKernel<Kernels::SobelX>(rows, columns, Taps()),
+                                       detail::applyKernel<Kernels::SobelY>(rows, columns, Taps()));
+                };
+
+                clampedColumn(0);
+
+                // Interior: offsets are fixed, so the rows are advanced instead of the columns recomputed
+                const int columns[3] = {-1, 0, 1};
+                for (int x = 1; x < width - 1; ++x)
+                {
+                    const uint8_t *shifted[3] = {rows[0] + x, rows[1] + x, rows[2] + x};
+                    output[x] = energy(detail::applyKernel<Kernels::SobelX>(shifted, columns, Taps()),
+                                       detail::applyKernel<Kernels::SobelY>(shifted, columns, Taps()));
+                }
+
+                if (width > 1)
+                {
+                    clampedColumn(width - 1);
+                }
+            }
+
+            return energyMap;
+        }
+    }
+
+    void Filter::gaussianBlur(ImageData &sourceImage, float sigmaValue, BlurMode mode)
     {
         if (sigmaValue == 0.0f)
         {
             return; // Skip the processing if sigma value is 0.0
         }
 
+        STRONK_PROFILE_SCOPE("blur");
+        reportCarveStage(CarveStage::Blur);
+
+        if (mode == BlurMode::Box)
+        {
+            boxBlur(sourceImage, sigmaValue);
+            return;
+        }
+
         // Generate the Gaussian kernel
         int kernelSize = static_cast<int>(std::ceil(6 * sigmaValue)) | 1; // Ensure odd kernel size
         std::vector<std::vector<float>> kernel = generateGaussianKernel(kernelSize, sigmaValue);
@@ -54,6 +407,7 @@ namespace StronkImage
         int center = kernelSize / 2;
         for (int y = 0; y < sourceImage.getHeight(); ++y)
         {
+            carveCheckpoint(y);
             for (int x = 0; x < sourceImage.getWidth(); ++x)
             {
                 float sumRed = 0.0f, sumGreen = 0.0f, sumBlue = 0.0f;
@@ -80,12 +434,49 @@ namespace StronkImage
             }
         }
 
-        // Copy the temporary image data back into the source image
-        sourceImage = tempImage;
+        // Hand the temporary buffer to the source image; its old buffer goes back to the pool
+        sourceImage = std::move(tempImage);
+    }
+
+    void Filter::gaussianBlur(GrayImageData &grayscaleImage, float sigmaValue, BlurMode mode)
+    {
+        if (sigmaValue == 0.0f)
+        {
+            return;
+        }
+
+        STRONK_PROFILE_SCOPE("blur");
+        reportCarveStage(CarveStage::Blur);
+
+        const GrayImageData &source = grayscaleImage;
+        grayscaleImage = blurChannel(source.width, source.height, sigmaValue, mode, [&source](int y, float *row)
+                                     { std::copy(source.row(y), source.row(y) + source.width, row); });
     }
 
-    ImageData Filter::ConvoluteSobelMatrix(ImageData &sourceImage, int matrix[3][3])
+    GrayImageData Filter::blurredGrayscale(const ImageData &colourImage, float sigmaValue, BlurMode mode)
     {
+        if (sigmaValue == 0.0f)
+        {
+            return genGrayscale(colourImage);
+        }
+
+        STRONK_PROFILE_SCOPE("blur");
+        reportCarveStage(CarveStage::Blur);
+
+        // Luminance is computed as each colour row is loaded, so no grayscale image is stored in between
+        return blurChannel(colourImage.width, colourImage.height, sigmaValue, mode, [&colourImage](int y, float *row)
+                           {
+                               const RGBPixelBuf *pixel = colourImage.rgbPixelData + static_cast<size_t>(y) * colourImage.width;
+                               for (unsigned int x = 0; x < colourImage.width; ++x)
+                               {
+                                   row[x] = luma(pixel[x].red, pixel[x].green, pixel[x].blue);
+                               } });
+    }
+
+    ImageData Filter::ConvoluteSobelMatrix(ImageData &sourceImage, const int matrix[3][3])
+    {
+        STRONK_PROFILE_SCOPE("sobel");
+
         // Get the dimensions of the source image
         int width = sourceImage.width;
         int height = sourceImage.height;
@@ -125,161 +516,1009 @@ namespace StronkImage
         return tempImage;
     }
 
-    void Filter::genGrayscaleData(ImageData &colourImage)
+    GrayImageData Filter::ConvoluteSobelMatrix(const GrayImageData &grayscaleImage, const int matrix[3][3])
     {
-        for (int y = 0; y < colourImage.height; ++y)
+        STRONK_PROFILE_SCOPE("sobel");
+
+        int width = grayscaleImage.width;
+        int height = grayscaleImage.height;
+        GrayImageData tempImage(width, height);
+
+        for (int y = 0; y < height; ++y)
         {
-            for (int x = 0; x < colourImage.width; ++x)
-            {
-                // Get the current pixel
-                RGBPixelBuf pixel = colourImage.getPixel(x, y);
+            // Clamp the neighbouring rows once per row rather than once per tap
+            const uint8_t *rows[3] = {
+                grayscaleImage.row(std::max(y - 1, 0)),
+                grayscaleImage.row(y),
+                grayscaleImage.row(std::min(y + 1, height - 1))};
+            uint8_t *outputRow = tempImage.row(y);
 
-                // Calculate the grayscale value using the luminance formula:
-                // Y = 0.299 * R + 0.587 * G + 0.114 * B
-                Quantum grayValue = static_cast<Quantum>(0.299 * pixel.red + 0.587 * pixel.green + 0.114 * pixel.blue);
+            for (int x = 0; x < width; ++x)
+            {
+                int columns[3] = {std::max(x - 1, 0), x, std::min(x + 1, width - 1)};
 
-                // Set the grayscale value to the red, green, and blue channels
-                pixel.red = grayValue;
-                pixel.green = grayValue;
-                pixel.blue = grayValue;
+                int sum = 0;
+                for (int j = 0; j < 3; ++j)
+                {
+                    for (int i = 0; i < 3; ++i)
+                    {
+                        sum += rows[j][columns[i]] * matrix[j][i];
+                    }
+                }
 
-                // Update the pixel in the image
-                colourImage.setPixel(x, y, pixel);
+                outputRow[x] = static_cast<uint8_t>(std::min(std::max(sum, 0), 255));
             }
         }
+
+        return tempImage;
     }
 
-    ImageData Filter::generateEnergyMap(ImageData &sourceImage)
+    void Filter::genGrayscaleData(ImageData &colourImage)
     {
-        // Create grayscale copy of the source image
-        ImageData grayscaleImage = sourceImage;
-        // Convert the grayscaleImage to actual grayscale
-        // Assume genGrayscaleData() is a static method
-        Filter::genGrayscaleData(grayscaleImage);
+        STRONK_PROFILE_SCOPE("grayscale");
+        reportCarveStage(CarveStage::Grayscale);
 
-        // Apply Sobel filters
-        ImageData sobelXImage = ConvoluteSobelMatrix(grayscaleImage, sobelMatrixX);
-        ImageData sobelYImage = ConvoluteSobelMatrix(grayscaleImage, sobelMatrixY);
+        RGBPixelBuf *pixel = colourImage.rgbPixelData;
+        RGBPixelBuf *end = pixel + static_cast<size_t>(colourImage.width) * colourImage.height;
+        for (; pixel != end; ++pixel)
+        {
+            // Set the shared luminance value to the red, green, and blue channels
+            Quantum grayValue = luma(pixel->red, pixel->green, pixel->blue);
+            pixel->red = grayValue;
+            pixel->green = grayValue;
+            pixel->blue = grayValue;
+        }
+    }
+
+    GrayImageData Filter::genGrayscale(const ImageData &colourImage)
+    {
+        STRONK_PROFILE_SCOPE("grayscale");
+        reportCarveStage(CarveStage::Grayscale);
 
-        // Calculate energy map
-        ImageData energyMap(sourceImage.width, sourceImage.height);
-        for (int y = 0; y < sourceImage.height; ++y)
+        GrayImageData grayscaleImage(colourImage.width, colourImage.height);
+
+        const RGBPixelBuf *pixel = colourImage.rgbPixelData;
+        uint8_t *gray = grayscaleImage.pixels;
+        size_t pixelCount = static_cast<size_t>(colourImage.width) * colourImage.height;
+        for (size_t i = 0; i < pixelCount; ++i)
         {
-            for (int x = 0; x < sourceImage.width; ++x)
-            {
-                // Get the corresponding Sobel values for the current pixel
-                int sobelX = sobelXImage.getPixel(x, y).red;
-                int sobelY = sobelYImage.getPixel(x, y).red;
+            gray[i] = luma(pixel[i].red, pixel[i].green, pixel[i].blue);
+        }
 
-                // Calculate the energy value (gradient magnitude)
-                int energy = static_cast<int>(std::sqrt(sobelX * sobelX + sobelY * sobelY));
+        return grayscaleImage;
+    }
+
+    ImageData Filter::generateEnergyMap(const ImageData &colourImage)
+    {
+        STRONK_PROFILE_SCOPE("energy");
+        reportCarveStage(CarveStage::Energy);
+
+        // Luminance is computed row by row inside the Sobel window instead of as a separate image
+        return gradientMagnitude(colourImage.width, colourImage.height, [&colourImage](int y, uint8_t *scratch)
+                                 {
+                                     const RGBPixelBuf *pixel = colourImage.rgbPixelData + static_cast<size_t>(y) * colourImage.width;
+                                     for (unsigned int x = 0; x < colourImage.width; ++x)
+                                     {
+                                         scratch[x] = luma(pixel[x].red, pixel[x].green, pixel[x].blue);
+                                     }
+                                     return static_cast<const uint8_t *>(scratch); });
+    }
+
+    ImageData Filter::generateEnergyMap(const GrayImageData &grayscaleImage)
+    {
+        STRONK_PROFILE_SCOPE("energy");
+        reportCarveStage(CarveStage::Energy);
 
-                // Clamp the energy value to the range [0, 255]
-                energy = std::min(std::max(energy, 0), 255);
+        // Sobel filters unrolled at compile time, fused with the magnitude so no gradient image is stored
+        return gradientMagnitude(grayscaleImage.width, grayscaleImage.height, [&grayscaleImage](int y, uint8_t *)
+                                 { return grayscaleImage.row(y); });
+    }
 
-                // Set the energy value to the energy map
-                energyMap.setPixel(x, y, {static_cast<Quantum>(energy), static_cast<Quantum>(energy), static_cast<Quantum>(energy), 255});
+    ImageData Filter::streamEnergyMap(const ImageData &colourImage, float sigmaValue, BlurMode mode, const std::function<void(unsigned int)> &awaitRow)
+    {
+        STRONK_PROFILE_SCOPE("energy");
+        reportCarveStage(CarveStage::Energy);
+
+        const int width = colourImage.width;
+        const int height = colourImage.height;
+        auto lumaRow = [&colourImage, &awaitRow](int y, auto *row)
+        {
+            awaitRow(y);
+            const RGBPixelBuf *pixel = colourImage.rgbPixelData + static_cast<size_t>(y) * colourImage.width;
+            for (unsigned int x = 0; x < colourImage.width; ++x)
+            {
+                row[x] = luma(pixel[x].red, pixel[x].green, pixel[x].blue);
             }
+        };
+
+        if (sigmaValue == 0.0f)
+        {
+            return gradientMagnitude(width, height, [&lumaRow](int y, uint8_t *scratch)
+                                     {
+                                         lumaRow(y, scratch);
+                                         return static_cast<const uint8_t *>(scratch); });
         }
 
-        return energyMap;
+        if (mode == BlurMode::Box)
+        {
+            GrayImageData blurred = blurChannel(width, height, sigmaValue, mode, lumaRow);
+            return gradientMagnitude(width, height, [&blurred](int y, uint8_t *)
+                                     { return blurred.row(y); });
+        }
+
+        // The Sobel window asks for each row once, top to bottom, which is the order the blur produces them in
+        GaussianRows<decltype(lumaRow)> blurredRows(width, height, sigmaValue, lumaRow);
+        return gradientMagnitude(width, height, [&blurredRows](int, uint8_t *scratch)
+                                 {
+                                     blurredRows.next(scratch);
+                                     return static_cast<const uint8_t *>(scratch); });
     }
 
-    void Filter::removeSeams(ImageData &sourceImage, ImageData &energyMap, int numSeams)
+    namespace
     {
-        for (int seamCount = 0; seamCount < numSeams; ++seamCount)
+        // Parent of a cost matrix cell in the row above, packed two bits per cell
+        enum SeamDirection : uint8_t
+        {
+            SeamUp = 0,
+            SeamUpLeft = 1,
+            SeamUpRight = 2
+        };
+
+        // Scratch buffers for the seam search, kept across the seams of one removeSeams call
+        struct SeamWorkspace
+        {
+            std::vector<uint32_t> previousCost;
+            std::vector<uint32_t> currentCost;
+            std::vector<uint8_t> directions;
+            std::vector<int> candidates;
+            std::vector<int> path;
+
+            // Strip search only: the column each path entered its strip at, and the stitched cost of ending
+            // the strip at each column together with the end of the strip above it continues from
+            std::vector<int> previousOrigin;
+            std::vector<int> currentOrigin;
+            std::vector<uint32_t> stitchedCost;
+            std::vector<int> stitchedFrom;
+        };
+
+        // Number of top-row cells a greedy search starts from
+        const size_t greedySeamStarts = 8;
+
+        // Path cost of cells no seam may pass through
+        const uint32_t blockedCost = std::numeric_limits<uint32_t>::max();
+
+        /*
+         * Energy of the pixels still in the image, one byte each, with rows stride bytes apart so removing a
+         * seam only shifts the tail of every row. columns, when set, holds the column each live pixel had in
+         * the image removeSeams was given; the mask is read through it, so it never has to be compacted.
+         */
+        struct EnergyView
+        {
+            const uint8_t *values;
+            const uint32_t *columns;
+            int width;
+            int height;
+            size_t stride;
+
+            const uint8_t *row(int y) const { return values + static_cast<size_t>(y) * stride; }
+
+            int originalColumn(int x, int y) const { return columns ? columns[static_cast<size_t>(y) * stride + x] : x; }
+        };
+
+        // The first channel of an energy map, which holds the whole energy value, one byte per pixel
+        std::vector<uint8_t> energyBytes(const ImageData &energyMap)
+        {
+            size_t pixelCount = static_cast<size_t>(energyMap.width) * energyMap.height;
+            std::vector<uint8_t> values(pixelCount);
+            for (size_t i = 0; i < pixelCount; ++i)
+            {
+                values[i] = static_cast<uint8_t>(energyMap.rgbPixelData[i].red);
+            }
+            return values;
+        }
+
+        EnergyView viewOf(const std::vector<uint8_t> &values, const ImageData &energyMap)
+        {
+            return {values.data(), nullptr, static_cast<int>(energyMap.width), static_cast<int>(energyMap.height), energyMap.width};
+        }
+
+        /*
+         * One row of the forward pass over columns [lo, hi]: each cell adds its energy to the cheapest of the
+         * three cells above it, and records which one that was two bits per cell.
+         */
+        template <typename Allowed>
+        inline void relaxSeamRow(const uint32_t *previousCost, uint32_t *currentCost, const uint8_t *energyRow, uint8_t *directionRow,
+                                 int lo, int hi, int y, const Allowed &allowed)
+        {
+            uint8_t packed = 0;
+            for (int x = lo; x <= hi; ++x)
+            {
+                // Ties prefer straight up, then left, exactly as the old traceback did
+                uint32_t best = previousCost[x];
+                uint8_t direction = SeamUp;
+
+                if (x > lo && previousCost[x - 1] < best)
+                {
+                    best = previousCost[x - 1];
+                    direction = SeamUpLeft;
+                }
+
+                if (x < hi && previousCost[x + 1] < best)
+                {
+                    best = previousCost[x + 1];
+                    direction = SeamUpRight;
+                }
+
+                currentCost[x] = best == blockedCost || !allowed(x, y) ? blockedCost : energyRow[x] + best;
+
+                packed |= direction << ((x & 3) * 2);
+                if ((x & 3) == 3)
+                {
+                    directionRow[x >> 2] = packed;
+                    packed = 0;
+                }
+            }
+            if ((hi & 3) != 3)
+            {
+                directionRow[hi >> 2] = packed;
+            }
+        }
+
+        /*
+         * Search columns [firstColumn, lastColumn] for the cheapest seam. Cells where mask is zero are
+         * blocked. Only that band of every row is read, so a narrow region costs proportionally less.
+         * With a guide seam, row y is further limited to bandRadius columns either side of guide[y].
+         */
+        void findSeam(const EnergyView &energy, SeamWorkspace &workspace, std::vector<int> &seam,
+                      int firstColumn, int lastColumn, const GrayImageData *mask,
+                      const std::vector<int> *guide = nullptr, int bandRadius = 0)
         {
-            // Step 2: Initialize a minimum path energy 2D array
-            ImageData minPathEnergy(sourceImage.getWidth(), sourceImage.getHeight());
+            const int width = energy.width;
+            const int height = energy.height;
+
+            if (width < 3)
+            {
+                throw std::invalid_argument("Image is too narrow to remove another seam");
+            }
+
+            // The outermost rows and columns never take part in the search, matching the Sobel border
+            firstColumn = std::max(firstColumn, 1);
+            lastColumn = std::min(lastColumn, width - 2);
+            if (firstColumn > lastColumn)
+            {
+                throw std::invalid_argument("Seam region has no removable columns");
+            }
+
+            auto allowed = [mask, &energy](int x, int y)
+            {
+                return !mask || mask->pixels[static_cast<size_t>(y) * mask->width + energy.originalColumn(x, y)] != 0;
+            };
+
+            if (guide && guide->size() != static_cast<size_t>(height))
+            {
+                guide = nullptr;
+            }
 
-            // Step 3: Iterate through each pixel in the energy map
-            for (unsigned int y = 1; y < sourceImage.getHeight() - 1; ++y)
+            // Columns searched in row y
+            auto rowRange = [&](int y, int &lo, int &hi)
             {
-                for (unsigned int x = 1; x < sourceImage.getWidth() - 1; ++x)
+                lo = firstColumn;
+                hi = lastColumn;
+                if (guide)
+                {
+                    int centre = std::min(std::max((*guide)[y], firstColumn), lastColumn);
+                    lo = std::max(lo, centre - bandRadius);
+                    hi = std::min(hi, centre + bandRadius);
+                }
+            };
+
+            const int rowBytes = (width + 3) / 4;
+            std::vector<uint32_t> &previousCost = workspace.previousCost;
+            std::vector<uint32_t> &currentCost = workspace.currentCost;
+            std::vector<uint8_t> &directions = workspace.directions;
+            previousCost.resize(width);
+            currentCost.resize(width);
+            directions.resize(static_cast<size_t>(rowBytes) * height);
+
+            // Every path starts from the top row with zero energy
+            int lo, hi;
+            rowRange(height < 3 ? 0 : 1, lo, hi);
+            for (int x = lo; x <= hi; ++x)
+            {
+                previousCost[x] = allowed(x, 0) ? 0 : blockedCost;
+            }
+
+            {
+                STRONK_PROFILE_SCOPE("dp");
+
+                for (int y = 1; y < height - 1; ++y)
                 {
-                    int currentEnergy = energyMap.getPixel(x, y).red;
-                    int minEnergy = minPathEnergy.getPixel(x, y - 1).red;
+                    carveCheckpoint(y);
 
-                    if (x > 1)
+                    // A band that moves sideways reaches cells the row above never computed
+                    int previousLo = lo, previousHi = hi;
+                    rowRange(y, lo, hi);
+                    for (int x = lo; x <= std::min(hi, previousLo - 1); ++x)
                     {
-                        int leftEnergy = minPathEnergy.getPixel(x - 1, y - 1).red;
-                        minEnergy = std::min(minEnergy, leftEnergy);
+                        previousCost[x] = blockedCost;
                     }
-
-                    if (x < sourceImage.getWidth() - 2)
+                    for (int x = std::max(lo, previousHi + 1); x <= hi; ++x)
                     {
-                        int rightEnergy = minPathEnergy.getPixel(x + 1, y - 1).red;
-                        minEnergy = std::min(minEnergy, rightEnergy);
+                        previousCost[x] = blockedCost;
                     }
 
-                    minPathEnergy.setPixel(x, y, RGBPixelBuf{(unsigned int)currentEnergy + minEnergy, 0, 0, 0});
+                    relaxSeamRow(previousCost.data(), currentCost.data(), energy.row(y), directions.data() + static_cast<size_t>(y) * rowBytes, lo, hi, y, allowed);
+
+                    std::swap(previousCost, currentCost);
                 }
             }
 
-            // Step 4: Find the pixel with the minimum energy value in the bottom row
-            int minIdx = 1;
-            int minEnergy = minPathEnergy.getPixel(1, sourceImage.getHeight() - 2).red;
-            for (unsigned int x = 2; x < sourceImage.getWidth() - 1; ++x)
+            STRONK_PROFILE_SCOPE("traceback");
+
+            // Find the cheapest end point whose continuation into the bottom row is allowed
+            int minIdx = -1;
+            for (int x = lo; x <= hi; ++x)
             {
-                int currentEnergy = minPathEnergy.getPixel(x, sourceImage.getHeight() - 2).red;
-                if (currentEnergy < minEnergy)
+                if (previousCost[x] != blockedCost && allowed(x, height - 1) && (minIdx < 0 || previousCost[x] < previousCost[minIdx]))
                 {
-                    minEnergy = currentEnergy;
                     minIdx = x;
                 }
             }
 
-            // Step 5: Trace back the lowest energy seam
-            std::vector<int> seam(sourceImage.getHeight());
-            seam[sourceImage.getHeight() - 1] = minIdx;
+            if (minIdx < 0)
+            {
+                throw std::runtime_error("No removable seam left in the seam region");
+            }
+
+            // Follow the recorded parents back up; the border rows continue the seam straight
+            seam.resize(height);
+            seam[height - 1] = minIdx;
+            if (height < 3)
+            {
+                seam[0] = minIdx;
+                return;
+            }
 
-            for (int y = sourceImage.getHeight() - 2; y > 0; --y)
+            seam[height - 2] = minIdx;
+            for (int y = height - 2; y > 1; --y)
             {
-                int minEnergy = minPathEnergy.getPixel(seam[y + 1], y).red;
-                seam[y] = seam[y + 1];
+                size_t cell = static_cast<size_t>(y) * rowBytes;
+                uint8_t direction = (directions[cell + (seam[y] >> 2)] >> ((seam[y] & 3) * 2)) & 3;
+                seam[y - 1] = seam[y] + (direction == SeamUpLeft ? -1 : direction == SeamUpRight ? 1 : 0);
+            }
+            seam[0] = seam[1];
+        }
+    }
+
+    namespace
+    {
+        /*
+         * Greedy counterpart of findSeam with the same region, mask and border rules. Each path starts at one
+         * of the cheapest cells of row 1 and steps to the cheapest allowed cell of the three below it, with
+         * ties broken like the exact search; the cheapest complete path wins.
+         */
+        void findGreedyPath(const EnergyView &energyMap, SeamWorkspace &workspace, std::vector<int> &seam,
+                            int firstColumn, int lastColumn, const GrayImageData *mask)
+        {
+            const int width = energyMap.width;
+            const int height = energyMap.height;
 
-                if (seam[y + 1] > 1)
+            // Too few rows to walk; the exact search is just as cheap here
+            if (height < 3)
+            {
+                findSeam(energyMap, workspace, seam, firstColumn, lastColumn, mask);
+                return;
+            }
+
+            if (width < 3)
+            {
+                throw std::invalid_argument("Image is too narrow to remove another seam");
+            }
+
+            firstColumn = std::max(firstColumn, 1);
+            lastColumn = std::min(lastColumn, width - 2);
+            if (firstColumn > lastColumn)
+            {
+                throw std::invalid_argument("Seam region has no removable columns");
+            }
+
+            STRONK_PROFILE_SCOPE("greedy");
+
+            auto allowed = [mask, &energyMap](int x, int y)
+            {
+                return !mask || mask->pixels[static_cast<size_t>(y) * mask->width + energyMap.originalColumn(x, y)] != 0;
+            };
+            auto energy = [&energyMap](int x, int y)
+            {
+                return energyMap.row(y)[x];
+            };
+
+            // The cheapest starting cells, ordered by energy and then column so the result is deterministic
+            std::vector<int> &candidates = workspace.candidates;
+            candidates.clear();
+            for (int x = firstColumn; x <= lastColumn; ++x)
+            {
+                if (allowed(x, 0) && allowed(x, 1))
                 {
-                    int leftEnergy = minPathEnergy.getPixel(seam[y + 1] - 1, y).red;
-                    if (leftEnergy < minEnergy)
+                    candidates.push_back(x);
+                }
+            }
+
+            auto cheaper = [&](int a, int b)
+            {
+                return energy(a, 1) != energy(b, 1) ? energy(a, 1) < energy(b, 1) : a < b;
+            };
+            size_t starts = std::min(greedySeamStarts, candidates.size());
+            std::partial_sort(candidates.begin(), candidates.begin() + starts, candidates.end(), cheaper);
+
+            std::vector<int> &path = workspace.path;
+            path.resize(height);
+            uint64_t bestCost = std::numeric_limits<uint64_t>::max();
+
+            for (size_t start = 0; start < starts; ++start)
+            {
+                carveCheckpoint();
+
+                int x = candidates[start];
+                uint64_t cost = energy(x, 1);
+                path[1] = x;
+
+                bool complete = true;
+                for (int y = 2; y < height - 1 && complete; ++y)
+                {
+                    // Ties prefer straight down, then left, as in the exact search
+                    int next = -1;
+                    for (int candidate : {x, x - 1, x + 1})
                     {
-                        minEnergy = leftEnergy;
-                        seam[y] = seam[y + 1] - 1;
+                        if (candidate >= firstColumn && candidate <= lastColumn && allowed(candidate, y) &&
+                            (next < 0 || energy(candidate, y) < energy(next, y)))
+                        {
+                            next = candidate;
+                        }
+                    }
+
+                    complete = next >= 0;
+                    if (complete)
+                    {
+                        x = next;
+                        cost += energy(x, y);
+                        path[y] = x;
                     }
                 }
 
-                if (seam[y + 1] < sourceImage.getWidth() - 2)
+                if (complete && allowed(x, height - 1) && cost < bestCost)
                 {
-                    int rightEnergy = minPathEnergy.getPixel(seam[y + 1] + 1, y).red;
-                    if (rightEnergy < minEnergy)
+                    bestCost = cost;
+                    seam.swap(path);
+                    path.resize(height);
+                }
+            }
+
+            if (bestCost == std::numeric_limits<uint64_t>::max())
+            {
+                throw std::runtime_error("No removable seam left in the seam region");
+            }
+
+            // The border rows continue the seam straight, as in the exact search
+            seam[0] = seam[1];
+            seam[height - 1] = seam[height - 2];
+        }
+    }
+
+    namespace
+    {
+        // Strips that fit an image of the given height, each with at least minimumStripRows interior rows
+        unsigned int stripCount(unsigned int requested, int height)
+        {
+            if (requested == 0)
+            {
+                requested = std::max(1u, std::thread::hardware_concurrency());
+            }
+            int fitting = std::max(height - 2, 0) / static_cast<int>(Filter::minimumStripRows);
+            return std::max(1u, std::min(requested, static_cast<unsigned int>(fitting)));
+        }
+
+        /*
+         * Strip-parallel counterpart of findSeam with the same region, mask and border rules, searching one
+         * strip of interior rows per workspace. Every strip's forward pass starts from zero cost, so the
+         * passes are independent and the first runs on the calling thread while the pool takes the rest;
+         * the directions of all strips share the first workspace, as the strips own disjoint rows. Each
+         * pass also carries the column every path entered its strip at, which is all the stitching needs.
+         */
+        void findStripPath(const EnergyView &energy, std::vector<SeamWorkspace> &workspaces, std::vector<int> &seam,
+                           int firstColumn, int lastColumn, const GrayImageData *mask, ThreadPool *pool)
+        {
+            const int width = energy.width;
+            const int height = energy.height;
+            const int numStrips = static_cast<int>(workspaces.size());
+
+            if (numStrips < 2 || height < 3)
+            {
+                findSeam(energy, workspaces[0], seam, firstColumn, lastColumn, mask);
+                return;
+            }
+
+            if (width < 3)
+            {
+                throw std::invalid_argument("Image is too narrow to remove another seam");
+            }
+
+            firstColumn = std::max(firstColumn, 1);
+            lastColumn = std::min(lastColumn, width - 2);
+            if (firstColumn > lastColumn)
+            {
+                throw std::invalid_argument("Seam region has no removable columns");
+            }
+
+            auto allowed = [mask, &energy](int x, int y)
+            {
+                return !mask || mask->pixels[static_cast<size_t>(y) * mask->width + energy.originalColumn(x, y)] != 0;
+            };
+
+            // Strip s covers interior rows [stripBegin(s), stripBegin(s + 1))
+            auto stripBegin = [height, numStrips](int strip)
+            {
+                return 1 + static_cast<int>(static_cast<int64_t>(height - 2) * strip / numStrips);
+            };
+
+            const int rowBytes = (width + 3) / 4;
+            std::vector<uint8_t> &directions = workspaces[0].directions;
+            directions.resize(static_cast<size_t>(rowBytes) * height);
+
+            // Leaves the costs of the strip's last row, and the columns their paths entered at, in its workspace
+            auto searchStrip = [&](int strip)
+            {
+                STRONK_PROFILE_SCOPE("dp");
+
+                SeamWorkspace &stripWorkspace = workspaces[strip];
+                std::vector<uint32_t> &previousCost = stripWorkspace.previousCost;
+                std::vector<uint32_t> &currentCost = stripWorkspace.currentCost;
+                std::vector<int> &previousOrigin = stripWorkspace.previousOrigin;
+                std::vector<int> &currentOrigin = stripWorkspace.currentOrigin;
+                previousCost.resize(width);
+                currentCost.resize(width);
+                previousOrigin.resize(width);
+                currentOrigin.resize(width);
+
+                // The top strip starts from the top row, as in the exact search; the others from anywhere
+                for (int x = firstColumn; x <= lastColumn; ++x)
+                {
+                    previousCost[x] = strip == 0 && !allowed(x, 0) ? blockedCost : 0;
+                    previousOrigin[x] = x;
+                }
+
+                const int begin = stripBegin(strip);
+                for (int y = begin; y < stripBegin(strip + 1); ++y)
+                {
+                    carveCheckpoint(y);
+                    uint8_t *directionRow = directions.data() + static_cast<size_t>(y) * rowBytes;
+                    relaxSeamRow(previousCost.data(), currentCost.data(), energy.row(y), directionRow, firstColumn, lastColumn, y, allowed);
+
+                    // Below the first row of the strip, every cell inherits the entry column of its parent
+                    if (y > begin)
+                    {
+                        for (int x = firstColumn; x <= lastColumn; ++x)
+                        {
+                            uint8_t direction = (directionRow[x >> 2] >> ((x & 3) * 2)) & 3;
+                            currentOrigin[x] = previousOrigin[x + (direction == SeamUpLeft ? -1 : direction == SeamUpRight ? 1 : 0)];
+                        }
+                        std::swap(previousOrigin, currentOrigin);
+                    }
+                    std::swap(previousCost, currentCost);
+                }
+            };
+
+            // Workers carry the caller's carve control, and hand their errors back rather than to the pool
+            std::vector<std::exception_ptr> errors(numStrips);
+            CarveControl *control = CarveControl::current();
+            for (int strip = 1; strip < numStrips; ++strip)
+            {
+                auto task = [&, strip]()
+                {
+                    std::unique_ptr<CarveControlScope> controlScope;
+                    if (control)
+                    {
+                        controlScope.reset(new CarveControlScope(*control));
+                    }
+
+                    try
+                    {
+                        searchStrip(strip);
+                    }
+                    catch (...)
+                    {
+                        errors[strip] = std::current_exception();
+                    }
+                };
+
+                if (pool)
+                {
+                    pool->submit(task);
+                }
+                else
+                {
+                    task();
+                }
+            }
+
+            try
+            {
+                searchStrip(0);
+            }
+            catch (...)
+            {
+                errors[0] = std::current_exception();
+            }
+
+            if (pool)
+            {
+                pool->wait();
+            }
+
+            for (const std::exception_ptr &error : errors)
+            {
+                if (error)
+                {
+                    std::rethrow_exception(error);
+                }
+            }
+
+            STRONK_PROFILE_SCOPE("traceback");
+
+            /*
+             * Stitch the strips from the top. Ending strip s at x costs its own path to x plus the cheapest
+             * stitched end of strip s - 1 within one column of where that path entered, ties preferring
+             * straight, then left, as in the exact search.
+             */
+            for (int strip = 0; strip < numStrips; ++strip)
+            {
+                SeamWorkspace &stripWorkspace = workspaces[strip];
+                std::vector<uint32_t> &stitchedCost = stripWorkspace.stitchedCost;
+                std::vector<int> &stitchedFrom = stripWorkspace.stitchedFrom;
+                stitchedCost.assign(width, blockedCost);
+                stitchedFrom.assign(width, -1);
+
+                for (int x = firstColumn; x <= lastColumn; ++x)
+                {
+                    uint32_t cost = stripWorkspace.previousCost[x];
+                    if (cost == blockedCost)
+                    {
+                        continue;
+                    }
+
+                    if (strip == 0)
+                    {
+                        stitchedCost[x] = cost;
+                        continue;
+                    }
+
+                    const std::vector<uint32_t> &above = workspaces[strip - 1].stitchedCost;
+                    int origin = stripWorkspace.previousOrigin[x];
+                    for (int from : {origin, origin - 1, origin + 1})
+                    {
+                        if (from >= firstColumn && from <= lastColumn && above[from] != blockedCost &&
+                            (stitchedFrom[x] < 0 || above[from] < above[stitchedFrom[x]]))
+                        {
+                            stitchedFrom[x] = from;
+                        }
+                    }
+                    if (stitchedFrom[x] >= 0)
                     {
-                        seam[y] = seam[y + 1] + 1;
+                        stitchedCost[x] = above[stitchedFrom[x]] + cost;
                     }
                 }
             }
 
-            ImageData newImage(sourceImage.getWidth() - 1, sourceImage.getHeight());
-            ImageData newEnergyMap(energyMap.getWidth() - 1, energyMap.getHeight());
-            for (unsigned int y = 0; y < sourceImage.getHeight(); ++y)
+            // The cheapest stitched end whose continuation into the bottom row is allowed
+            const std::vector<uint32_t> &bottom = workspaces[numStrips - 1].stitchedCost;
+            int end = -1;
+            for (int x = firstColumn; x <= lastColumn; ++x)
+            {
+                if (bottom[x] != blockedCost && allowed(x, height - 1) && (end < 0 || bottom[x] < bottom[end]))
+                {
+                    end = x;
+                }
+            }
+
+            // A mask can cut every stitched path while a seam still crosses the strips elsewhere
+            if (end < 0)
+            {
+                findSeam(energy, workspaces[0], seam, firstColumn, lastColumn, mask);
+                return;
+            }
+
+            // Follow the recorded parents up each strip, and the stitches across to the strip above
+            seam.resize(height);
+            for (int strip = numStrips - 1; strip >= 0; --strip)
+            {
+                const int last = stripBegin(strip + 1) - 1;
+                seam[last] = end;
+                for (int y = last; y > stripBegin(strip); --y)
+                {
+                    size_t cell = static_cast<size_t>(y) * rowBytes;
+                    uint8_t direction = (directions[cell + (seam[y] >> 2)] >> ((seam[y] & 3) * 2)) & 3;
+                    seam[y - 1] = seam[y] + (direction == SeamUpLeft ? -1 : direction == SeamUpRight ? 1 : 0);
+                }
+                end = workspaces[strip].stitchedFrom[end];
+            }
+
+            // The border rows continue the seam straight, as in the exact search
+            seam[0] = seam[1];
+            seam[height - 1] = seam[height - 2];
+        }
+    }
+
+    std::vector<int> Filter::findVerticalSeam(const ImageData &energyMap)
+    {
+        std::vector<uint8_t> values = energyBytes(energyMap);
+        SeamWorkspace workspace;
+        std::vector<int> seam;
+        findSeam(viewOf(values, energyMap), workspace, seam, 0, energyMap.width, nullptr);
+        return seam;
+    }
+
+    std::vector<int> Filter::findGreedySeam(const ImageData &energyMap)
+    {
+        std::vector<uint8_t> values = energyBytes(energyMap);
+        SeamWorkspace workspace;
+        std::vector<int> seam;
+        findGreedyPath(viewOf(values, energyMap), workspace, seam, 0, energyMap.width, nullptr);
+        return seam;
+    }
+
+    std::vector<int> Filter::findStripSeam(const ImageData &energyMap, unsigned int numStrips)
+    {
+        std::vector<uint8_t> values = energyBytes(energyMap);
+        std::vector<SeamWorkspace> workspaces(stripCount(numStrips, energyMap.height));
+        std::unique_ptr<ThreadPool> pool(workspaces.size() > 1 ? new ThreadPool(workspaces.size() - 1) : nullptr);
+        std::vector<int> seam;
+        findStripPath(viewOf(values, energyMap), workspaces, seam, 0, energyMap.width, nullptr, pool.get());
+        return seam;
+    }
+
+    uint64_t Filter::seamEnergy(const ImageData &energyMap, const std::vector<int> &seam)
+    {
+        if (seam.size() != energyMap.height)
+        {
+            throw std::invalid_argument("Seam does not match the energy map");
+        }
+
+        uint64_t energy = 0;
+        for (unsigned int y = 1; y + 1 < energyMap.height; ++y)
+        {
+            energy += energyMap.rgbPixelData[static_cast<size_t>(y) * energyMap.width + seam[y]].red;
+        }
+        return energy;
+    }
+
+    void Filter::removeSeams(ImageData &sourceImage, ImageData &energyMap, int numSeams)
+    {
+        removeSeams(sourceImage, energyMap, numSeams, SeamRegion());
+    }
+
+    int Filter::removeSeams(ImageData &sourceImage, ImageData &energyMap, int numSeams, const SeamRegion &region,
+                            std::vector<std::vector<int>> *removedSeams, std::chrono::steady_clock::time_point deadline)
+    {
+        if (removedSeams)
+        {
+            removedSeams->clear();
+        }
+
+        if (numSeams <= 0)
+        {
+            return 0;
+        }
+
+        if (sourceImage.width != energyMap.width || sourceImage.height != energyMap.height)
+        {
+            throw std::invalid_argument("Energy map does not match the image");
+        }
+
+        if (region.mask && (region.mask->width != energyMap.width || region.mask->height != energyMap.height))
+        {
+            throw std::invalid_argument("Seam mask does not match the energy map");
+        }
+
+        STRONK_PROFILE_SCOPE("seams");
+        reportCarveStage(CarveStage::Seams);
+
+        // The region is given in the original coordinates and loses a column with every seam
+        int firstColumn = region.columnBegin;
+        int lastColumn = (region.columnEnd == 0 ? energyMap.width : region.columnEnd) - 1;
+
+        /*
+         * Seams are deleted lazily. Only the byte-wide energy of the live pixels and their original columns
+         * are shifted per seam, with each row keeping its place in the buffers; the colour image and the
+         * full energy map are compacted once at the end, so their 16-byte pixels are read and written once
+         * per call instead of once per seam.
+         */
+        const size_t stride = energyMap.width;
+        std::vector<uint8_t> liveEnergy = energyBytes(energyMap);
+        std::vector<uint32_t> liveColumns(liveEnergy.size());
+        for (unsigned int y = 0; y < energyMap.height; ++y)
+        {
+            std::iota(liveColumns.begin() + y * stride, liveColumns.begin() + (y + 1) * stride, 0u);
+        }
+        EnergyView live = {liveEnergy.data(), liveColumns.data(), static_cast<int>(energyMap.width), static_cast<int>(energyMap.height), stride};
+
+        // Gather the live pixels of every row to the front of the row, then narrow the image
+        auto compact = [&live, &liveColumns, stride](ImageData &image)
+        {
+            STRONK_PROFILE_SCOPE("gather");
+
+            // Live pixels never move right, so a forward pass never overwrites one that is still to be read
+            for (int y = 0; y < live.height; ++y)
             {
-                for (unsigned int x = 0; x < sourceImage.getWidth(); ++x)
+                const uint32_t *columns = liveColumns.data() + y * stride;
+                const RGBPixelBuf *source = image.rgbPixelData + y * stride;
+                RGBPixelBuf *destination = image.rgbPixelData + static_cast<size_t>(y) * live.width;
+                for (int x = 0; x < live.width; ++x)
                 {
-                    if (x < static_cast<unsigned int>(seam[y]))
+                    destination[x] = source[columns[x]];
+                }
+            }
+            image.width = live.width;
+        };
+
+        SeamWorkspace workspace;
+        std::vector<int> seam;
+        int seamCount = 0;
+
+        // The strip search keeps its workers for the whole call, as every seam is searched strip by strip
+        std::vector<SeamWorkspace> stripWorkspaces;
+        std::unique_ptr<ThreadPool> stripPool;
+        if (region.seamMode == SeamMode::Strips)
+        {
+            stripWorkspaces.resize(stripCount(region.numStrips, energyMap.height));
+            if (stripWorkspaces.size() > 1)
+            {
+                stripPool.reset(new ThreadPool(stripWorkspaces.size() - 1));
+            }
+        }
+
+        try
+        {
+            bool hasDeadline = deadline != std::chrono::steady_clock::time_point::max();
+            for (; seamCount < numSeams; ++seamCount)
+            {
+                reportCarveSeams(seamCount, numSeams);
+                carveCheckpoint();
+                if (hasDeadline && std::chrono::steady_clock::now() >= deadline)
+                {
+                    break;
+                }
+
+                // Find the lowest energy seam with the forward pass and a backpointer walk
+                if (region.seamMode == SeamMode::Greedy)
+                {
+                    findGreedyPath(live, workspace, seam, firstColumn, lastColumn, region.mask);
+                }
+                else if (region.seamMode == SeamMode::Strips)
+                {
+                    findStripPath(live, stripWorkspaces, seam, firstColumn, lastColumn, region.mask, stripPool.get());
+                }
+                else if (region.guides && static_cast<size_t>(seamCount) < region.guides->size())
+                {
+                    try
                     {
-                        newImage.setPixel(x, y, sourceImage.getPixel(x, y));
-                        newEnergyMap.setPixel(x, y, energyMap.getPixel(x, y));
+                        findSeam(live, workspace, seam, firstColumn, lastColumn, region.mask, &(*region.guides)[seamCount], region.bandRadius);
                     }
-                    else if (x > static_cast<unsigned int>(seam[y]))
+                    catch (const std::runtime_error &)
                     {
-                        newImage.setPixel(x - 1, y, sourceImage.getPixel(x, y));
-                        newEnergyMap.setPixel(x - 1, y, energyMap.getPixel(x, y));
+                        // The mask closes the band off, so look at the whole region instead
+                        findSeam(live, workspace, seam, firstColumn, lastColumn, region.mask);
                     }
                 }
+                else
+                {
+                    findSeam(live, workspace, seam, firstColumn, lastColumn, region.mask);
+                }
+
+                if (removedSeams)
+                {
+                    removedSeams->push_back(seam);
+                }
+
+                // Drop the seam from the live energy and column map only
+                STRONK_PROFILE_SCOPE("compaction");
+
+                for (int y = 0; y < live.height; ++y)
+                {
+                    size_t seamCell = y * stride + seam[y];
+                    size_t tail = live.width - seam[y] - 1;
+                    std::memmove(&liveEnergy[seamCell], &liveEnergy[seamCell + 1], tail);
+                    std::memmove(&liveColumns[seamCell], &liveColumns[seamCell + 1], tail * sizeof(uint32_t));
+                }
+                --live.width;
+                --lastColumn;
+            }
+        }
+        catch (...)
+        {
+            // A cancelled or failed search still leaves the seams found so far removed
+            compact(sourceImage);
+            compact(energyMap);
+            throw;
+        }
+
+        compact(sourceImage);
+        compact(energyMap);
+        reportCarveSeams(seamCount, numSeams);
+        return seamCount;
+    }
+
+    void Filter::resampleWidth(ImageData &sourceImage, unsigned int numColumns, unsigned int columnBegin, unsigned int columnEnd)
+    {
+        if (numColumns == 0)
+        {
+            return;
+        }
+
+        unsigned int end = columnEnd == 0 ? sourceImage.width : columnEnd;
+        if (columnBegin >= end || end > sourceImage.width || end - columnBegin <= numColumns)
+        {
+            throw std::invalid_argument("Resample range must lie inside the image and be wider than the columns removed");
+        }
+
+        STRONK_PROFILE_SCOPE("resample");
+        reportCarveStage(CarveStage::Resample);
+
+        unsigned int sourceSpan = end - columnBegin;
+        unsigned int targetSpan = sourceSpan - numColumns;
+        unsigned int targetWidth = sourceImage.width - numColumns;
+        double scale = static_cast<double>(sourceSpan) / targetSpan;
+
+        ImageData resampled(targetWidth, sourceImage.height);
+        for (unsigned int y = 0; y < sourceImage.height; ++y)
+        {
+            carveCheckpoint(y);
+            const RGBPixelBuf *sourceRow = sourceImage.rgbPixelData + static_cast<size_t>(y) * sourceImage.width;
+            RGBPixelBuf *targetRow = resampled.rgbPixelData + static_cast<size_t>(y) * targetWidth;
+
+            std::copy(sourceRow, sourceRow + columnBegin, targetRow);
+            std::copy(sourceRow + end, sourceRow + sourceImage.width, targetRow + columnBegin + targetSpan);
+
+            // Box filter over the footprint [x * scale, (x + 1) * scale) of every output pixel
+            for (unsigned int x = 0; x < targetSpan; ++x)
+            {
+                double left = x * scale;
+                double right = std::min<double>((x + 1) * scale, sourceSpan);
+                double sum[4] = {0.0, 0.0, 0.0, 0.0};
+                for (unsigned int sourceX = static_cast<unsigned int>(left); sourceX < right; ++sourceX)
+                {
+                    double weight = std::min<double>(sourceX + 1, right) - std::max<double>(sourceX, left);
+                    const RGBPixelBuf &pixel = sourceRow[columnBegin + sourceX];
+                    sum[0] += weight * pixel.red;
+                    sum[1] += weight * pixel.green;
+                    sum[2] += weight * pixel.blue;
+                    sum[3] += weight * pixel.opacity;
+                }
+
+                double coverage = right - left;
+                targetRow[columnBegin + x] = {
+                    static_cast<Quantum>(std::lround(sum[0] / coverage)),
+                    static_cast<Quantum>(std::lround(sum[1] / coverage)),
+                    static_cast<Quantum>(std::lround(sum[2] / coverage)),
+                    static_cast<Quantum>(std::lround(sum[3] / coverage))};
             }
+        }
 
-            // Step 7: Update the source image and regenerate the energy map
-            sourceImage = newImage;
-            energyMap = newEnergyMap;
+        sourceImage = std::move(resampled);
+    }
+
+    ImageData Filter::transpose(const ImageData &sourceImage)
+    {
+        ImageData transposed(sourceImage.height, sourceImage.width);
+
+        for (unsigned int y = 0; y < sourceImage.height; ++y)
+        {
+            const RGBPixelBuf *sourceRow = sourceImage.rgbPixelData + y * sourceImage.width;
+            for (unsigned int x = 0; x < sourceImage.width; ++x)
+            {
+                transposed.rgbPixelData[x * transposed.width + y] = sourceRow[x];
+            }
         }
+
+        return transposed;
     }
 }
@@ -0,0 +1,130 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include <BufferPool.h>
+#include <GrayImage.h>
+
+namespace StronkImage
+{
+	GrayImageData::GrayImageData()
+		: pixelCapacity(0), width(0), height(0), pixels(nullptr) {}
+
+	GrayImageData::GrayImageData(int width, int height)
+		: pixelCapacity(0), width(width), height(height), pixels(nullptr)
+	{
+		if (height <= 0 || width <= 0)
+		{
+			throw std::invalid_argument("Invalid dimensions for the image");
+		}
+
+		allocatePixels(static_cast<size_t>(width) * height);
+	}
+
+	GrayImageData::GrayImageData(int width, int height, uint8_t value)
+		: GrayImageData(width, height)
+	{
+		std::fill(pixels, pixels + pixelCapacity, value);
+	}
+
+	GrayImageData::GrayImageData(const GrayImageData &other)
+		: pixelCapacity(0), width(other.width), height(other.height), pixels(nullptr)
+	{
+		if (other.pixels)
+		{
+			allocatePixels(static_cast<size_t>(width) * height);
+			std::copy(other.pixels, other.pixels + static_cast<size_t>(width) * height, pixels);
+		}
+	}
+
+	GrayImageData::GrayImageData(GrayImageData &&other) noexcept
+		: pixelCapacity(other.pixelCapacity), width(other.width), height(other.height), pixels(other.pixels)
+	{
+		other.pixelCapacity = 0;
+		other.width = 0;
+		other.height = 0;
+		other.pixels = nullptr;
+	}
+
+	GrayImageData::~GrayImageData()
+	{
+		releasePixels();
+	}
+
+	GrayImageData &GrayImageData::operator=(const GrayImageData &other)
+	{
+		if (this != &other)
+		{
+			width = other.width;
+			height = other.height;
+
+			if (other.pixels)
+			{
+				allocatePixels(static_cast<size_t>(width) * height);
+				std::copy(other.pixels, other.pixels + static_cast<size_t>(width) * height, pixels);
+			}
+			else
+			{
+				releasePixels();
+			}
+		}
+		return *this;
+	}
+
+	GrayImageData &GrayImageData::operator=(GrayImageData &&other) noexcept
+	{
+		if (this != &other)
+		{
+			releasePixels();
+
+			width = other.width;
+			height = other.height;
+			pixels = other.pixels;
+			pixelCapacity = other.pixelCapacity;
+
+			other.width = 0;
+			other.height = 0;
+			other.pixels = nullptr;
+			other.pixelCapacity = 0;
+		}
+		return *this;
+	}
+
+	void GrayImageData::allocatePixels(size_t pixelCount)
+	{
+		if (pixels && pixelCount <= pixelCapacity)
+		{
+			return;
+		}
+
+		releasePixels();
+		pixels = static_cast<uint8_t *>(BufferPool::global().acquire(pixelCount));
+		pixelCapacity = pixelCount;
+	}
+
+	void GrayImageData::releasePixels()
+	{
+		BufferPool::global().release(pixels, pixelCapacity);
+		pixels = nullptr;
+		pixelCapacity = 0;
+	}
+
+	uint8_t GrayImageData::getPixel(int x, int y) const
+	{
+		if (x < 0 || x >= static_cast<int>(width) || y < 0 || y >= static_cast<int>(height))
+		{
+			throw std::out_of_range("Invalid pixel position");
+		}
+
+		return pixels[static_cast<size_t>(y) * width + x];
+	}
+
+	void GrayImageData::setPixel(int x, int y, uint8_t value)
+	{
+		if (x < 0 || x >= static_cast<int>(width) || y < 0 || y >= static_cast<int>(height))
+		{
+			throw std::out_of_range("Invalid pixel position");
+		}
+
+		pixels[static_cast<size_t>(y) * width + x] = value;
+	}
+}
@@ -1,3 +1,7 @@
+#include <algorithm>
+#include <cstring>
+
+#include <BufferPool.h>
 #include <Image.h>
 
 // Definitions for Image
@@ -35,21 +39,39 @@ namespace StronkImage
 			width = other.width;
 			height = other.height;
 
-			if (rgbPixelData)
+			if (other.rgbPixelData)
 			{
-				delete[] rgbPixelData;
+				// Reuses the current buffer when it is already large enough
+				allocatePixels(static_cast<size_t>(width) * height);
+				std::copy(other.rgbPixelData, other.rgbPixelData + width * height, rgbPixelData);
 			}
-
-			rgbPixelData = new RGBPixelBuf[width * height];
-
-			for (unsigned int i = 0; i < width * height; ++i)
+			else
 			{
-				rgbPixelData[i] = other.rgbPixelData[i];
+				releasePixels();
 			}
 		}
 		return *this;
 	}
 
+	ImageData &ImageData::operator=(ImageData &&other) noexcept
+	{
+		if (this != &other)
+		{
+			releasePixels();
+
+			width = other.width;
+			height = other.height;
+			rgbPixelData = other.rgbPixelData;
+			pixelCapacity = other.pixelCapacity;
+
+			other.width = 0;
+			other.height = 0;
+			other.rgbPixelData = nullptr;
+			other.pixelCapacity = 0;
+		}
+		return *this;
+	}
+
 	ImageData &Image::getRawImageData()
 	{
 		return imageData;
@@ -65,44 +87,69 @@ namespace StronkImage
 namespace StronkImage
 {
 	ImageData::ImageData()
-		: height(0), width(0), rgbPixelData(nullptr) {}
+		: pixelCapacity(0), width(0), height(0), rgbPixelData(nullptr) {}
 
 	ImageData::ImageData(int width, int height)
-		: height(height), width(width), rgbPixelData(nullptr)
+		: pixelCapacity(0), width(width), height(height), rgbPixelData(nullptr)
 	{
 		if (height <= 0 || width <= 0)
 		{
 			throw std::invalid_argument("Invalid dimensions for the image");
 		}
 
-		rgbPixelData = new RGBPixelBuf[height * width];
+		allocatePixels(static_cast<size_t>(width) * height);
 	}
 
 	ImageData::ImageData(int width, int height, const RGBPixelBuf &pixel)
-		: width(width), height(height)
+		: pixelCapacity(0), width(width), height(height), rgbPixelData(nullptr)
 	{
-		rgbPixelData = new RGBPixelBuf[width * height];
+		allocatePixels(static_cast<size_t>(width) * height);
 
 		// Initialize all pixels with the provided pixel value
-		for (int i = 0; i < width * height; ++i)
-		{
-			rgbPixelData[i] = pixel;
-		}
+		std::fill(rgbPixelData, rgbPixelData + pixelCapacity, pixel);
 	}
 
 	ImageData::ImageData(const ImageData &other)
-		: height(other.height), width(other.width), rgbPixelData(nullptr)
+		: pixelCapacity(0), width(other.width), height(other.height), rgbPixelData(nullptr)
 	{
 		if (other.rgbPixelData)
 		{
-			rgbPixelData = new RGBPixelBuf[height * width];
+			allocatePixels(static_cast<size_t>(width) * height);
 			std::copy(other.rgbPixelData, other.rgbPixelData + height * width, rgbPixelData);
 		}
 	}
 
+	ImageData::ImageData(ImageData &&other) noexcept
+		: pixelCapacity(other.pixelCapacity), width(other.width), height(other.height), rgbPixelData(other.rgbPixelData)
+	{
+		other.pixelCapacity = 0;
+		other.width = 0;
+		other.height = 0;
+		other.rgbPixelData = nullptr;
+	}
+
 	ImageData::~ImageData()
 	{
-		delete[] rgbPixelData;
+		releasePixels();
+	}
+
+	void ImageData::allocatePixels(size_t pixelCount)
+	{
+		if (rgbPixelData && pixelCount <= pixelCapacity)
+		{
+			return;
+		}
+
+		releasePixels();
+		rgbPixelData = static_cast<RGBPixelBuf *>(BufferPool::global().acquire(pixelCount * sizeof(RGBPixelBuf)));
+		pixelCapacity = pixelCount;
+	}
+
+	void ImageData::releasePixels()
+	{
+		BufferPool::global().release(rgbPixelData, pixelCapacity * sizeof(RGBPixelBuf));
+		rgbPixelData = nullptr;
+		pixelCapacity = 0;
 	}
 
 	void ImageData::resizeBuffer(int newWidth, int newHeight)
@@ -119,26 +166,55 @@ namespace StronkImage
 		}
 
 		// Create a new buffer with the new dimensions
-		RGBPixelBuf *newRgbPixelData = new RGBPixelBuf[newHeight * newWidth];
+		size_t newCapacity = static_cast<size_t>(newWidth) * newHeight;
+		RGBPixelBuf *newRgbPixelData = static_cast<RGBPixelBuf *>(BufferPool::global().acquire(newCapacity * sizeof(RGBPixelBuf)));
 
 		// Copy the data from the old buffer to the new buffer
 		int minWidth = std::min(width, (unsigned int)newWidth);
 		int minHeight = std::min(height, (unsigned int)newHeight);
 		for (int y = 0; y < minHeight; ++y)
 		{
-			for (int x = 0; x < minWidth; ++x)
-			{
-				newRgbPixelData[y * newWidth + x] = rgbPixelData[y * width + x];
-			}
+			std::copy(rgbPixelData + y * width, rgbPixelData + y * width + minWidth, newRgbPixelData + y * newWidth);
 		}
 
-		// Delete the old buffer and update the buffer pointer and dimensions
-		delete[] rgbPixelData;
+		// Release the old buffer and update the buffer pointer and dimensions
+		releasePixels();
 		rgbPixelData = newRgbPixelData;
+		pixelCapacity = newCapacity;
 		width = newWidth;
 		height = newHeight;
 	}
 
+	void ImageData::removeSeam(const std::vector<int> &seam)
+	{
+		if (width < 2 || seam.size() != height)
+		{
+			throw std::invalid_argument("Seam does not match the image");
+		}
+
+		// Check the whole seam first, so a bad entry leaves the image untouched rather than half shifted
+		for (int seamX : seam)
+		{
+			if (seamX < 0 || static_cast<unsigned int>(seamX) >= width)
+			{
+				throw std::out_of_range("Invalid pixel position");
+			}
+		}
+
+		// Rows only ever move towards the start of the buffer, so a forward pass never overwrites unread pixels
+		unsigned int newWidth = width - 1;
+		for (unsigned int y = 0; y < height; ++y)
+		{
+			unsigned int seamX = static_cast<unsigned int>(seam[y]);
+			RGBPixelBuf *source = rgbPixelData + y * width;
+			RGBPixelBuf *destination = rgbPixelData + y * newWidth;
+			std::memmove(destination, source, seamX * sizeof(RGBPixelBuf));
+			std::memmove(destination + seamX, source + seamX + 1, (width - seamX - 1) * sizeof(RGBPixelBuf));
+		}
+
+		width = newWidth;
+	}
+
 	RGBPixelBuf ImageData::getPixel(int x, int y) const
 	{
 		if (x < 0 || x >= width || y < 0 || y >= height)
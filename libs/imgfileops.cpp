@@ -1,82 +1,249 @@
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <climits>
 #include <cmath>
+#include <csetjmp>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
 
 #include <jpeglib.h>
 #include <png.h>
 
 #include <Image.h>
+#include <Profiler.h>
 
 namespace StronkImage
 {
-	void Image::loadFromFile(const std::string &imageSpec)
+	namespace
 	{
-		if (imageSpec.substr(imageSpec.find_last_of(".") + 1) == "jpg" || imageSpec.substr(imageSpec.find_last_of(".") + 1) == "jpeg")
+		// libjpeg error manager that jumps back to the caller instead of calling exit()
+		struct JpegErrorManager
+		{
+			jpeg_error_mgr pub;
+			jmp_buf setjmpBuffer;
+			char message[JMSG_LENGTH_MAX];
+		};
+
+		void jpegErrorExit(j_common_ptr cinfo)
+		{
+			JpegErrorManager *errorManager = reinterpret_cast<JpegErrorManager *>(cinfo->err);
+			(*cinfo->err->format_message)(cinfo, errorManager->message);
+			longjmp(errorManager->setjmpBuffer, 1);
+		}
+
+		// Cursor used by libpng to read from a memory buffer
+		struct PngMemoryReader
 		{
-			// Load JPEG image using libjpeg
-			FILE *infile = fopen(imageSpec.c_str(), "rb");
-			if (!infile)
+			const unsigned char *data;
+			size_t size;
+			size_t offset;
+		};
+
+		void pngReadFromMemory(png_structp png_ptr, png_bytep outBytes, png_size_t byteCount)
+		{
+			PngMemoryReader *reader = static_cast<PngMemoryReader *>(png_get_io_ptr(png_ptr));
+			if (reader->offset + byteCount > reader->size)
 			{
-				throw std::runtime_error("Error opening JPEG file");
+				png_error(png_ptr, "Unexpected end of PNG data");
 			}
 
+			std::memcpy(outBytes, reader->data + reader->offset, byteCount);
+			reader->offset += byteCount;
+		}
+
+		void pngWriteToMemory(png_structp png_ptr, png_bytep inBytes, png_size_t byteCount)
+		{
+			std::vector<unsigned char> *output = static_cast<std::vector<unsigned char> *>(png_get_io_ptr(png_ptr));
+			output->insert(output->end(), inBytes, inBytes + byteCount);
+		}
+
+		void pngFlushMemory(png_structp) {}
+
+		std::string fileExtension(const std::string &imageSpec)
+		{
+			return imageSpec.substr(imageSpec.find_last_of(".") + 1);
+		}
+
+		// Where encoded bytes come from: a memory buffer, or an open file read incrementally
+		struct EncodedInput
+		{
+			const unsigned char *data;
+			size_t size;
+			FILE *file;
+		};
+
+		// Where encoded bytes go: a growing memory buffer, or an open file written incrementally
+		struct EncodedOutput
+		{
+			std::vector<unsigned char> *bytes;
+			FILE *file;
+		};
+
+		// Sink that expands the decoded rows into an ImageData
+		class ImageDataSink : public ScanlineSink
+		{
+		private:
+			ImageData &imageData;
+
+		public:
+			explicit ImageDataSink(ImageData &imageData) : imageData(imageData) {}
+
+			void start(unsigned int width, unsigned int height) override
+			{
+				imageData.resizeBuffer(width, height);
+			}
+
+			void writeRow(unsigned int y, const uint8_t *rgba) override
+			{
+				RGBPixelBuf *pixels = imageData.rgbPixelData + static_cast<size_t>(y) * imageData.width;
+				for (unsigned int x = 0; x < imageData.width; ++x)
+				{
+					pixels[x] = {rgba[x * 4 + 0], rgba[x * 4 + 1], rgba[x * 4 + 2], rgba[x * 4 + 3]};
+				}
+			}
+		};
+
+		// Source that packs the rows of an ImageData for an encoder
+		class ImageDataSource : public ScanlineSource
+		{
+		private:
+			const ImageData &imageData;
+
+		public:
+			explicit ImageDataSource(const ImageData &imageData) : imageData(imageData) {}
+
+			unsigned int width() const override { return imageData.width; }
+
+			unsigned int height() const override { return imageData.height; }
+
+			void readRow(unsigned int y, uint8_t *rgba) override
+			{
+				const RGBPixelBuf *pixels = imageData.rgbPixelData + static_cast<size_t>(y) * imageData.width;
+				for (unsigned int x = 0; x < imageData.width; ++x)
+				{
+					rgba[x * 4 + 0] = static_cast<uint8_t>(pixels[x].red);
+					rgba[x * 4 + 1] = static_cast<uint8_t>(pixels[x].green);
+					rgba[x * 4 + 2] = static_cast<uint8_t>(pixels[x].blue);
+					rgba[x * 4 + 3] = static_cast<uint8_t>(pixels[x].opacity);
+				}
+			}
+		};
+
+		void decodeJpeg(const EncodedInput &input, ScanlineSink &sink)
+		{
 			jpeg_decompress_struct cinfo;
-			jpeg_error_mgr jerr;
+			JpegErrorManager jerr;
+			// Allocated after setjmp, so volatile keeps it valid in the error path
+			uint8_t *volatile rgba = NULL;
+
+			cinfo.err = jpeg_std_error(&jerr.pub);
+			jerr.pub.error_exit = jpegErrorExit;
+
+			if (setjmp(jerr.setjmpBuffer))
+			{
+				jpeg_destroy_decompress(&cinfo);
+				delete[] rgba;
+				throw std::runtime_error(std::string("Error reading JPEG data: ") + jerr.message);
+			}
 
-			cinfo.err = jpeg_std_error(&jerr);
 			jpeg_create_decompress(&cinfo);
-			jpeg_stdio_src(&cinfo, infile);
+			if (input.file)
+			{
+				jpeg_stdio_src(&cinfo, input.file);
+			}
+			else
+			{
+				jpeg_mem_src(&cinfo, input.data, input.size);
+			}
 			jpeg_read_header(&cinfo, TRUE);
-			jpeg_start_decompress(&cinfo);
 
-			imageData.resizeBuffer(cinfo.output_width, cinfo.output_height);
+			// Let libjpeg expand grayscale and convert YCbCr so every scanline is packed RGB
+			cinfo.out_color_space = JCS_RGB;
+			jpeg_start_decompress(&cinfo);
 
 			JSAMPARRAY buffer;
 			buffer = (*cinfo.mem->alloc_sarray)((j_common_ptr)&cinfo, JPOOL_IMAGE, cinfo.output_width * cinfo.output_components, 1);
+			rgba = new uint8_t[static_cast<size_t>(cinfo.output_width) * 4];
 
-			while (cinfo.output_scanline < cinfo.output_height)
+			try
 			{
-				jpeg_read_scanlines(&cinfo, buffer, 1);
+				sink.start(cinfo.output_width, cinfo.output_height);
 
-				for (unsigned int x = 0; x < cinfo.output_width; ++x)
+				while (cinfo.output_scanline < cinfo.output_height)
 				{
-					RGBPixelBuf pixel;
-					pixel.red = buffer[0][x * cinfo.output_components + 0];
-					pixel.green = buffer[0][x * cinfo.output_components + 1];
-					pixel.blue = buffer[0][x * cinfo.output_components + 2];
-					pixel.opacity = 255;
-					imageData.setPixel(x, cinfo.output_scanline - 1, pixel);
+					jpeg_read_scanlines(&cinfo, buffer, 1);
+
+					for (unsigned int x = 0; x < cinfo.output_width; ++x)
+					{
+						rgba[x * 4 + 0] = buffer[0][x * 3 + 0];
+						rgba[x * 4 + 1] = buffer[0][x * 3 + 1];
+						rgba[x * 4 + 2] = buffer[0][x * 3 + 2];
+						rgba[x * 4 + 3] = 255;
+					}
+					sink.writeRow(cinfo.output_scanline - 1, rgba);
 				}
 			}
+			catch (...)
+			{
+				jpeg_destroy_decompress(&cinfo);
+				delete[] rgba;
+				throw;
+			}
 
+			delete[] rgba;
 			jpeg_finish_decompress(&cinfo);
 			jpeg_destroy_decompress(&cinfo);
-			fclose(infile);
 		}
-		else if (imageSpec.substr(imageSpec.find_last_of(".") + 1) == "png")
-		{
-			// Load PNG image using libpng
-			FILE *infile = fopen(imageSpec.c_str(), "rb");
-			if (!infile)
-			{
-				throw std::runtime_error("Error opening PNG file");
-			}
 
+		void decodePng(const EncodedInput &input, ScanlineSink &sink)
+		{
 			png_structp png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
 			png_infop info_ptr = png_create_info_struct(png_ptr);
+			// Modified after setjmp, so volatile keeps them valid in the error path
+			png_bytepp volatile row_pointers = NULL;
+			volatile unsigned int allocatedRows = 0;
+
+			auto freeRows = [&]()
+			{
+				if (row_pointers)
+				{
+					for (unsigned int y = 0; y < allocatedRows; ++y)
+					{
+						png_free(png_ptr, row_pointers[y]);
+					}
+					png_free(png_ptr, row_pointers);
+					row_pointers = NULL;
+				}
+			};
 
 			if (setjmp(png_jmpbuf(png_ptr)))
 			{
+				freeRows();
 				png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
-				fclose(infile);
 				throw std::runtime_error("Error reading PNG file");
 			}
 
-			png_init_io(png_ptr, infile);
+			PngMemoryReader reader = {input.data, input.size, 0};
+			if (input.file)
+			{
+				png_init_io(png_ptr, input.file);
+			}
+			else
+			{
+				png_set_read_fn(png_ptr, &reader, pngReadFromMemory);
+			}
 			png_read_info(png_ptr, info_ptr);
 
 			unsigned int width = png_get_image_width(png_ptr, info_ptr);
 			unsigned int height = png_get_image_height(png_ptr, info_ptr);
-			imageData.resizeBuffer(width, height);
 
 			// Check the color type and bit depth
 			int color_type = png_get_color_type(png_ptr, info_ptr);
@@ -100,78 +267,100 @@ namespace StronkImage
 				png_set_packing(png_ptr);
 			}
 
-			// Expand 8-bit images to full 16 bits
+			// Reduce 16-bit channels to the 8 bits the rest of the pipeline expects
 			if (bit_depth == 16)
 			{
-				png_set_swap(png_ptr);
+				png_set_strip_16(png_ptr);
 			}
 
+			// Use a palette's transparency chunk as a real alpha channel
+			if (png_get_valid(png_ptr, info_ptr, PNG_INFO_tRNS))
+			{
+				png_set_tRNS_to_alpha(png_ptr);
+			}
 			// Add an alpha channel if the image doesn't have one
-			if (color_type & PNG_COLOR_MASK_ALPHA == 0)
+			else if ((color_type & PNG_COLOR_MASK_ALPHA) == 0)
 			{
 				png_set_add_alpha(png_ptr, 0xff, PNG_FILLER_AFTER);
 			}
 
+			// Interlaced images only become complete after the last pass, so they are decoded whole
+			bool interlaced = png_set_interlace_handling(png_ptr) > 1;
 			png_read_update_info(png_ptr, info_ptr);
 
-			png_bytepp row_pointers = (png_bytepp)png_malloc(png_ptr, height * sizeof(png_bytep));
-			for (unsigned int y = 0; y < height; ++y)
+			unsigned int rowCount = interlaced ? height : 1;
+			row_pointers = (png_bytepp)png_malloc(png_ptr, rowCount * sizeof(png_bytep));
+			for (unsigned int y = 0; y < rowCount; ++y)
 			{
 				row_pointers[y] = (png_bytep)png_malloc(png_ptr, png_get_rowbytes(png_ptr, info_ptr));
+				allocatedRows = y + 1;
 			}
 
-			png_read_image(png_ptr, row_pointers);
-
-			for (unsigned int y = 0; y < height; ++y)
+			try
 			{
-				for (unsigned int x = 0; x < width; ++x)
+				sink.start(width, height);
+
+				if (interlaced)
 				{
-					RGBPixelBuf pixel;
-					png_bytep row = row_pointers[y];
-					png_bytep px = &(row[x * 4]);
-					pixel.red = px[0];
-					pixel.green = px[1];
-					pixel.blue = px[2];
-					pixel.opacity = px[3];
-					imageData.setPixel(x, y, pixel);
+					png_read_image(png_ptr, row_pointers);
+					for (unsigned int y = 0; y < height; ++y)
+					{
+						sink.writeRow(y, row_pointers[y]);
+					}
+				}
+				else
+				{
+					for (unsigned int y = 0; y < height; ++y)
+					{
+						png_read_row(png_ptr, row_pointers[0], NULL);
+						sink.writeRow(y, row_pointers[0]);
+					}
 				}
 			}
-
-			for (unsigned int y = 0; y < height; ++y)
+			catch (...)
 			{
-				png_free(png_ptr, row_pointers[y]);
+				freeRows();
+				png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
+				throw;
 			}
-			png_free(png_ptr, row_pointers);
 
+			freeRows();
 			png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
-			fclose(infile);
 		}
-		else
-		{
-			throw std::runtime_error("Unsupported file format");
-		}
-	}
 
-	bool Image::writeToFile(const std::string &imageSpec)
-	{
-		if (imageSpec.substr(imageSpec.find_last_of(".") + 1) == "jpg" || imageSpec.substr(imageSpec.find_last_of(".") + 1) == "jpeg")
+		void encodeJpeg(ScanlineSource &source, const EncodedOutput &output)
 		{
-			// Write JPEG image using libjpeg
-			FILE *outfile = fopen(imageSpec.c_str(), "wb");
-			if (!outfile)
+			jpeg_compress_struct cinfo;
+			JpegErrorManager jerr;
+			unsigned char *outBuffer = NULL;
+			unsigned long outSize = 0;
+			unsigned char *volatile buffer = NULL;
+			uint8_t *volatile rgba = NULL;
+
+			cinfo.err = jpeg_std_error(&jerr.pub);
+			jerr.pub.error_exit = jpegErrorExit;
+
+			if (setjmp(jerr.setjmpBuffer))
 			{
-				throw std::runtime_error("Error opening JPEG file");
+				jpeg_destroy_compress(&cinfo);
+				delete[] buffer;
+				delete[] rgba;
+				free(outBuffer);
+				throw std::runtime_error(std::string("Error writing JPEG data: ") + jerr.message);
 			}
 
-			jpeg_compress_struct cinfo;
-			jpeg_error_mgr jerr;
-
-			cinfo.err = jpeg_std_error(&jerr);
 			jpeg_create_compress(&cinfo);
-			jpeg_stdio_dest(&cinfo, outfile);
+			if (output.file)
+			{
+				jpeg_stdio_dest(&cinfo, output.file);
+			}
+			else
+			{
+				jpeg_mem_dest(&cinfo, &outBuffer, &outSize);
+			}
 
-			cinfo.image_width = imageData.width;
-			cinfo.image_height = imageData.height;
+			cinfo.image_width = source.width();
+			cinfo.image_height = source.height();
 			cinfo.input_components = 3;
 			cinfo.in_color_space = JCS_RGB;
 
@@ -181,93 +370,858 @@ namespace StronkImage
 
 			JSAMPROW row_pointer[1];
 			int row_stride = cinfo.image_width * 3;
-			unsigned char *buffer = new unsigned char[row_stride];
+			buffer = new unsigned char[row_stride];
+			rgba = new uint8_t[static_cast<size_t>(cinfo.image_width) * 4];
 
-			while (cinfo.next_scanline < cinfo.image_height)
+			try
 			{
-				for (unsigned int x = 0; x < cinfo.image_width; ++x)
+				while (cinfo.next_scanline < cinfo.image_height)
 				{
-					RGBPixelBuf pixel = imageData.getPixel(x, cinfo.next_scanline);
-					buffer[x * 3 + 0] = static_cast<unsigned char>(pixel.red);
-					buffer[x * 3 + 1] = static_cast<unsigned char>(pixel.green);
-					buffer[x * 3 + 2] = static_cast<unsigned char>(pixel.blue);
+					source.readRow(cinfo.next_scanline, rgba);
+					for (unsigned int x = 0; x < cinfo.image_width; ++x)
+					{
+						buffer[x * 3 + 0] = rgba[x * 4 + 0];
+						buffer[x * 3 + 1] = rgba[x * 4 + 1];
+						buffer[x * 3 + 2] = rgba[x * 4 + 2];
+					}
+					row_pointer[0] = buffer;
+					jpeg_write_scanlines(&cinfo, row_pointer, 1);
 				}
-				row_pointer[0] = buffer;
-				jpeg_write_scanlines(&cinfo, row_pointer, 1);
+			}
+			catch (...)
+			{
+				jpeg_destroy_compress(&cinfo);
+				delete[] buffer;
+				delete[] rgba;
+				free(outBuffer);
+				throw;
 			}
 
 			delete[] buffer;
+			delete[] rgba;
 
 			jpeg_finish_compress(&cinfo);
 			jpeg_destroy_compress(&cinfo);
-			fclose(outfile);
-		}
-		else if (imageSpec.substr(imageSpec.find_last_of(".") + 1) == "png")
-		{
-			// Write PNG image using libpng
-			FILE *outfile = fopen(imageSpec.c_str(), "wb");
-			if (!outfile)
+
+			if (!output.file)
 			{
-				throw std::runtime_error("Error opening PNG file");
+				output.bytes->assign(outBuffer, outBuffer + outSize);
+				free(outBuffer);
 			}
+		}
 
+		void encodePng(ScanlineSource &source, const EncodedOutput &output)
+		{
 			png_structp png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
 			png_infop info_ptr = png_create_info_struct(png_ptr);
+			png_bytep volatile row = NULL;
 
 			if (setjmp(png_jmpbuf(png_ptr)))
 			{
+				png_free(png_ptr, row);
 				png_destroy_write_struct(&png_ptr, &info_ptr);
-				fclose(outfile);
 				throw std::runtime_error("Error writing PNG file");
 			}
 
-			png_init_io(png_ptr, outfile);
+			if (output.file)
+			{
+				png_init_io(png_ptr, output.file);
+			}
+			else
+			{
+				png_set_write_fn(png_ptr, output.bytes, pngWriteToMemory, pngFlushMemory);
+			}
 
 			png_set_IHDR(
 				png_ptr, info_ptr,
-				imageData.width, imageData.height,
+				source.width(), source.height(),
 				8, PNG_COLOR_TYPE_RGBA,
 				PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
 
 			png_write_info(png_ptr, info_ptr);
 
-			png_bytepp row_pointers = (png_bytepp)png_malloc(png_ptr, imageData.height * sizeof(png_bytep));
-			for (unsigned int y = 0; y < imageData.height; ++y)
+			// Rows are written one at a time so only a single scanline buffer is needed
+			row = (png_bytep)png_malloc(png_ptr, png_get_rowbytes(png_ptr, info_ptr));
+			try
 			{
-				row_pointers[y] = (png_bytep)png_malloc(png_ptr, png_get_rowbytes(png_ptr, info_ptr));
+				for (unsigned int y = 0; y < source.height(); ++y)
+				{
+					source.readRow(y, row);
+					png_write_row(png_ptr, row);
+				}
+			}
+			catch (...)
+			{
+				png_free(png_ptr, row);
+				png_destroy_write_struct(&png_ptr, &info_ptr);
+				throw;
 			}
 
-			for (unsigned int y = 0; y < imageData.height; ++y)
+			png_write_end(png_ptr, NULL);
+			png_free(png_ptr, row);
+
+			png_destroy_write_struct(&png_ptr, &info_ptr);
+		}
+	}
+
+	namespace
+	{
+		const uint32_t rawMagic = 0x57524353; // "SCRW"
+		const uint32_t rawVersion = 1;
+
+		// Header of the raw format, followed by width * height RGBPixelBuf in host byte order. It is 16 bytes,
+		// so the pixels of a mapped file stay aligned and load with a single copy.
+		struct RawHeader
+		{
+			uint32_t magic;
+			uint32_t width;
+			uint32_t height;
+			uint32_t version;
+		};
+
+		// Largest side accepted from an uncompressed header, so a corrupt header cannot request a huge buffer
+		const unsigned long maxUncompressedSide = 1u << 20;
+
+		// Size and pixel layout of an uncompressed image held in memory
+		struct UncompressedLayout
+		{
+			unsigned int width;
+			unsigned int height;
+
+			// Bytes per pixel for PAM and PPM: 1 gray, 2 gray and alpha, 3 RGB, 4 RGBA; 0 for raw
+			unsigned int channels;
+
+			size_t dataOffset;
+		};
+
+		// Read-only memory mapping of a whole file; pages are read on first touch, so nothing is copied up front
+		class MappedFile
+		{
+		private:
+			const unsigned char *bytes = nullptr;
+			size_t length = 0;
+
+		public:
+			MappedFile(const std::string &path, const char *openError)
 			{
-				for (unsigned int x = 0; x < imageData.width; ++x)
+				int descriptor = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+				if (descriptor < 0)
 				{
-					RGBPixelBuf pixel = imageData.getPixel(x, y);
-					png_bytep row = row_pointers[y];
-					png_bytep px = &(row[x * 4]);
-					px[0] = pixel.red;
-					px[1] = pixel.green;
-					px[2] = pixel.blue;
-					px[3] = pixel.opacity;
+					throw std::runtime_error(openError);
 				}
+
+				struct stat info;
+				if (::fstat(descriptor, &info) != 0 || info.st_size <= 0)
+				{
+					::close(descriptor);
+					throw std::runtime_error("Error reading image file");
+				}
+
+				length = static_cast<size_t>(info.st_size);
+				void *mapping = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, descriptor, 0);
+				::close(descriptor);
+				if (mapping == MAP_FAILED)
+				{
+					throw std::runtime_error("Error reading image file");
+				}
+
+				// Decoders read front to back, so let the kernel read ahead aggressively
+				::madvise(mapping, length, MADV_SEQUENTIAL);
+				bytes = static_cast<const unsigned char *>(mapping);
 			}
 
-			png_write_image(png_ptr, row_pointers);
-			png_write_end(png_ptr, NULL);
+			~MappedFile()
+			{
+				::munmap(const_cast<unsigned char *>(bytes), length);
+			}
+
+			MappedFile(const MappedFile &) = delete;
+			MappedFile &operator=(const MappedFile &) = delete;
+
+			const unsigned char *data() const { return bytes; }
 
-			for (unsigned int y = 0; y < imageData.height; ++y)
+			size_t size() const { return length; }
+		};
+
+		const char *openErrorMessage(ImageFormat format)
+		{
+			switch (format)
 			{
-				png_free(png_ptr, row_pointers[y]);
+			case ImageFormat::Jpeg:
+				return "Error opening JPEG file";
+			case ImageFormat::Png:
+				return "Error opening PNG file";
+			default:
+				return "Error opening image file";
 			}
-			png_free(png_ptr, row_pointers);
+		}
 
-			png_destroy_write_struct(&png_ptr, &info_ptr);
-			fclose(outfile);
+		bool isUncompressed(ImageFormat format)
+		{
+			return format == ImageFormat::Pam || format == ImageFormat::Ppm || format == ImageFormat::Raw;
+		}
+
+		// Reads the whitespace separated tokens of a Netpbm header, skipping comments
+		class NetpbmHeaderReader
+		{
+		private:
+			const unsigned char *data;
+			size_t size;
+
+			void skipSpace()
+			{
+				while (offset < size)
+				{
+					if (data[offset] == '#')
+					{
+						while (offset < size && data[offset] != '\n')
+						{
+							++offset;
+						}
+					}
+					else if (std::isspace(data[offset]))
+					{
+						++offset;
+					}
+					else
+					{
+						break;
+					}
+				}
+			}
+
+		public:
+			size_t offset = 2;
+
+			NetpbmHeaderReader(const unsigned char *data, size_t size) : data(data), size(size) {}
+
+			std::string word()
+			{
+				skipSpace();
+				size_t start = offset;
+				while (offset < size && !std::isspace(data[offset]))
+				{
+					++offset;
+				}
+				return std::string(reinterpret_cast<const char *>(data) + start, offset - start);
+			}
+
+			unsigned long number()
+			{
+				std::string token = word();
+				if (token.empty() || token.size() > 9 || token.find_first_not_of("0123456789") != std::string::npos)
+				{
+					throw std::runtime_error("Malformed Netpbm header");
+				}
+				return std::stoul(token);
+			}
+
+			// Step past the single whitespace byte that separates the header from the pixels
+			void endHeader()
+			{
+				if (offset >= size || !std::isspace(data[offset]))
+				{
+					throw std::runtime_error("Malformed Netpbm header");
+				}
+				++offset;
+			}
+
+			// Step past the rest of the current line
+			void endLine()
+			{
+				while (offset < size && data[offset] != '\n')
+				{
+					++offset;
+				}
+				endHeader();
+			}
+		};
+
+		// With checkData false only the header has to be present, as when probing the size of a file
+		UncompressedLayout readUncompressedLayout(const unsigned char *data, size_t size, ImageFormat format, bool checkData = true)
+		{
+			UncompressedLayout layout = {};
+			if (format == ImageFormat::Raw)
+			{
+				RawHeader header;
+				if (size < sizeof(header))
+				{
+					throw std::runtime_error("Truncated raw image");
+				}
+				std::memcpy(&header, data, sizeof(header));
+				if (header.magic != rawMagic || header.version != rawVersion)
+				{
+					throw std::runtime_error("Unsupported raw image version");
+				}
+				layout = {header.width, header.height, 0, sizeof(header)};
+			}
+			else
+			{
+				NetpbmHeaderReader reader(data, size);
+				unsigned long width = 0, height = 0, depth = 0, maxValue = 0;
+				if (size >= 2 && data[1] == '7')
+				{
+					for (std::string key = reader.word(); key != "ENDHDR"; key = reader.word())
+					{
+						if (key == "WIDTH")
+						{
+							width = reader.number();
+						}
+						else if (key == "HEIGHT")
+						{
+							height = reader.number();
+						}
+						else if (key == "DEPTH")
+						{
+							depth = reader.number();
+						}
+						else if (key == "MAXVAL")
+						{
+							maxValue = reader.number();
+						}
+						else if (key == "TUPLTYPE")
+						{
+							// The tuple type only names what DEPTH already says
+							reader.endLine();
+						}
+						else
+						{
+							throw std::runtime_error("Malformed PAM header");
+						}
+					}
+					reader.endLine();
+				}
+				else
+				{
+					depth = data[1] == '5' ? 1 : 3;
+					width = reader.number();
+					height = reader.number();
+					maxValue = reader.number();
+					reader.endHeader();
+				}
+
+				if (maxValue != 255)
+				{
+					throw std::runtime_error("Only 8-bit PAM and PPM images are supported");
+				}
+				if (depth < 1 || depth > 4)
+				{
+					throw std::runtime_error("Unsupported PAM depth");
+				}
+				layout = {static_cast<unsigned int>(width), static_cast<unsigned int>(height), static_cast<unsigned int>(depth), reader.offset};
+			}
+
+			if (layout.width == 0 || layout.height == 0 || layout.width > maxUncompressedSide || layout.height > maxUncompressedSide)
+			{
+				throw std::runtime_error("Invalid image dimensions");
+			}
+
+			size_t pixelBytes = layout.channels ? layout.channels : sizeof(RGBPixelBuf);
+			if (checkData && size - layout.dataOffset < static_cast<size_t>(layout.width) * layout.height * pixelBytes)
+			{
+				throw std::runtime_error("Truncated image data");
+			}
+			return layout;
+		}
+
+		// Rows of a PAM, PPM or raw image expanded to RGBA; no decoding beyond widening the channels
+		void decodeUncompressed(const unsigned char *data, size_t size, ImageFormat format, ScanlineSink &sink)
+		{
+			UncompressedLayout layout = readUncompressedLayout(data, size, format);
+			std::vector<uint8_t> rgba(static_cast<size_t>(layout.width) * 4);
+			sink.start(layout.width, layout.height);
+
+			for (unsigned int y = 0; y < layout.height; ++y)
+			{
+				if (layout.channels == 0)
+				{
+					RGBPixelBuf pixel;
+					const unsigned char *row = data + layout.dataOffset + static_cast<size_t>(y) * layout.width * sizeof(RGBPixelBuf);
+					for (unsigned int x = 0; x < layout.width; ++x)
+					{
+						std::memcpy(&pixel, row + x * sizeof(RGBPixelBuf), sizeof(pixel));
+						rgba[x * 4 + 0] = static_cast<uint8_t>(pixel.red);
+						rgba[x * 4 + 1] = static_cast<uint8_t>(pixel.green);
+						rgba[x * 4 + 2] = static_cast<uint8_t>(pixel.blue);
+						rgba[x * 4 + 3] = static_cast<uint8_t>(pixel.opacity);
+					}
+				}
+				else
+				{
+					const unsigned char *row = data + layout.dataOffset + static_cast<size_t>(y) * layout.width * layout.channels;
+					for (unsigned int x = 0; x < layout.width; ++x)
+					{
+						const unsigned char *pixel = row + x * layout.channels;
+						bool colour = layout.channels >= 3;
+						rgba[x * 4 + 0] = pixel[0];
+						rgba[x * 4 + 1] = colour ? pixel[1] : pixel[0];
+						rgba[x * 4 + 2] = colour ? pixel[2] : pixel[0];
+						rgba[x * 4 + 3] = layout.channels % 2 == 0 ? pixel[layout.channels - 1] : 255;
+					}
+				}
+				sink.writeRow(y, rgba.data());
+			}
+		}
+
+		// Load into an ImageData; the raw format is already in its layout, so it is copied as one block
+		void loadUncompressed(const unsigned char *data, size_t size, ImageFormat format, ImageData &imageData)
+		{
+			if (format != ImageFormat::Raw)
+			{
+				ImageDataSink sink(imageData);
+				decodeUncompressed(data, size, format, sink);
+				return;
+			}
+
+			UncompressedLayout layout = readUncompressedLayout(data, size, format);
+			imageData.resizeBuffer(layout.width, layout.height);
+			std::memcpy(imageData.rgbPixelData, data + layout.dataOffset, static_cast<size_t>(layout.width) * layout.height * sizeof(RGBPixelBuf));
+		}
+
+		std::string uncompressedHeader(ImageFormat format, unsigned int width, unsigned int height)
+		{
+			if (format == ImageFormat::Raw)
+			{
+				RawHeader header = {rawMagic, width, height, rawVersion};
+				return std::string(reinterpret_cast<const char *>(&header), sizeof(header));
+			}
+			if (format == ImageFormat::Ppm)
+			{
+				return "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+			}
+			return "P7\nWIDTH " + std::to_string(width) + "\nHEIGHT " + std::to_string(height) +
+				   "\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n";
+		}
+
+		// PAM keeps all four channels, PPM drops alpha like JPEG does, and raw widens them to RGBPixelBuf
+		void encodeUncompressed(ScanlineSource &source, ImageFormat format, const EncodedOutput &output)
+		{
+			const unsigned int width = source.width();
+			const unsigned int height = source.height();
+			const size_t pixelBytes = format == ImageFormat::Raw ? sizeof(RGBPixelBuf) : format == ImageFormat::Ppm ? 3
+																													  : 4;
+			std::string header = uncompressedHeader(format, width, height);
+			std::vector<uint8_t> rgba(static_cast<size_t>(width) * 4);
+			std::vector<unsigned char> packed(width * pixelBytes);
+
+			if (output.file)
+			{
+				if (std::fwrite(header.data(), 1, header.size(), output.file) != header.size())
+				{
+					throw std::runtime_error("Error writing image file");
+				}
+			}
+			else
+			{
+				output.bytes->reserve(header.size() + static_cast<size_t>(height) * packed.size());
+				output.bytes->assign(header.begin(), header.end());
+			}
+
+			for (unsigned int y = 0; y < height; ++y)
+			{
+				source.readRow(y, rgba.data());
+				if (format == ImageFormat::Raw)
+				{
+					for (unsigned int x = 0; x < width; ++x)
+					{
+						RGBPixelBuf pixel = {rgba[x * 4 + 0], rgba[x * 4 + 1], rgba[x * 4 + 2], rgba[x * 4 + 3]};
+						std::memcpy(&packed[x * pixelBytes], &pixel, sizeof(pixel));
+					}
+				}
+				else if (format == ImageFormat::Ppm)
+				{
+					for (unsigned int x = 0; x < width; ++x)
+					{
+						packed[x * 3 + 0] = rgba[x * 4 + 0];
+						packed[x * 3 + 1] = rgba[x * 4 + 1];
+						packed[x * 3 + 2] = rgba[x * 4 + 2];
+					}
+				}
+				else
+				{
+					std::copy(rgba.begin(), rgba.end(), packed.begin());
+				}
+
+				if (output.file)
+				{
+					if (std::fwrite(packed.data(), 1, packed.size(), output.file) != packed.size())
+					{
+						throw std::runtime_error("Error writing image file");
+					}
+				}
+				else
+				{
+					output.bytes->insert(output.bytes->end(), packed.begin(), packed.end());
+				}
+			}
+		}
+
+		// Write the pieces to a new file with writev, repeating only if the kernel accepts part of them
+		void writeWholeFile(const std::string &path, ImageFormat format, std::vector<iovec> pieces)
+		{
+			STRONK_PROFILE_SCOPE("write");
+
+			int descriptor = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+			if (descriptor < 0)
+			{
+				throw std::runtime_error(openErrorMessage(format));
+			}
+
+			size_t next = 0;
+			while (next < pieces.size())
+			{
+				ssize_t written = ::writev(descriptor, &pieces[next], static_cast<int>(std::min<size_t>(pieces.size() - next, IOV_MAX)));
+				if (written < 0)
+				{
+					if (errno == EINTR)
+					{
+						continue;
+					}
+					::close(descriptor);
+					throw std::runtime_error("Error writing image file");
+				}
+
+				// Skip what was written, which may end part way through a piece
+				size_t remaining = static_cast<size_t>(written);
+				while (next < pieces.size() && remaining >= pieces[next].iov_len)
+				{
+					remaining -= pieces[next].iov_len;
+					++next;
+				}
+				if (remaining > 0)
+				{
+					pieces[next].iov_base = static_cast<char *>(pieces[next].iov_base) + remaining;
+					pieces[next].iov_len -= remaining;
+				}
+			}
+
+			if (::close(descriptor) != 0)
+			{
+				throw std::runtime_error("Error writing image file");
+			}
+		}
+	}
+
+	ImageInfo Image::probe(const unsigned char *data, size_t size)
+	{
+		ImageInfo info;
+		info.format = formatFromSignature(data, size);
+		switch (info.format)
+		{
+		case ImageFormat::Jpeg:
+		{
+			jpeg_decompress_struct cinfo;
+			JpegErrorManager jerr;
+			cinfo.err = jpeg_std_error(&jerr.pub);
+			jerr.pub.error_exit = jpegErrorExit;
+			if (setjmp(jerr.setjmpBuffer))
+			{
+				jpeg_destroy_decompress(&cinfo);
+				throw std::runtime_error(std::string("Error reading JPEG header: ") + jerr.message);
+			}
+
+			// The header ends at the start of the scan, so no entropy-coded data is touched
+			jpeg_create_decompress(&cinfo);
+			jpeg_mem_src(&cinfo, data, size);
+			jpeg_read_header(&cinfo, TRUE);
+			info.width = cinfo.image_width;
+			info.height = cinfo.image_height;
+			jpeg_destroy_decompress(&cinfo);
+			break;
+		}
+		case ImageFormat::Png:
+		{
+			// IHDR is always the first chunk: length, type, then big-endian width and height
+			if (size < 24 || std::memcmp(data + 12, "IHDR", 4) != 0)
+			{
+				throw std::runtime_error("Error reading PNG header");
+			}
+			auto bigEndian = [data](size_t offset)
+			{
+				return static_cast<unsigned int>(data[offset]) << 24 | data[offset + 1] << 16 | data[offset + 2] << 8 | data[offset + 3];
+			};
+			info.width = bigEndian(16);
+			info.height = bigEndian(20);
+			break;
+		}
+		case ImageFormat::Pam:
+		case ImageFormat::Ppm:
+		case ImageFormat::Raw:
+		{
+			UncompressedLayout layout = readUncompressedLayout(data, size, info.format, false);
+			info.width = layout.width;
+			info.height = layout.height;
+			break;
+		}
+		default:
+			throw std::runtime_error("Unsupported file format");
+		}
+
+		if (info.width == 0 || info.height == 0)
+		{
+			throw std::runtime_error("Invalid image dimensions");
+		}
+		return info;
+	}
+
+	ImageInfo Image::probe(const std::string &imageSpec)
+	{
+		MappedFile file(imageSpec, openErrorMessage(formatFromPath(imageSpec)));
+		return probe(file.data(), file.size());
+	}
+
+	ImageFormat Image::formatFromPath(const std::string &imageSpec)
+	{
+		std::string extension = fileExtension(imageSpec);
+		if (extension == "jpg" || extension == "jpeg")
+		{
+			return ImageFormat::Jpeg;
+		}
+		if (extension == "png")
+		{
+			return ImageFormat::Png;
+		}
+		if (extension == "pam")
+		{
+			return ImageFormat::Pam;
+		}
+		if (extension == "ppm" || extension == "pgm")
+		{
+			return ImageFormat::Ppm;
 		}
+		if (extension == "raw")
+		{
+			return ImageFormat::Raw;
+		}
+		return ImageFormat::Unknown;
+	}
+
+	ImageFormat Image::formatForWriting(const std::string &imageSpec)
+	{
+		ImageFormat format = formatFromPath(imageSpec);
+		if (format == ImageFormat::Unknown)
+		{
+			throw std::runtime_error("Unsupported file format");
+		}
+		if (fileExtension(imageSpec) == "pgm")
+		{
+			throw std::runtime_error("Gray .pgm files are only read; write .ppm or .pam instead");
+		}
+		return format;
+	}
+
+	ImageFormat Image::formatFromSignature(const unsigned char *data, size_t size)
+	{
+		static const unsigned char pngSignature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+
+		if (size >= 3 && data[0] == 0xff && data[1] == 0xd8 && data[2] == 0xff)
+		{
+			return ImageFormat::Jpeg;
+		}
+		if (size >= sizeof(pngSignature) && std::memcmp(data, pngSignature, sizeof(pngSignature)) == 0)
+		{
+			return ImageFormat::Png;
+		}
+		if (size >= 3 && data[0] == 'P' && std::isspace(data[2]))
+		{
+			if (data[1] == '7')
+			{
+				return ImageFormat::Pam;
+			}
+			if (data[1] == '5' || data[1] == '6')
+			{
+				return ImageFormat::Ppm;
+			}
+		}
+		if (size >= sizeof(rawMagic) && std::memcmp(data, &rawMagic, sizeof(rawMagic)) == 0)
+		{
+			return ImageFormat::Raw;
+		}
+		return ImageFormat::Unknown;
+	}
 
+	void Image::loadFromFile(const std::string &imageSpec)
+	{
+		STRONK_PROFILE_SCOPE("decode");
+
+		ImageFormat format = formatFromPath(imageSpec);
+		if (format == ImageFormat::Unknown)
+		{
+			throw std::runtime_error("Unsupported file format");
+		}
+
+		// Map the file instead of reading it, so the bytes are never copied into a buffer of our own
+		MappedFile file(imageSpec, openErrorMessage(format));
+		if (isUncompressed(format))
+		{
+			loadUncompressed(file.data(), file.size(), format, imageData);
+			return;
+		}
+
+		ImageDataSink sink(imageData);
+		EncodedInput input = {file.data(), file.size(), NULL};
+		if (format == ImageFormat::Jpeg)
+		{
+			decodeJpeg(input, sink);
+		}
 		else
 		{
+			decodePng(input, sink);
+		}
+	}
+
+	void Image::loadFromMemory(const unsigned char *data, size_t size)
+	{
+		STRONK_PROFILE_SCOPE("decode");
+
+		ImageDataSink sink(imageData);
+		EncodedInput input = {data, size, NULL};
+		ImageFormat format = formatFromSignature(data, size);
+		switch (format)
+		{
+		case ImageFormat::Jpeg:
+			decodeJpeg(input, sink);
+			break;
+		case ImageFormat::Png:
+			decodePng(input, sink);
+			break;
+		case ImageFormat::Pam:
+		case ImageFormat::Ppm:
+		case ImageFormat::Raw:
+			loadUncompressed(data, size, format, imageData);
+			break;
+		default:
 			throw std::runtime_error("Unsupported file format");
 		}
+	}
+
+	std::vector<unsigned char> Image::writeToMemory(ImageFormat format)
+	{
+		STRONK_PROFILE_SCOPE("encode");
+
+		ImageDataSource source(imageData);
+		std::vector<unsigned char> encoded;
+		EncodedOutput output = {&encoded, NULL};
+		switch (format)
+		{
+		case ImageFormat::Jpeg:
+			encodeJpeg(source, output);
+			break;
+		case ImageFormat::Png:
+			encodePng(source, output);
+			break;
+		case ImageFormat::Pam:
+		case ImageFormat::Ppm:
+		case ImageFormat::Raw:
+			encodeUncompressed(source, format, output);
+			break;
+		default:
+			throw std::runtime_error("Unsupported file format");
+		}
+		return encoded;
+	}
+
+	bool Image::writeToFile(const std::string &imageSpec)
+	{
+		ImageFormat format = formatForWriting(imageSpec);
+
+		// Raw files are the pixel buffer behind a header, so they go out straight from the image
+		if (format == ImageFormat::Raw)
+		{
+			STRONK_PROFILE_SCOPE("encode");
+
+			std::string header = uncompressedHeader(format, imageData.width, imageData.height);
+			writeWholeFile(imageSpec, format, {{&header[0], header.size()}, {imageData.rgbPixelData, static_cast<size_t>(imageData.width) * imageData.height * sizeof(RGBPixelBuf)}});
+			return true;
+		}
+
+		std::vector<unsigned char> encoded = writeToMemory(format);
+		writeWholeFile(imageSpec, format, {{encoded.data(), encoded.size()}});
 		return true;
 	}
-}
\ No newline at end of file
+
+	void Image::decodeScanlines(const std::string &imageSpec, ScanlineSink &sink)
+	{
+		STRONK_PROFILE_SCOPE("decode");
+
+		ImageFormat format = formatFromPath(imageSpec);
+		if (format == ImageFormat::Unknown)
+		{
+			throw std::runtime_error("Unsupported file format");
+		}
+
+		// Uncompressed rows are expanded straight from the mapping, which the kernel pages in and out as needed
+		if (isUncompressed(format))
+		{
+			MappedFile file(imageSpec, openErrorMessage(format));
+			decodeUncompressed(file.data(), file.size(), format, sink);
+			return;
+		}
+
+		FILE *infile = fopen(imageSpec.c_str(), "rb");
+		if (!infile)
+		{
+			throw std::runtime_error(openErrorMessage(format));
+		}
+
+		// The codec pulls the file through stdio, so neither the encoded nor the decoded image is held whole
+		EncodedInput input = {NULL, 0, infile};
+		try
+		{
+			if (format == ImageFormat::Jpeg)
+			{
+				decodeJpeg(input, sink);
+			}
+			else
+			{
+				decodePng(input, sink);
+			}
+		}
+		catch (...)
+		{
+			fclose(infile);
+			throw;
+		}
+		fclose(infile);
+	}
+
+	void Image::encodeScanlines(const std::string &imageSpec, ScanlineSource &source)
+	{
+		STRONK_PROFILE_SCOPE("encode");
+
+		ImageFormat format = formatForWriting(imageSpec);
+
+		FILE *outfile = fopen(imageSpec.c_str(), "wb");
+		if (!outfile)
+		{
+			throw std::runtime_error(openErrorMessage(format));
+		}
+
+		EncodedOutput output = {NULL, outfile};
+		try
+		{
+			if (format == ImageFormat::Jpeg)
+			{
+				encodeJpeg(source, output);
+			}
+			else if (format == ImageFormat::Png)
+			{
+				encodePng(source, output);
+			}
+			else
+			{
+				encodeUncompressed(source, format, output);
+			}
+		}
+		catch (...)
+		{
+			fclose(outfile);
+			throw;
+		}
+
+		if (fclose(outfile) != 0)
+		{
+			throw std::runtime_error("Error writing image file");
+		}
+	}
+}
@@ -0,0 +1,233 @@
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
+#include <GrayImage.h>
+#include <Pipeline.h>
+
+namespace StronkImage
+{
+	namespace
+	{
+		using Kind = PipelineStage::Kind;
+
+		PipelineStage makeStage(Kind kind)
+		{
+			PipelineStage stage;
+			stage.kind = kind;
+			return stage;
+		}
+
+		// Follow the format through the declared stages, dropping the ones that do nothing and inserting the
+		// grayscale conversion a gradient needs
+		std::vector<PipelineStage> resolveFormats(const std::vector<PipelineStage> &declared)
+		{
+			std::vector<PipelineStage> resolved;
+			PixelFormat format = PixelFormat::Colour;
+
+			for (const PipelineStage &stage : declared)
+			{
+				if (format == PixelFormat::Energy)
+				{
+					throw std::invalid_argument("No pipeline stage can follow the gradient");
+				}
+
+				switch (stage.kind)
+				{
+				case Kind::Blur:
+					if (stage.sigma > 0.0f)
+					{
+						resolved.push_back(stage);
+					}
+					break;
+				case Kind::Grayscale:
+					if (format == PixelFormat::Colour)
+					{
+						resolved.push_back(stage);
+						format = PixelFormat::Gray;
+					}
+					break;
+				case Kind::Gradient:
+					if (format == PixelFormat::Colour)
+					{
+						resolved.push_back(makeStage(Kind::Grayscale));
+					}
+					resolved.push_back(stage);
+					format = PixelFormat::Energy;
+					break;
+				}
+			}
+			return resolved;
+		}
+
+		// Luminance is a weighted sum of the channels, so it commutes with the blur up to rounding. Moving it
+		// first means the blur reads and writes one channel instead of three.
+		void convertBeforeBlurs(std::vector<PipelineStage> &stages)
+		{
+			for (bool moved = true; moved;)
+			{
+				moved = false;
+				for (size_t i = 0; i + 1 < stages.size(); ++i)
+				{
+					if (stages[i].kind == Kind::Blur && stages[i + 1].kind == Kind::Grayscale)
+					{
+						std::swap(stages[i], stages[i + 1]);
+						moved = true;
+					}
+				}
+			}
+		}
+
+		// Two Gaussians in a row are one Gaussian whose variance is the sum of theirs
+		void mergeBlurs(std::vector<PipelineStage> &stages)
+		{
+			for (size_t i = 0; i + 1 < stages.size();)
+			{
+				PipelineStage &first = stages[i];
+				const PipelineStage &second = stages[i + 1];
+				if (first.kind == Kind::Blur && second.kind == Kind::Blur && first.mode == second.mode)
+				{
+					first.sigma = std::sqrt(first.sigma * first.sigma + second.sigma * second.sigma);
+					stages.erase(stages.begin() + i + 1);
+				}
+				else
+				{
+					++i;
+				}
+			}
+		}
+
+		// Every stage that reads Gray can convert its input rows itself, so the Gray image is never stored
+		void fuseConversions(std::vector<PipelineStage> &stages)
+		{
+			for (size_t i = 0; i + 1 < stages.size(); ++i)
+			{
+				if (stages[i].kind == Kind::Grayscale && !stages[i].readsColour)
+				{
+					stages[i + 1].readsColour = true;
+					stages.erase(stages.begin() + i);
+				}
+			}
+		}
+
+		ImageData expandGray(const GrayImageData &grayscaleImage)
+		{
+			ImageData expanded(grayscaleImage.width, grayscaleImage.height);
+			size_t pixelCount = static_cast<size_t>(grayscaleImage.width) * grayscaleImage.height;
+			for (size_t i = 0; i < pixelCount; ++i)
+			{
+				Quantum value = grayscaleImage.pixels[i];
+				expanded.rgbPixelData[i] = {value, value, value, 255};
+			}
+			return expanded;
+		}
+	}
+
+	std::string PipelineStage::name() const
+	{
+		std::string stageName = kind == Kind::Blur ? "blur" : kind == Kind::Grayscale ? "grayscale"
+																						: "gradient";
+		return readsColour ? "grayscale+" + stageName : stageName;
+	}
+
+	Pipeline &Pipeline::blur(float sigma, BlurMode mode)
+	{
+		PipelineStage stage = makeStage(Kind::Blur);
+		stage.sigma = sigma;
+		stage.mode = mode;
+		stages.push_back(stage);
+		return *this;
+	}
+
+	Pipeline &Pipeline::grayscale()
+	{
+		stages.push_back(makeStage(Kind::Grayscale));
+		return *this;
+	}
+
+	Pipeline &Pipeline::gradient()
+	{
+		stages.push_back(makeStage(Kind::Gradient));
+		return *this;
+	}
+
+	Pipeline Pipeline::energyMap(float sigma, BlurMode mode)
+	{
+		Pipeline pipeline;
+		pipeline.blur(sigma, mode).grayscale().gradient();
+		return pipeline;
+	}
+
+	std::vector<PipelineStage> Pipeline::plan(const PipelineOptions &options) const
+	{
+		std::vector<PipelineStage> planned = resolveFormats(stages);
+		if (options.reorder)
+		{
+			convertBeforeBlurs(planned);
+		}
+		if (options.mergeBlurs)
+		{
+			mergeBlurs(planned);
+		}
+		if (options.fuse)
+		{
+			fuseConversions(planned);
+		}
+		return planned;
+	}
+
+	ImageData Pipeline::run(const ImageData &colourImage, const PipelineOptions &options) const
+	{
+		// The caller's image is only copied if a blur has to run on the colour channels
+		const ImageData *colour = &colourImage;
+		ImageData blurredColour;
+		GrayImageData gray;
+		ImageData energy;
+		PixelFormat format = PixelFormat::Colour;
+
+		for (const PipelineStage &stage : plan(options))
+		{
+			switch (stage.kind)
+			{
+			case Kind::Grayscale:
+				gray = Filter::genGrayscale(*colour);
+				format = PixelFormat::Gray;
+				break;
+			case Kind::Blur:
+				if (stage.readsColour)
+				{
+					gray = Filter::blurredGrayscale(*colour, stage.sigma, stage.mode);
+					format = PixelFormat::Gray;
+				}
+				else if (format == PixelFormat::Colour)
+				{
+					if (colour != &blurredColour)
+					{
+						blurredColour = *colour;
+						colour = &blurredColour;
+					}
+					Filter::gaussianBlur(blurredColour, stage.sigma, stage.mode);
+				}
+				else
+				{
+					Filter::gaussianBlur(gray, stage.sigma, stage.mode);
+				}
+				break;
+			case Kind::Gradient:
+				energy = stage.readsColour ? Filter::generateEnergyMap(*colour) : Filter::generateEnergyMap(gray);
+				format = PixelFormat::Energy;
+				break;
+			}
+		}
+
+		switch (format)
+		{
+		case PixelFormat::Energy:
+			return energy;
+		case PixelFormat::Gray:
+			return expandGray(gray);
+		default:
+			return colour == &blurredColour ? std::move(blurredColour) : colourImage;
+		}
+	}
+}
@@ -0,0 +1,412 @@
+#include <cerrno>
+#include <cstring>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <Profiler.h>
+
+namespace StronkImage
+{
+	namespace
+	{
+		std::mutex stagesMutex;
+		std::vector<StageProfile> stages;
+
+		struct CounterEvent
+		{
+			const char *name;
+			const char *jsonName;
+			uint64_t StageCounters::*field;
+
+			// The text report shows CPU events in millions
+			bool millions;
+		};
+
+		const CounterEvent counterEvents[] = {
+			{"cycles", "cycles", &StageCounters::cycles, true},
+			{"instructions", "instructions", &StageCounters::instructions, true},
+			{"cache-misses", "cache_misses", &StageCounters::cacheMisses, true},
+			{"branch-misses", "branch_misses", &StageCounters::branchMisses, true},
+			{"page-faults", "page_faults", &StageCounters::pageFaults, false}};
+
+		const size_t counterEventCount = sizeof(counterEvents) / sizeof(counterEvents[0]);
+
+		// Events the thread that enabled counting could open, one bit per entry of counterEvents
+		std::atomic<unsigned int> countedEvents(0);
+
+		std::mutex countersStatusMutex;
+		std::string countersStatusText = "not enabled";
+
+		bool eventCounted(size_t event)
+		{
+			return countedEvents.load(std::memory_order_relaxed) & (1u << event);
+		}
+
+#ifdef __linux__
+		const struct
+		{
+			uint32_t type;
+			uint64_t config;
+		} perfEvents[counterEventCount] = {
+			{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+			{PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+			{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+			{PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+			{PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS}};
+
+		/*
+		 * The perf_event_open group of one thread. The first event that opens leads the group, so all of them
+		 * are scheduled on the PMU together and read with one system call. Kernel-mode counts are dropped
+		 * when perf_event_paranoid forbids them.
+		 */
+		class ThreadCounters
+		{
+		private:
+			bool opened = false;
+			int leader = -1;
+			std::vector<int> descriptors;
+
+			// Index in counterEvents of each member, in the order the kernel reports them
+			std::vector<size_t> members;
+
+			int openEvent(size_t event, bool excludeKernel)
+			{
+				perf_event_attr attributes;
+				std::memset(&attributes, 0, sizeof(attributes));
+				attributes.size = sizeof(attributes);
+				attributes.type = perfEvents[event].type;
+				attributes.config = perfEvents[event].config;
+				attributes.exclude_kernel = excludeKernel;
+				attributes.exclude_hv = 1;
+				attributes.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+				return static_cast<int>(syscall(SYS_perf_event_open, &attributes, 0, -1, leader, PERF_FLAG_FD_CLOEXEC));
+			}
+
+		public:
+			// The events that failed to open, and the reason the last one gave
+			std::vector<size_t> failed;
+			std::string error;
+			bool userOnly = false;
+
+			~ThreadCounters()
+			{
+				for (int descriptor : descriptors)
+				{
+					close(descriptor);
+				}
+			}
+
+			// Open the group once; returns the events that are counted, one bit each
+			unsigned int open()
+			{
+				if (!opened)
+				{
+					opened = true;
+					for (size_t event = 0; event < counterEventCount; ++event)
+					{
+						int descriptor = openEvent(event, userOnly);
+						if (descriptor < 0 && errno == EACCES && !userOnly)
+						{
+							userOnly = true;
+							descriptor = openEvent(event, true);
+						}
+						if (descriptor < 0)
+						{
+							failed.push_back(event);
+							error = std::strerror(errno);
+							continue;
+						}
+
+						if (leader < 0)
+						{
+							leader = descriptor;
+						}
+						descriptors.push_back(descriptor);
+						members.push_back(event);
+					}
+				}
+
+				unsigned int mask = 0;
+				for (size_t event : members)
+				{
+					mask |= 1u << event;
+				}
+				return mask;
+			}
+
+			bool read(StageCounters &counters)
+			{
+				if (open() == 0)
+				{
+					return false;
+				}
+
+				// nr, time enabled, time running, then one value per member
+				uint64_t values[3 + counterEventCount];
+				if (::read(leader, values, sizeof(values)) < static_cast<ssize_t>(3 * sizeof(uint64_t)))
+				{
+					return false;
+				}
+
+				// Scale up counts from a group that was multiplexed off the PMU for part of the time
+				double scale = values[2] > 0 && values[2] < values[1] ? static_cast<double>(values[1]) / values[2] : 1.0;
+				for (size_t i = 0; i < values[0] && i < members.size(); ++i)
+				{
+					counters.*counterEvents[members[i]].field = static_cast<uint64_t>(values[3 + i] * scale);
+				}
+				return true;
+			}
+		};
+
+		thread_local ThreadCounters threadCounters;
+#endif
+	}
+
+	std::atomic<bool> Profiler::active(false);
+	std::atomic<bool> Profiler::counting(false);
+
+	bool Profiler::compiledIn()
+	{
+#ifdef STRONKIMAGE_PROFILING
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	void Profiler::setEnabled(bool enabled)
+	{
+		active.store(enabled, std::memory_order_relaxed);
+	}
+
+	bool Profiler::enableCounters(bool enabled)
+	{
+		if (!enabled)
+		{
+			counting.store(false, std::memory_order_relaxed);
+			return true;
+		}
+
+#ifdef __linux__
+		unsigned int mask = threadCounters.open();
+		std::string counted, unavailable;
+		for (size_t event = 0; event < counterEventCount; ++event)
+		{
+			std::string &list = mask & (1u << event) ? counted : unavailable;
+			list += (list.empty() ? "" : ", ") + std::string(counterEvents[event].name);
+		}
+
+		std::string status = counted.empty() ? "unavailable" : counted + (threadCounters.userOnly ? " (user space only)" : "");
+		if (!unavailable.empty())
+		{
+			status += (counted.empty() ? " (" : "; " + unavailable + " unavailable (") + threadCounters.error + ")";
+		}
+#else
+		unsigned int mask = 0;
+		std::string status = "unavailable (perf_event_open needs Linux)";
+#endif
+
+		{
+			std::lock_guard<std::mutex> lock(countersStatusMutex);
+			countersStatusText = status;
+		}
+		countedEvents.store(mask, std::memory_order_relaxed);
+		counting.store(mask != 0, std::memory_order_relaxed);
+		return mask != 0;
+	}
+
+	std::string Profiler::countersStatus()
+	{
+		std::lock_guard<std::mutex> lock(countersStatusMutex);
+		return countersStatusText;
+	}
+
+	bool Profiler::readCounters(StageCounters &counters)
+	{
+#ifdef __linux__
+		return threadCounters.read(counters);
+#else
+		(void)counters;
+		return false;
+#endif
+	}
+
+	void Profiler::record(const char *stage, double seconds, uint64_t allocations, uint64_t bytesAllocated, const StageCounters *counters)
+	{
+		std::lock_guard<std::mutex> lock(stagesMutex);
+
+		// Only a handful of stages exist, so a linear scan beats hashing the name
+		StageProfile *profile = nullptr;
+		for (StageProfile &candidate : stages)
+		{
+			if (candidate.name == stage)
+			{
+				profile = &candidate;
+				break;
+			}
+		}
+
+		if (!profile)
+		{
+			stages.push_back(StageProfile());
+			profile = &stages.back();
+			profile->name = stage;
+		}
+
+		++profile->calls;
+		profile->seconds += seconds;
+		profile->allocations += allocations;
+		profile->bytesAllocated += bytesAllocated;
+
+		if (counters)
+		{
+			for (const CounterEvent &event : counterEvents)
+			{
+				profile->counters.*event.field += (*counters).*event.field;
+			}
+			++profile->countedCalls;
+		}
+	}
+
+	std::vector<StageProfile> Profiler::snapshot()
+	{
+		std::lock_guard<std::mutex> lock(stagesMutex);
+		return stages;
+	}
+
+	void Profiler::reset()
+	{
+		std::lock_guard<std::mutex> lock(stagesMutex);
+		stages.clear();
+	}
+
+	std::string Profiler::summary()
+	{
+		std::ostringstream report;
+
+		if (!compiledIn())
+		{
+			report << "Profiling was compiled out of this build (SEAMCARVER_PROFILING=OFF)\n";
+			return report.str();
+		}
+
+		report << std::left << std::setw(14) << "stage"
+			   << std::right << std::setw(8) << "calls"
+			   << std::setw(14) << "total ms"
+			   << std::setw(14) << "ms/call"
+			   << std::setw(10) << "allocs"
+			   << std::setw(14) << "alloc MiB" << "\n";
+
+		report << std::fixed;
+		for (const StageProfile &stage : snapshot())
+		{
+			report << std::left << std::setw(14) << stage.name
+				   << std::right << std::setw(8) << stage.calls
+				   << std::setw(14) << std::setprecision(3) << stage.seconds * 1e3
+				   << std::setw(14) << std::setprecision(4) << stage.seconds * 1e3 / stage.calls
+				   << std::setw(10) << stage.allocations
+				   << std::setw(14) << std::setprecision(2) << stage.bytesAllocated / (1024.0 * 1024.0) << "\n";
+		}
+
+		if (countersEnabled())
+		{
+			report << "counters: " << countersStatus() << "\n";
+
+			// Millions of each CPU event, with instructions per cycle where both were counted
+			bool ipc = eventCounted(0) && eventCounted(1);
+			report << std::left << std::setw(14) << "stage" << std::right;
+			for (size_t event = 0; event < counterEventCount; ++event)
+			{
+				if (eventCounted(event))
+				{
+					report << std::setw(15) << (counterEvents[event].millions ? "M" : "") + std::string(counterEvents[event].name);
+				}
+			}
+			report << (ipc ? "        IPC" : "") << "\n";
+
+			for (const StageProfile &stage : snapshot())
+			{
+				report << std::left << std::setw(14) << stage.name << std::right;
+				for (size_t event = 0; event < counterEventCount; ++event)
+				{
+					if (eventCounted(event))
+					{
+						const CounterEvent &counter = counterEvents[event];
+						if (counter.millions)
+						{
+							report << std::setw(15) << std::setprecision(3) << stage.counters.*counter.field / 1e6;
+						}
+						else
+						{
+							report << std::setw(15) << stage.counters.*counter.field;
+						}
+					}
+				}
+				if (ipc)
+				{
+					report << std::setw(11) << std::setprecision(2) << (stage.counters.cycles ? static_cast<double>(stage.counters.instructions) / stage.counters.cycles : 0.0);
+				}
+				report << "\n";
+			}
+		}
+		else if (countersStatus() != "not enabled")
+		{
+			report << "counters: " << countersStatus() << "\n";
+		}
+
+		BufferPoolStats pool = BufferPool::global().stats();
+		report << "buffer pool: " << pool.hits << " hits, " << pool.misses << " misses, peak "
+			   << std::setprecision(2) << pool.peakBytesInUse / (1024.0 * 1024.0) << " MiB in use\n";
+
+		return report.str();
+	}
+
+	std::string Profiler::toJson()
+	{
+		std::ostringstream report;
+		report << std::setprecision(9);
+
+		report << "{\"compiled_in\":" << (compiledIn() ? "true" : "false") << ",\"stages\":[";
+
+		bool first = true;
+		for (const StageProfile &stage : snapshot())
+		{
+			report << (first ? "" : ",")
+				   << "{\"name\":\"" << stage.name << "\""
+				   << ",\"calls\":" << stage.calls
+				   << ",\"seconds\":" << stage.seconds
+				   << ",\"allocations\":" << stage.allocations
+				   << ",\"bytes_allocated\":" << stage.bytesAllocated;
+			if (countersEnabled())
+			{
+				report << ",\"counted_calls\":" << stage.countedCalls;
+				for (size_t event = 0; event < counterEventCount; ++event)
+				{
+					if (eventCounted(event))
+					{
+						report << ",\"" << counterEvents[event].jsonName << "\":" << stage.counters.*counterEvents[event].field;
+					}
+				}
+			}
+			report << "}";
+			first = false;
+		}
+
+		BufferPoolStats pool = BufferPool::global().stats();
+		report << "],\"buffer_pool\":{\"hits\":" << pool.hits
+			   << ",\"misses\":" << pool.misses
+			   << ",\"peak_bytes_in_use\":" << pool.peakBytesInUse
+			   << ",\"bytes_cached\":" << pool.bytesCached << "}"
+			   << ",\"counters\":{\"enabled\":" << (countersEnabled() ? "true" : "false")
+			   << ",\"status\":\"" << countersStatus() << "\"}}";
+
+		return report.str();
+	}
+}
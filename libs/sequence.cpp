@@ -0,0 +1,130 @@
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#include <Sequence.h>
+
+namespace StronkImage
+{
+	namespace
+	{
+		bool samePixels(const ImageData &a, const ImageData &b)
+		{
+			return a.width == b.width && a.height == b.height && a.rgbPixelData && b.rgbPixelData &&
+				   std::memcmp(a.rgbPixelData, b.rgbPixelData, static_cast<size_t>(a.width) * a.height * sizeof(RGBPixelBuf)) == 0;
+		}
+	}
+
+	SequenceCarver::SequenceCarver(int numSeams, const SequenceOptions &options)
+		: numSeams(numSeams), options(options) {}
+
+	void SequenceCarver::carveFrame(ImageData &frame)
+	{
+		auto started = std::chrono::steady_clock::now();
+		++counters.frames;
+
+		if (samePixels(frame, previousInput))
+		{
+			frame = previousOutput;
+			++counters.reusedFrames;
+			counters.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+			return;
+		}
+
+		ImageData energyMap = Carver::generateEnergyMap(frame, options.carveOptions);
+
+		// Seams of a differently sized frame are meaningless, so those always start a new keyframe
+		bool sameSize = frame.width == previousInput.width && frame.height == previousInput.height;
+		bool keyframe = !sameSize || previousSeams.empty() ||
+						(options.keyframeInterval > 0 && (counters.frames - 1) % options.keyframeInterval == 0);
+
+		SeamRegion region = options.carveOptions.region;
+		if (keyframe)
+		{
+			++counters.keyframes;
+		}
+		else
+		{
+			region.guides = &previousSeams;
+			region.bandRadius = options.bandRadius;
+		}
+
+		previousInput = frame;
+
+		std::vector<std::vector<int>> seams;
+		Filter::removeSeams(frame, energyMap, numSeams, region, &seams);
+
+		previousSeams = std::move(seams);
+		previousOutput = frame;
+
+		counters.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+	}
+
+	std::string SequenceCarver::framePath(const std::string &pattern, int index)
+	{
+		// The pattern never reaches printf; only one %d, with an optional zero flag and width, and %% escapes are accepted
+		std::string path;
+		bool numbered = false;
+		for (size_t i = 0; i < pattern.size(); ++i)
+		{
+			if (pattern[i] != '%')
+			{
+				path += pattern[i];
+				continue;
+			}
+
+			if (i + 1 < pattern.size() && pattern[i + 1] == '%')
+			{
+				path += '%';
+				++i;
+				continue;
+			}
+
+			size_t end = i + 1;
+			bool zeroPad = end < pattern.size() && pattern[end] == '0';
+			if (zeroPad)
+			{
+				++end;
+			}
+			size_t widthBegin = end;
+			while (end < pattern.size() && std::isdigit(static_cast<unsigned char>(pattern[end])) && end - widthBegin < 3)
+			{
+				++end;
+			}
+			if (end >= pattern.size() || pattern[end] != 'd' || numbered)
+			{
+				throw std::invalid_argument("Frame pattern " + pattern + " must contain exactly one %d, optionally as %0Nd, and no other conversions");
+			}
+
+			int width = widthBegin == end ? 0 : std::stoi(pattern.substr(widthBegin, end - widthBegin));
+			char digits[160];
+			std::snprintf(digits, sizeof(digits), zeroPad ? "%0*d" : "%*d", width, index);
+			path += digits;
+			numbered = true;
+			i = end;
+		}
+
+		if (!numbered)
+		{
+			throw std::invalid_argument("Frame pattern " + pattern + " has no frame number, e.g. %04d");
+		}
+		return path;
+	}
+
+	SequenceStats SequenceCarver::run(const std::string &inputPattern, const std::string &outputPattern, int firstFrame, int numFrames,
+									  int numSeams, const SequenceOptions &options)
+	{
+		SequenceCarver carver(numSeams, options);
+
+		for (int index = firstFrame; index < firstFrame + numFrames; ++index)
+		{
+			Image frame(framePath(inputPattern, index));
+			carver.carveFrame(frame.getRawImageData());
+			frame.writeToFile(framePath(outputPattern, index));
+		}
+
+		return carver.stats();
+	}
+}
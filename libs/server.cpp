@@ -0,0 +1,623 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <Server.h>
+
+namespace StronkImage
+{
+	namespace
+	{
+		const uint32_t requestMagic = 0x51524353;  // "SCRQ"
+		const uint32_t responseMagic = 0x53524353; // "SCRS"
+
+		// Refuse absurd payloads before allocating for them
+		const uint64_t maxPayloadBytes = 1ull << 30;
+
+		enum RequestType : uint32_t
+		{
+			RequestCarve = 1,
+			RequestStats = 2
+		};
+
+		enum ResponseStatus : uint32_t
+		{
+			StatusOk = 0,
+			StatusError = 1
+		};
+
+		// Both ends live on the same host, so the frames use native byte order
+		struct RequestHeader
+		{
+			uint32_t magic;
+			uint32_t type;
+			uint32_t targetWidth;
+			uint32_t targetHeight;
+			uint32_t outputFormat;
+			uint32_t reserved;
+			uint64_t payloadLength;
+		};
+
+		struct ResponseHeader
+		{
+			uint32_t magic;
+			uint32_t status;
+			uint64_t serverMicros;
+			uint64_t payloadLength;
+		};
+
+		struct StatsPayload
+		{
+			uint64_t requests;
+			uint64_t failures;
+			double totalSeconds;
+			double minSeconds;
+			double maxSeconds;
+		};
+
+		// Read exactly size bytes; returns false on a clean end of stream before the first byte
+		bool readFully(int fd, void *buffer, size_t size)
+		{
+			unsigned char *cursor = static_cast<unsigned char *>(buffer);
+			size_t done = 0;
+			while (done < size)
+			{
+				ssize_t count = ::read(fd, cursor + done, size - done);
+				if (count < 0 && errno == EINTR)
+				{
+					continue;
+				}
+				if (count <= 0)
+				{
+					if (count == 0 && done == 0)
+					{
+						return false;
+					}
+					throw std::runtime_error("Connection closed mid-frame");
+				}
+				done += count;
+			}
+			return true;
+		}
+
+		void writeFully(int fd, const void *buffer, size_t size)
+		{
+			const unsigned char *cursor = static_cast<const unsigned char *>(buffer);
+			size_t done = 0;
+			while (done < size)
+			{
+				ssize_t count = ::send(fd, cursor + done, size - done, MSG_NOSIGNAL);
+				if (count < 0 && errno == EINTR)
+				{
+					continue;
+				}
+				if (count <= 0)
+				{
+					throw std::runtime_error("Error writing to socket");
+				}
+				done += count;
+			}
+		}
+
+		// Frame a response into bytes, which the poll thread writes out as the client takes them
+		std::vector<unsigned char> encodeResponse(uint32_t status, double seconds, const void *payload, size_t payloadLength)
+		{
+			ResponseHeader header = {responseMagic, status, static_cast<uint64_t>(seconds * 1e6), payloadLength};
+			std::vector<unsigned char> frame(sizeof(header) + payloadLength);
+			std::memcpy(frame.data(), &header, sizeof(header));
+			if (payloadLength > 0)
+			{
+				std::memcpy(frame.data() + sizeof(header), payload, payloadLength);
+			}
+			return frame;
+		}
+
+		sockaddr_un socketAddress(const std::string &socketPath)
+		{
+			sockaddr_un address;
+			std::memset(&address, 0, sizeof(address));
+			address.sun_family = AF_UNIX;
+
+			if (socketPath.size() >= sizeof(address.sun_path))
+			{
+				throw std::invalid_argument("Socket path is too long");
+			}
+			std::strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+			return address;
+		}
+	}
+
+	struct Server::Connection
+	{
+		int fd;
+
+		// The frame being read: the header, then its payload
+		RequestHeader header;
+		size_t headerBytes = 0;
+		std::vector<unsigned char> payload;
+		size_t payloadBytes = 0;
+
+		// Set while a worker answers the request, during which the connection is not polled
+		bool busy = false;
+
+		// The framed response and how much of it the client has taken; no request is read until it is all sent
+		std::vector<unsigned char> response;
+		size_t responseBytes = 0;
+
+		explicit Connection(int fd) : fd(fd) {}
+	};
+
+	Server::Server(const std::string &socketPath, unsigned int numThreads, const CarveOptions &carveOptions)
+		: socketPath(socketPath), listenFd(-1), running(false), pool(new ThreadPool(numThreads)), carveOptions(carveOptions), wakeFds{-1, -1} {}
+
+	Server::~Server()
+	{
+		stop();
+	}
+
+	void Server::start()
+	{
+		if (running)
+		{
+			return;
+		}
+
+		sockaddr_un address = socketAddress(socketPath);
+
+		// Only a socket nobody is listening on any more may be replaced
+		struct stat existing;
+		if (::lstat(socketPath.c_str(), &existing) == 0)
+		{
+			if (!S_ISSOCK(existing.st_mode))
+			{
+				throw std::runtime_error(socketPath + " exists and is not a socket");
+			}
+
+			int probeFd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+			if (probeFd < 0)
+			{
+				throw std::runtime_error("Error creating socket");
+			}
+			bool listening = ::connect(probeFd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0;
+			int connectError = errno;
+			::close(probeFd);
+			if (listening)
+			{
+				throw std::runtime_error("Another server is listening on " + socketPath);
+			}
+			if (connectError != ECONNREFUSED)
+			{
+				throw std::runtime_error("Cannot tell whether " + socketPath + " is in use: " + std::strerror(connectError));
+			}
+			::unlink(socketPath.c_str());
+		}
+		else if (errno != ENOENT)
+		{
+			throw std::runtime_error("Cannot inspect " + socketPath + ": " + std::strerror(errno));
+		}
+
+		listenFd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		if (listenFd < 0)
+		{
+			throw std::runtime_error("Error creating socket");
+		}
+
+		if (::bind(listenFd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0)
+		{
+			int bindError = errno;
+			::close(listenFd);
+			listenFd = -1;
+			throw std::runtime_error("Error binding socket " + socketPath + ": " + std::strerror(bindError));
+		}
+
+		// From here on the socket file is ours, so a failure removes it again
+		auto abandon = [this](const char *what)
+		{
+			int error = errno;
+			::close(listenFd);
+			listenFd = -1;
+			::unlink(socketPath.c_str());
+			throw std::runtime_error(what + socketPath + ": " + std::strerror(error));
+		};
+		if (::listen(listenFd, 64) < 0)
+		{
+			abandon("Error listening on ");
+		}
+		if (::pipe2(wakeFds, O_CLOEXEC | O_NONBLOCK) < 0)
+		{
+			abandon("Error creating the wake-up pipe for ");
+		}
+
+		running = true;
+		pollThread = std::thread(&Server::pollLoop, this);
+	}
+
+	void Server::stop()
+	{
+		if (!running.exchange(false))
+		{
+			return;
+		}
+
+		wake();
+		pollThread.join();
+		::close(listenFd);
+		listenFd = -1;
+
+		// Requests already handed to a worker are still answered, as far as the client takes the response
+		// without waiting; partly read requests are dropped
+		pool->wait();
+		for (const auto &connection : connections)
+		{
+			writeResponse(*connection.second);
+			::close(connection.first);
+		}
+		connections.clear();
+		answeredConnections.clear();
+
+		::close(wakeFds[0]);
+		::close(wakeFds[1]);
+		wakeFds[0] = wakeFds[1] = -1;
+
+		::unlink(socketPath.c_str());
+	}
+
+	ServerStats Server::stats() const
+	{
+		std::lock_guard<std::mutex> lock(statsMutex);
+		return serverStats;
+	}
+
+	void Server::recordLatency(double seconds, bool success)
+	{
+		std::lock_guard<std::mutex> lock(statsMutex);
+		if (serverStats.requests == 0 || seconds < serverStats.minSeconds)
+		{
+			serverStats.minSeconds = seconds;
+		}
+		serverStats.maxSeconds = std::max(serverStats.maxSeconds, seconds);
+		serverStats.totalSeconds += seconds;
+		++serverStats.requests;
+		if (!success)
+		{
+			++serverStats.failures;
+		}
+	}
+
+	void Server::wake()
+	{
+		// A full pipe already has a wake-up pending
+		char byte = 0;
+		while (::write(wakeFds[1], &byte, 1) < 0 && errno == EINTR)
+		{
+		}
+	}
+
+	void Server::pollLoop()
+	{
+		std::vector<pollfd> polled;
+		while (running)
+		{
+			polled.clear();
+			polled.push_back({wakeFds[0], POLLIN, 0});
+			polled.push_back({listenFd, POLLIN, 0});
+			for (const auto &connection : connections)
+			{
+				if (!connection.second->busy)
+				{
+					polled.push_back({connection.first, static_cast<short>(connection.second->response.empty() ? POLLIN : POLLOUT), 0});
+				}
+			}
+
+			if (::poll(polled.data(), polled.size(), -1) <= 0)
+			{
+				continue;
+			}
+
+			// Take back the connections whose request has been answered
+			if (polled[0].revents)
+			{
+				char drain[64];
+				while (::read(wakeFds[0], drain, sizeof(drain)) > 0)
+				{
+				}
+
+				std::lock_guard<std::mutex> lock(answeredMutex);
+				for (const std::pair<int, bool> &answered : answeredConnections)
+				{
+					Connection &connection = *connections[answered.first];
+					connection.busy = false;
+
+					// Send what fits now; the rest goes out as the socket becomes writable
+					if (!answered.second || !writeResponse(connection))
+					{
+						::close(answered.first);
+						connections.erase(answered.first);
+					}
+				}
+				answeredConnections.clear();
+			}
+
+			if (polled[1].revents & POLLIN)
+			{
+				int connectionFd = ::accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+				if (connectionFd >= 0)
+				{
+					connections[connectionFd].reset(new Connection(connectionFd));
+				}
+			}
+
+			for (size_t i = 2; i < polled.size(); ++i)
+			{
+				if (!polled[i].revents)
+				{
+					continue;
+				}
+
+				Connection &connection = *connections[polled[i].fd];
+				bool open;
+				try
+				{
+					open = connection.response.empty() ? readRequest(connection) : writeResponse(connection);
+				}
+				catch (const std::exception &)
+				{
+					// A broken connection only affects its own client
+					open = false;
+				}
+
+				if (!open)
+				{
+					::close(connection.fd);
+					connections.erase(polled[i].fd);
+				}
+				else if (connection.busy)
+				{
+					pool->submit([this, &connection]
+								 { answer(connection); });
+				}
+			}
+		}
+	}
+
+	bool Server::readRequest(Connection &connection)
+	{
+		// Read what has arrived without waiting for the rest, which comes with a later poll
+		auto readSome = [&connection](void *buffer, size_t size)
+		{
+			ssize_t count = ::recv(connection.fd, buffer, size, MSG_DONTWAIT);
+			if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+			{
+				return static_cast<ssize_t>(0);
+			}
+			return count <= 0 ? static_cast<ssize_t>(-1) : count;
+		};
+
+		if (connection.headerBytes < sizeof(RequestHeader))
+		{
+			ssize_t count = readSome(reinterpret_cast<unsigned char *>(&connection.header) + connection.headerBytes, sizeof(RequestHeader) - connection.headerBytes);
+			if (count < 0)
+			{
+				// A clean close between frames, or one mid-frame; either way the connection is done
+				return false;
+			}
+			connection.headerBytes += count;
+			if (connection.headerBytes < sizeof(RequestHeader))
+			{
+				return true;
+			}
+
+			if (connection.header.magic != requestMagic || connection.header.payloadLength > maxPayloadBytes)
+			{
+				throw std::runtime_error("Malformed request");
+			}
+			connection.payload.resize(connection.header.payloadLength);
+			connection.payloadBytes = 0;
+		}
+
+		if (connection.payloadBytes < connection.payload.size())
+		{
+			ssize_t count = readSome(connection.payload.data() + connection.payloadBytes, connection.payload.size() - connection.payloadBytes);
+			if (count < 0)
+			{
+				return false;
+			}
+			connection.payloadBytes += count;
+		}
+
+		connection.busy = connection.payloadBytes == connection.payload.size();
+		return true;
+	}
+
+	bool Server::writeResponse(Connection &connection)
+	{
+		while (connection.responseBytes < connection.response.size())
+		{
+			ssize_t count = ::send(connection.fd, connection.response.data() + connection.responseBytes,
+								   connection.response.size() - connection.responseBytes, MSG_NOSIGNAL | MSG_DONTWAIT);
+			if (count < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			{
+				// The client is not reading yet; poll for room instead of holding anything
+				return true;
+			}
+			if (count <= 0)
+			{
+				return false;
+			}
+			connection.responseBytes += count;
+		}
+
+		std::vector<unsigned char>().swap(connection.response);
+		connection.responseBytes = 0;
+		return true;
+	}
+
+	void Server::answer(Connection &connection)
+	{
+		// The poll thread leaves the connection alone until it is handed back below
+		RequestHeader header = connection.header;
+		CarveRequest request;
+		request.imageBytes.swap(connection.payload);
+		connection.headerBytes = 0;
+		connection.payloadBytes = 0;
+
+		bool keepOpen = true;
+		try
+		{
+			if (header.type == RequestStats)
+			{
+				ServerStats snapshot = stats();
+				StatsPayload payload = {snapshot.requests, snapshot.failures, snapshot.totalSeconds, snapshot.minSeconds, snapshot.maxSeconds};
+				connection.response = encodeResponse(StatusOk, 0.0, &payload, sizeof(payload));
+			}
+			else
+			{
+				request.targetWidth = header.targetWidth;
+				request.targetHeight = header.targetHeight;
+				request.outputFormat = static_cast<ImageFormat>(header.outputFormat);
+
+				CarveResponse response = header.type == RequestCarve
+											 ? process(request, carveOptions)
+											 : CarveResponse{false, "Unknown request type", {}, 0.0};
+				recordLatency(response.serverSeconds, response.success);
+
+				if (response.success)
+				{
+					connection.response = encodeResponse(StatusOk, response.serverSeconds, response.imageBytes.data(), response.imageBytes.size());
+				}
+				else
+				{
+					connection.response = encodeResponse(StatusError, response.serverSeconds, response.error.data(), response.error.size());
+				}
+			}
+		}
+		catch (...)
+		{
+			// The response could not be framed; the connection is simply closed
+			keepOpen = false;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(answeredMutex);
+			answeredConnections.emplace_back(connection.fd, keepOpen);
+		}
+		wake();
+	}
+
+	CarveResponse Server::process(const CarveRequest &request, const CarveOptions &carveOptions)
+	{
+		using Clock = std::chrono::steady_clock;
+		Clock::time_point started = Clock::now();
+
+		CarveResponse response;
+		try
+		{
+			Image image;
+			image.loadFromMemory(request.imageBytes.data(), request.imageBytes.size());
+
+			ImageData &imageData = image.getRawImageData();
+			unsigned int targetWidth = request.targetWidth ? request.targetWidth : imageData.getWidth();
+			unsigned int targetHeight = request.targetHeight ? request.targetHeight : imageData.getHeight();
+			Carver::carveTo(imageData, targetWidth, targetHeight, carveOptions);
+
+			response.imageBytes = image.writeToMemory(request.outputFormat);
+			response.success = true;
+		}
+		catch (const std::exception &e)
+		{
+			response.error = e.what();
+		}
+
+		response.serverSeconds = std::chrono::duration<double>(Clock::now() - started).count();
+		return response;
+	}
+
+	Client::Client(const std::string &socketPath)
+	{
+		sockaddr_un address = socketAddress(socketPath);
+
+		connectionFd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		if (connectionFd < 0)
+		{
+			throw std::runtime_error("Error creating socket");
+		}
+
+		if (::connect(connectionFd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0)
+		{
+			::close(connectionFd);
+			throw std::runtime_error("Error connecting to " + socketPath);
+		}
+	}
+
+	Client::~Client()
+	{
+		::close(connectionFd);
+	}
+
+	CarveResponse Client::carve(const CarveRequest &request)
+	{
+		RequestHeader header = {requestMagic, RequestCarve, request.targetWidth, request.targetHeight,
+								static_cast<uint32_t>(request.outputFormat), 0, request.imageBytes.size()};
+		writeFully(connectionFd, &header, sizeof(header));
+		writeFully(connectionFd, request.imageBytes.data(), request.imageBytes.size());
+
+		ResponseHeader responseHeader;
+		if (!readFully(connectionFd, &responseHeader, sizeof(responseHeader)) || responseHeader.magic != responseMagic)
+		{
+			throw std::runtime_error("Malformed response");
+		}
+
+		std::vector<unsigned char> payload(responseHeader.payloadLength);
+		if (!payload.empty() && !readFully(connectionFd, payload.data(), payload.size()))
+		{
+			throw std::runtime_error("Malformed response");
+		}
+
+		CarveResponse response;
+		response.success = responseHeader.status == StatusOk;
+		response.serverSeconds = responseHeader.serverMicros / 1e6;
+		if (response.success)
+		{
+			response.imageBytes = std::move(payload);
+		}
+		else
+		{
+			response.error.assign(payload.begin(), payload.end());
+		}
+		return response;
+	}
+
+	ServerStats Client::stats()
+	{
+		RequestHeader header = {requestMagic, RequestStats, 0, 0, 0, 0, 0};
+		writeFully(connectionFd, &header, sizeof(header));
+
+		ResponseHeader responseHeader;
+		StatsPayload payload;
+		if (!readFully(connectionFd, &responseHeader, sizeof(responseHeader)) || responseHeader.magic != responseMagic ||
+			responseHeader.payloadLength != sizeof(payload) || !readFully(connectionFd, &payload, sizeof(payload)))
+		{
+			throw std::runtime_error("Malformed response");
+		}
+
+		ServerStats snapshot;
+		snapshot.requests = payload.requests;
+		snapshot.failures = payload.failures;
+		snapshot.totalSeconds = payload.totalSeconds;
+		snapshot.minSeconds = payload.minSeconds;
+		snapshot.maxSeconds = payload.maxSeconds;
+		return snapshot;
+	}
+}
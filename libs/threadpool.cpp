@@ -0,0 +1,125 @@
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include <ThreadPool.h>
+
+namespace StronkImage
+{
+	ThreadPool::ThreadPool(unsigned int numThreads)
+		: outstanding(0), stopping(false)
+	{
+		if (numThreads == 0)
+		{
+			numThreads = std::max(1u, std::thread::hardware_concurrency());
+		}
+		if (numThreads > maxThreads)
+		{
+			throw std::invalid_argument("A thread pool takes at most " + std::to_string(maxThreads) + " threads");
+		}
+
+		// Joinable threads must not be destroyed, so undo a partial start before rethrowing
+		workers.reserve(numThreads);
+		try
+		{
+			for (unsigned int i = 0; i < numThreads; ++i)
+			{
+				workers.emplace_back(&ThreadPool::workerLoop, this);
+			}
+		}
+		catch (...)
+		{
+			stop();
+			throw;
+		}
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		stop();
+	}
+
+	void ThreadPool::stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		taskAvailable.notify_all();
+
+		for (std::thread &worker : workers)
+		{
+			worker.join();
+		}
+	}
+
+	void ThreadPool::submit(std::function<void()> task)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			tasks.push_back(std::move(task));
+			++outstanding;
+		}
+		taskAvailable.notify_one();
+	}
+
+	void ThreadPool::wait()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		allIdle.wait(lock, [this]
+					 { return outstanding == 0; });
+
+		if (firstError)
+		{
+			std::exception_ptr error = firstError;
+			firstError = nullptr;
+			std::rethrow_exception(error);
+		}
+	}
+
+	void ThreadPool::workerLoop()
+	{
+		for (;;)
+		{
+			std::function<void()> task;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				taskAvailable.wait(lock, [this]
+								   { return stopping || !tasks.empty(); });
+
+				// Drain the queue before honouring a stop request
+				if (tasks.empty())
+				{
+					return;
+				}
+
+				task = std::move(tasks.front());
+				tasks.pop_front();
+			}
+
+			// An escaped exception is a failed job; keep the first for wait() rather than kill the worker
+			std::exception_ptr error;
+			try
+			{
+				task();
+			}
+			catch (...)
+			{
+				error = std::current_exception();
+			}
+
+			// The task's captures are released before it counts as finished
+			task = nullptr;
+
+			std::lock_guard<std::mutex> lock(mutex);
+			if (error && !firstError)
+			{
+				firstError = error;
+			}
+			if (--outstanding == 0)
+			{
+				allIdle.notify_all();
+			}
+		}
+	}
+}
@@ -0,0 +1,561 @@
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <CarveControl.h>
+#include <Filter.h>
+#include <Profiler.h>
+#include <TiledImage.h>
+
+namespace StronkImage
+{
+	namespace
+	{
+		std::runtime_error systemError(const std::string &what)
+		{
+			return std::runtime_error(what + ": " + std::strerror(errno));
+		}
+
+		// Number of rows of the given pitch that fit in a band of bandBytes, at least one
+		unsigned int rowsPerBand(size_t pitch, size_t bandBytes)
+		{
+			return static_cast<unsigned int>(std::max<size_t>(1, bandBytes / std::max<size_t>(pitch, 1)));
+		}
+
+		// Sink that copies decoded rows into a freshly mapped colour image
+		class TiledImageSink : public ScanlineSink
+		{
+		private:
+			TiledImage &image;
+			const std::string &scratchDirectory;
+			size_t bandBytes;
+			unsigned int bandRows;
+
+		public:
+			TiledImageSink(TiledImage &image, const std::string &scratchDirectory, size_t bandBytes)
+				: image(image), scratchDirectory(scratchDirectory), bandBytes(bandBytes), bandRows(1) {}
+
+			void start(unsigned int width, unsigned int height) override
+			{
+				image = TiledImage(width, height, 4, scratchDirectory);
+				bandRows = rowsPerBand(image.pitch(), bandBytes);
+			}
+
+			void writeRow(unsigned int y, const uint8_t *rgba) override
+			{
+				std::memcpy(image.row(y), rgba, static_cast<size_t>(image.width) * 4);
+				if ((y + 1) % bandRows == 0)
+				{
+					image.evict(y + 1 - bandRows, y + 1);
+				}
+			}
+		};
+
+		// Source that hands the rows of a colour or single-channel image to an encoder
+		class TiledImageSource : public ScanlineSource
+		{
+		private:
+			const TiledImage &image;
+			unsigned int bandRows;
+
+		public:
+			TiledImageSource(const TiledImage &image, size_t bandBytes)
+				: image(image), bandRows(rowsPerBand(image.pitch(), bandBytes)) {}
+
+			unsigned int width() const override { return image.width; }
+
+			unsigned int height() const override { return image.height; }
+
+			void readRow(unsigned int y, uint8_t *rgba) override
+			{
+				const uint8_t *source = image.row(y);
+				if (image.channels == 4)
+				{
+					std::memcpy(rgba, source, static_cast<size_t>(image.width) * 4);
+				}
+				else
+				{
+					for (unsigned int x = 0; x < image.width; ++x)
+					{
+						rgba[x * 4 + 0] = rgba[x * 4 + 1] = rgba[x * 4 + 2] = source[x * image.channels];
+						rgba[x * 4 + 3] = 255;
+					}
+				}
+
+				if ((y + 1) % bandRows == 0)
+				{
+					image.evict(y + 1 - bandRows, y + 1);
+				}
+			}
+		};
+	}
+
+	TiledImage::TiledImage()
+		: fd(-1), mapping(nullptr), mappedBytes(0), rowPitch(0), width(0), height(0), channels(0) {}
+
+	TiledImage::TiledImage(unsigned int width, unsigned int height, unsigned int channels, const std::string &scratchDirectory)
+		: fd(-1), mapping(nullptr), mappedBytes(0), rowPitch(static_cast<size_t>(width) * channels), width(width), height(height), channels(channels)
+	{
+		if (width == 0 || height == 0 || channels == 0)
+		{
+			throw std::invalid_argument("Invalid dimensions for the image");
+		}
+
+		std::string directory = scratchDirectory;
+		if (directory.empty())
+		{
+			const char *temporary = std::getenv("TMPDIR");
+			directory = temporary && *temporary ? temporary : "/tmp";
+		}
+
+		std::string pathTemplate = directory + "/stronkimage-XXXXXX";
+		fd = mkstemp(&pathTemplate[0]);
+		if (fd < 0)
+		{
+			throw systemError("Error creating scratch file in " + directory);
+		}
+
+		// Nothing else needs the name, and unlinking now means the space is freed even if we crash
+		unlink(pathTemplate.c_str());
+
+		mappedBytes = rowPitch * height;
+		if (ftruncate(fd, static_cast<off_t>(mappedBytes)) != 0)
+		{
+			int error = errno;
+			close(fd);
+			errno = error;
+			throw systemError("Error sizing scratch file");
+		}
+
+		void *address = mmap(nullptr, mappedBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (address == MAP_FAILED)
+		{
+			int error = errno;
+			close(fd);
+			errno = error;
+			throw systemError("Error mapping scratch file");
+		}
+		mapping = static_cast<uint8_t *>(address);
+	}
+
+	TiledImage::TiledImage(TiledImage &&other) noexcept
+		: fd(other.fd), mapping(other.mapping), mappedBytes(other.mappedBytes), rowPitch(other.rowPitch),
+		  width(other.width), height(other.height), channels(other.channels)
+	{
+		other.fd = -1;
+		other.mapping = nullptr;
+		other.mappedBytes = 0;
+		other.width = 0;
+		other.height = 0;
+	}
+
+	TiledImage &TiledImage::operator=(TiledImage &&other) noexcept
+	{
+		if (this != &other)
+		{
+			unmap();
+
+			fd = other.fd;
+			mapping = other.mapping;
+			mappedBytes = other.mappedBytes;
+			rowPitch = other.rowPitch;
+			width = other.width;
+			height = other.height;
+			channels = other.channels;
+
+			other.fd = -1;
+			other.mapping = nullptr;
+			other.mappedBytes = 0;
+			other.width = 0;
+			other.height = 0;
+		}
+		return *this;
+	}
+
+	TiledImage::~TiledImage()
+	{
+		unmap();
+	}
+
+	void TiledImage::unmap()
+	{
+		if (mapping)
+		{
+			munmap(mapping, mappedBytes);
+			mapping = nullptr;
+		}
+		if (fd >= 0)
+		{
+			close(fd);
+			fd = -1;
+		}
+	}
+
+	void TiledImage::evict(unsigned int rowBegin, unsigned int rowEnd) const
+	{
+		if (!mapping || rowBegin >= rowEnd)
+		{
+			return;
+		}
+
+		// Only whole pages inside the range are dropped, so neighbouring rows are never affected
+		size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+		size_t begin = (rowBegin * rowPitch + pageSize - 1) / pageSize * pageSize;
+		size_t end = std::min(static_cast<size_t>(rowEnd), static_cast<size_t>(height)) * rowPitch / pageSize * pageSize;
+		if (begin < end)
+		{
+			// Shared file pages keep their contents, so this only shrinks the resident set
+			madvise(mapping + begin, end - begin, MADV_DONTNEED);
+		}
+	}
+
+	void TiledImage::removeSeam(const std::vector<int> &seam, unsigned int bandRows)
+	{
+		if (width < 2 || seam.size() != height)
+		{
+			throw std::invalid_argument("Seam does not match the image");
+		}
+
+		// Check the whole seam first, so a bad entry leaves the image untouched rather than half shifted
+		for (int seamX : seam)
+		{
+			if (seamX < 0 || static_cast<unsigned int>(seamX) >= width)
+			{
+				throw std::out_of_range("Invalid pixel position");
+			}
+		}
+
+		for (unsigned int y = 0; y < height; ++y)
+		{
+			unsigned int seamX = static_cast<unsigned int>(seam[y]);
+			uint8_t *pixels = row(y);
+			std::memmove(pixels + seamX * channels, pixels + (seamX + 1) * channels, (width - seamX - 1) * channels);
+
+			if (bandRows && (y + 1) % bandRows == 0)
+			{
+				evict(y + 1 - bandRows, y + 1);
+			}
+		}
+
+		--width;
+	}
+
+	TiledImage TiledImage::load(const std::string &imageSpec, const std::string &scratchDirectory, size_t bandBytes)
+	{
+		TiledImage image;
+		TiledImageSink sink(image, scratchDirectory, bandBytes);
+		Image::decodeScanlines(imageSpec, sink);
+		return image;
+	}
+
+	void TiledImage::write(const std::string &imageSpec, size_t bandBytes) const
+	{
+		TiledImageSource source(*this, bandBytes);
+		Image::encodeScanlines(imageSpec, source);
+	}
+
+	TiledImage TiledImage::fromImageData(const ImageData &imageData, const std::string &scratchDirectory)
+	{
+		TiledImage image(imageData.width, imageData.height, 4, scratchDirectory);
+		for (unsigned int y = 0; y < image.height; ++y)
+		{
+			const RGBPixelBuf *pixels = imageData.rgbPixelData + static_cast<size_t>(y) * imageData.width;
+			uint8_t *rgba = image.row(y);
+			for (unsigned int x = 0; x < image.width; ++x)
+			{
+				rgba[x * 4 + 0] = static_cast<uint8_t>(pixels[x].red);
+				rgba[x * 4 + 1] = static_cast<uint8_t>(pixels[x].green);
+				rgba[x * 4 + 2] = static_cast<uint8_t>(pixels[x].blue);
+				rgba[x * 4 + 3] = static_cast<uint8_t>(pixels[x].opacity);
+			}
+		}
+		return image;
+	}
+
+	ImageData TiledImage::toImageData() const
+	{
+		ImageData imageData(width, height);
+		for (unsigned int y = 0; y < height; ++y)
+		{
+			const uint8_t *source = row(y);
+			RGBPixelBuf *pixels = imageData.rgbPixelData + static_cast<size_t>(y) * width;
+			for (unsigned int x = 0; x < width; ++x)
+			{
+				const uint8_t *pixel = source + x * channels;
+				pixels[x] = channels == 4 ? RGBPixelBuf{pixel[0], pixel[1], pixel[2], pixel[3]} : RGBPixelBuf{pixel[0], pixel[0], pixel[0], 255};
+			}
+		}
+		return imageData;
+	}
+
+	TiledImage TiledCarver::generateEnergyMap(const TiledImage &colourImage, const TiledCarveOptions &options)
+	{
+		STRONK_PROFILE_SCOPE("energy");
+		reportCarveStage(CarveStage::Energy);
+
+		const int width = colourImage.width;
+		const int height = colourImage.height;
+		TiledImage energyMap(width, height, 1, options.scratchDirectory);
+
+		// The 2D Gaussian of Filter::gaussianBlur is the product of this normalised 1D kernel with itself
+		std::vector<float> weights(1, 1.0f);
+		if (options.blurSigma != 0.0f)
+		{
+			int kernelSize = static_cast<int>(std::ceil(6 * options.blurSigma)) | 1;
+			int centre = kernelSize / 2;
+			weights.resize(kernelSize);
+			float sum = 0.0f;
+			for (int i = 0; i < kernelSize; ++i)
+			{
+				weights[i] = std::exp(-((i - centre) * (i - centre)) / (2 * options.blurSigma * options.blurSigma));
+				sum += weights[i];
+			}
+			for (float &weight : weights)
+			{
+				weight /= sum;
+			}
+		}
+		const int kernelSize = static_cast<int>(weights.size());
+		const int centre = kernelSize / 2;
+
+		// Horizontally blurred luminance rows for the vertical window, slot = source row % kernelSize
+		std::vector<float> blurredRows(static_cast<size_t>(kernelSize) * width);
+		std::vector<float> lumaRow(width);
+		std::vector<int> blurredRowIndex(kernelSize, -1);
+
+		// Grayscale rows for the Sobel window, slot = row % 3
+		std::vector<uint8_t> grayRows(static_cast<size_t>(3) * width);
+
+		const unsigned int colourBand = rowsPerBand(colourImage.pitch(), options.bandBytes);
+		const unsigned int energyBand = rowsPerBand(energyMap.pitch(), options.bandBytes);
+
+		auto blurRow = [&](int sourceY)
+		{
+			// Luminance first, as Pipeline plans it, so only one channel is blurred
+			const uint8_t *rgba = colourImage.row(sourceY);
+			for (int x = 0; x < width; ++x)
+			{
+				lumaRow[x] = luma(rgba[x * 4], rgba[x * 4 + 1], rgba[x * 4 + 2]);
+			}
+
+			float *output = &blurredRows[static_cast<size_t>(sourceY % kernelSize) * width];
+			for (int x = 0; x < width; ++x)
+			{
+				float sum = 0.0f;
+				for (int i = 0; i < kernelSize; ++i)
+				{
+					sum += lumaRow[std::clamp(x + i - centre, 0, width - 1)] * weights[i];
+				}
+				output[x] = sum;
+			}
+			blurredRowIndex[sourceY % kernelSize] = sourceY;
+
+			if ((sourceY + 1) % colourBand == 0)
+			{
+				colourImage.evict(sourceY + 1 - colourBand, sourceY + 1);
+			}
+		};
+
+		auto sobelRow = [&](int y)
+		{
+			const uint8_t *rows[3] = {
+				&grayRows[static_cast<size_t>(std::max(y - 1, 0) % 3) * width],
+				&grayRows[static_cast<size_t>(y % 3) * width],
+				&grayRows[static_cast<size_t>(std::min(y + 1, height - 1) % 3) * width]};
+			uint8_t *output = energyMap.row(y);
+
+			for (int x = 0; x < width; ++x)
+			{
+				int columns[3] = {std::max(x - 1, 0), x, std::min(x + 1, width - 1)};
+
+				int sumX = detail::applyKernel<Kernels::SobelX>(rows, columns, std::make_integer_sequence<int, 9>());
+				int sumY = detail::applyKernel<Kernels::SobelY>(rows, columns, std::make_integer_sequence<int, 9>());
+
+				// Same clamping as the in-memory path: each gradient to [0, 255], then the magnitude
+				int sobelX = std::min(std::max(sumX, 0), 255);
+				int sobelY = std::min(std::max(sumY, 0), 255);
+				output[x] = static_cast<uint8_t>(std::min(static_cast<int>(std::sqrt(sobelX * sobelX + sobelY * sobelY)), 255));
+			}
+
+			if ((y + 1) % energyBand == 0)
+			{
+				energyMap.evict(y + 1 - energyBand, y + 1);
+			}
+		};
+
+		for (int y = 0; y < height; ++y)
+		{
+			carveCheckpoint(y);
+
+			// Bring the window of horizontally blurred rows up to date
+			for (int j = -centre; j <= centre; ++j)
+			{
+				int sourceY = std::clamp(y + j, 0, height - 1);
+				if (blurredRowIndex[sourceY % kernelSize] != sourceY)
+				{
+					blurRow(sourceY);
+				}
+			}
+
+			// Vertical pass, truncated like gaussianBlur
+			uint8_t *gray = &grayRows[static_cast<size_t>(y % 3) * width];
+			for (int x = 0; x < width; ++x)
+			{
+				float sum = 0.0f;
+				for (int j = 0; j < kernelSize; ++j)
+				{
+					sum += blurredRows[static_cast<size_t>(std::clamp(y + j - centre, 0, height - 1) % kernelSize) * width + x] * weights[j];
+				}
+				gray[x] = static_cast<uint8_t>(std::min(sum, 255.0f));
+			}
+
+			// Row y completes the Sobel window of the row above it
+			if (y > 0)
+			{
+				sobelRow(y - 1);
+			}
+		}
+		sobelRow(height - 1);
+
+		return energyMap;
+	}
+
+	std::vector<int> TiledCarver::findVerticalSeam(const TiledImage &energyMap, TiledImage &directions, unsigned int bandRows)
+	{
+		const int width = energyMap.width;
+		const int height = energyMap.height;
+
+		if (width < 3)
+		{
+			throw std::invalid_argument("Image is too narrow to remove another seam");
+		}
+		if (directions.pitch() < static_cast<size_t>(width + 3) / 4 || directions.height < energyMap.height)
+		{
+			throw std::invalid_argument("Backpointer scratch image is too small");
+		}
+
+		// Only two rows of path costs are ever resident; the parents go to the scratch image
+		std::vector<uint32_t> previousCost(width, 0);
+		std::vector<uint32_t> currentCost(width);
+		bandRows = std::max(bandRows, 1u);
+
+		{
+			STRONK_PROFILE_SCOPE("dp");
+
+			for (int y = 1; y < height - 1; ++y)
+			{
+				carveCheckpoint(y);
+				const uint8_t *energyRow = energyMap.row(y);
+				uint8_t *directionRow = directions.row(y);
+				uint8_t packed = 0;
+
+				for (int x = 1; x < width - 1; ++x)
+				{
+					// Ties prefer straight up, then left, as in Filter::findVerticalSeam
+					uint32_t best = previousCost[x];
+					uint8_t direction = 0;
+
+					if (x > 1 && previousCost[x - 1] < best)
+					{
+						best = previousCost[x - 1];
+						direction = 1;
+					}
+
+					if (x < width - 2 && previousCost[x + 1] < best)
+					{
+						best = previousCost[x + 1];
+						direction = 2;
+					}
+
+					currentCost[x] = energyRow[x] + best;
+
+					packed |= direction << ((x & 3) * 2);
+					if ((x & 3) == 3)
+					{
+						directionRow[x >> 2] = packed;
+						packed = 0;
+					}
+				}
+				if (((width - 2) & 3) != 3)
+				{
+					directionRow[(width - 2) >> 2] = packed;
+				}
+
+				std::swap(previousCost, currentCost);
+
+				if ((y + 1) % bandRows == 0)
+				{
+					energyMap.evict(y + 1 - bandRows, y + 1);
+				}
+			}
+		}
+
+		STRONK_PROFILE_SCOPE("traceback");
+
+		int minIdx = 1;
+		for (int x = 2; x < width - 1; ++x)
+		{
+			if (previousCost[x] < previousCost[minIdx])
+			{
+				minIdx = x;
+			}
+		}
+
+		std::vector<int> seam(height, minIdx);
+		for (int y = height - 2; y > 1; --y)
+		{
+			uint8_t direction = (directions.row(y)[seam[y] >> 2] >> ((seam[y] & 3) * 2)) & 3;
+			seam[y - 1] = seam[y] + (direction == 1 ? -1 : direction == 2 ? 1 : 0);
+		}
+		if (height > 1)
+		{
+			seam[0] = seam[1];
+		}
+
+		return seam;
+	}
+
+	void TiledCarver::carve(TiledImage &colourImage, int numSeams, const TiledCarveOptions &options)
+	{
+		if (numSeams <= 0)
+		{
+			return;
+		}
+
+		TiledImage energyMap = generateEnergyMap(colourImage, options);
+		TiledImage directions((colourImage.width + 3) / 4, colourImage.height, 1, options.scratchDirectory);
+
+		STRONK_PROFILE_SCOPE("seams");
+		reportCarveStage(CarveStage::Seams);
+
+		for (int seamCount = 0; seamCount < numSeams; ++seamCount)
+		{
+			reportCarveSeams(seamCount, numSeams);
+			carveCheckpoint();
+			std::vector<int> seam = findVerticalSeam(energyMap, directions, rowsPerBand(energyMap.pitch(), options.bandBytes));
+
+			STRONK_PROFILE_SCOPE("compaction");
+
+			colourImage.removeSeam(seam, rowsPerBand(colourImage.pitch(), options.bandBytes));
+			energyMap.removeSeam(seam, rowsPerBand(energyMap.pitch(), options.bandBytes));
+		}
+		reportCarveSeams(numSeams, numSeams);
+	}
+
+	void TiledCarver::carveFile(const std::string &inputPath, const std::string &outputPath, int numSeams, const TiledCarveOptions &options)
+	{
+		// Refuse an output name that cannot be written before spending the carve on it
+		Image::formatForWriting(outputPath);
+
+		TiledImage colourImage = TiledImage::load(inputPath, options.scratchDirectory, options.bandBytes);
+		carve(colourImage, numSeams, options);
+		colourImage.write(outputPath, options.bandBytes);
+	}
+}
@@ -1,37 +1,351 @@
 #include <iostream>
 #include <string>
+#include <filesystem>
+#include <csignal>
+#include <fstream>
+#include <iterator>
+#include <cctype>
+#include <limits>
+#include <memory>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 #include "StronkImage.h"
 
 using namespace StronkImage;
 
-void stripImage(const std::string& inputImagePath, const std::string& outputImagePath, int numSeams)
+// Parse a count that must be at least 1, such as --threads N; std::stoul alone would turn "-1" into UINT_MAX
+unsigned int parsePositiveCount(const std::string& flag, const std::string& value)
 {
-    // Load the input image
-    Image inputImage(inputImagePath);
-    Image transposeImage(inputImage);
-    
-    Filter::gaussianBlur(transposeImage.getRawImageData());
+    size_t parsed = 0;
+    unsigned long count = 0;
+    if (!value.empty() && std::isdigit(static_cast<unsigned char>(value[0])))
+    {
+        count = std::stoul(value, &parsed);
+    }
+    if (parsed == 0 || parsed != value.size() || count == 0 || count > std::numeric_limits<unsigned int>::max())
+    {
+        throw std::invalid_argument(flag + " expects a positive whole number, got " + value);
+    }
+    return static_cast<unsigned int>(count);
+}
+
+void writeEncoded(const std::string& path, const std::vector<unsigned char>& encoded)
+{
+    std::ofstream file(path, std::ios::binary);
+    if (!file.write(reinterpret_cast<const char*>(encoded.data()), encoded.size()))
+    {
+        throw std::runtime_error("Error writing " + path);
+    }
+}
+
+void stripImage(const std::string& inputImagePath, const std::string& outputImagePath, int numSeams, const CarveOptions& options, ResultCache* cache,
+                unsigned int downscale = 1)
+{
+    STRONK_PROFILE_SCOPE("total");
+
+    // Load the input image; with a cache the encoded bytes are kept, since they are part of the keys
+    Image inputImage;
+    Image energyImage;
+    bool energyReady = false;
+    uint64_t energyKey = 0;
+    uint64_t outputKey = 0;
+    ImageFormat outputFormat = Image::formatForWriting(outputImagePath);
+    if (cache)
+    {
+        std::ifstream inputFile(inputImagePath, std::ios::binary);
+        std::vector<unsigned char> inputBytes((std::istreambuf_iterator<char>(inputFile)), std::istreambuf_iterator<char>());
+        if (!inputFile && !inputFile.eof())
+        {
+            throw std::runtime_error("Error reading " + inputImagePath);
+        }
+
+        energyKey = ResultCache::energyKey(inputBytes.data(), inputBytes.size(), options);
+        outputKey = ResultCache::outputKey(energyKey, numSeams, options, outputFormat);
 
-    // Generate a grayscale version of the image
-    // ImageData grayscaleImage = inputImage.getRawImageData();
-    Filter::genGrayscaleData(transposeImage.getRawImageData());
+        // The same image, parameters and format were carved before, so reuse the encoded result as is
+        std::vector<unsigned char> encoded;
+        if (cache->loadOutput(outputKey, encoded))
+        {
+            writeEncoded(outputImagePath, encoded);
+            return;
+        }
 
-    // Generate an energy map of the grayscale image
-    transposeImage.setRawImageData(Filter::generateEnergyMap(transposeImage.getRawImageData()));
-    transposeImage.writeToFile("energyMap.jpg");
+        inputImage.loadFromMemory(inputBytes.data(), inputBytes.size());
+    }
+    else if (downscale > 1)
+    {
+        // Admitted under a memory budget at a reduced size, so the full-size image is never decoded
+        inputImage.getRawImageData() = MemoryBudget::loadDownscaled(inputImagePath, downscale);
+    }
+    else
+    {
+        // A second thread computes the energy map from the rows the decoder has already produced
+        energyImage.getRawImageData() = Carver::loadWithEnergyMap(inputImagePath, inputImage.getRawImageData(), options);
+        energyReady = true;
+    }
+
+    // The time budget covers the carve itself, not decoding and encoding
+    auto deadline = Carver::deadline(options);
+
+    // Generate an energy map of the blurred grayscale image, or reuse the one cached for this input
+    if (!energyReady && (!cache || !cache->loadEnergy(energyKey, energyImage.getRawImageData())))
+    {
+        energyImage.getRawImageData() = Carver::generateEnergyMap(inputImage.getRawImageData(), options);
+        if (cache)
+        {
+            cache->storeEnergy(energyKey, energyImage.getRawImageData());
+        }
+    }
+    energyImage.writeToFile("energyMap.jpg");
 
     // Remove the specified number of seams from the input image
-    Filter::removeSeams(inputImage.getRawImageData(), transposeImage.getRawImageData(), numSeams);
+    CarveResult result = Carver::removeSeams(inputImage.getRawImageData(), energyImage.getRawImageData(), numSeams, options, deadline);
+    if (result.resampledSeams > 0)
+    {
+        std::cout << "Time budget reached after " << result.exactSeams << " exact seams; resampled the remaining "
+                  << result.resampledSeams << " columns" << std::endl;
+    }
+
+    // Save the modified image to the output path; results cut short by the time budget are not cached
+    if (cache && outputFormat != ImageFormat::Unknown)
+    {
+        std::vector<unsigned char> encoded = inputImage.writeToMemory(outputFormat);
+        writeEncoded(outputImagePath, encoded);
+        if (result.resampledSeams == 0)
+        {
+            cache->storeOutput(outputKey, encoded);
+        }
+    }
+    else
+    {
+        inputImage.writeToFile(outputImagePath);
+    }
+}
+
+// Prints the progress of a carve to stderr from a separate thread, reading the control's atomic counters
+class ProgressMonitor
+{
+private:
+    const CarveControl& control;
+    std::mutex mutex;
+    std::condition_variable stopped;
+    bool stopping = false;
+    std::thread thread;
 
-    // Save the modified image to the output path
-    inputImage.writeToFile(outputImagePath);
+    void print()
+    {
+        CarveProgress progress = control.progress();
+        std::cerr << "\r" << carveStageName(progress.stage) << ": " << progress.seamsDone << "/" << progress.seamsTotal << " seams   " << std::flush;
+    }
+
+public:
+    explicit ProgressMonitor(const CarveControl& control) : control(control)
+    {
+        thread = std::thread([this]
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (!stopped.wait_for(lock, std::chrono::milliseconds(200), [this] { return stopping; }))
+            {
+                print();
+            }
+        });
+    }
+
+    ~ProgressMonitor()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        stopped.notify_all();
+        thread.join();
+        print();
+        std::cerr << std::endl;
+    }
+};
+
+void printBufferPoolStats()
+{
+    BufferPoolStats stats = BufferPool::global().stats();
+    std::cout << "Buffer pool: " << stats.hits << " hits, " << stats.misses << " misses, peak "
+              << stats.peakBytesInUse / (1024 * 1024) << " MiB in use" << std::endl;
 }
 
-int main(int argc, char* argv[])
+int runBatch(int argc, char* argv[])
+{
+    std::vector<std::string> positional;
+    BatchOptions options;
+
+    for (int i = 2; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc)
+        {
+            options.numThreads = parsePositiveCount(arg, argv[++i]);
+        }
+        else if (arg == "--in-flight" && i + 1 < argc)
+        {
+            options.maxInFlight = parsePositiveCount(arg, argv[++i]);
+        }
+        else
+        {
+            positional.push_back(arg);
+        }
+    }
+
+    std::vector<BatchJob> jobs;
+    if (positional.size() == 1 && !std::filesystem::is_directory(positional[0]))
+    {
+        jobs = Batch::readManifest(positional[0]);
+    }
+    else if (positional.size() == 3)
+    {
+        jobs = Batch::jobsFromDirectory(positional[0], positional[1], std::stoi(positional[2]));
+    }
+    else
+    {
+        std::cerr << "Usage: " << argv[0] << " --batch <manifest> [--threads N] [--in-flight N]" << std::endl;
+        std::cerr << "       " << argv[0] << " --batch <inputDir> <outputDir> <numSeams> [--threads N] [--in-flight N]" << std::endl;
+        return 1;
+    }
+
+    std::vector<BatchResult> results = Batch::run(jobs, options);
+
+    int failures = 0;
+    for (const BatchResult& result : results)
+    {
+        if (result.success)
+        {
+            std::cout << "OK    " << result.job.inputPath << " -> " << result.job.outputPath << " (" << result.seconds << "s)" << std::endl;
+        }
+        else
+        {
+            ++failures;
+            std::cerr << "FAIL  " << result.job.inputPath << ": " << result.error << std::endl;
+        }
+    }
+
+    std::cout << "Processed " << results.size() - failures << " of " << results.size() << " images" << std::endl;
+    printBufferPoolStats();
+
+    return failures == 0 ? 0 : 1;
+}
+
+int runSequence(int argc, char* argv[])
+{
+    std::vector<std::string> positional;
+    SequenceOptions options;
+    int firstFrame = 1;
+
+    for (int i = 2; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--start" && i + 1 < argc)
+        {
+            firstFrame = std::stoi(argv[++i]);
+        }
+        else if (arg == "--band" && i + 1 < argc)
+        {
+            options.bandRadius = std::stoi(argv[++i]);
+        }
+        else if (arg == "--keyframe" && i + 1 < argc)
+        {
+            options.keyframeInterval = std::stoi(argv[++i]);
+        }
+        else
+        {
+            positional.push_back(arg);
+        }
+    }
+
+    if (positional.size() != 4)
+    {
+        std::cerr << "Usage: " << argv[0] << " --sequence <inputPattern> <outputPattern> <numFrames> <numSeams> [--start N] [--band R] [--keyframe K]" << std::endl;
+        return 1;
+    }
+
+    SequenceStats stats = SequenceCarver::run(positional[0], positional[1], firstFrame, std::stoi(positional[2]), std::stoi(positional[3]), options);
+
+    std::cout << "Carved " << stats.frames << " frames (" << stats.keyframes << " keyframes, " << stats.reusedFrames
+              << " repeated) in " << stats.seconds << "s" << std::endl;
+    printBufferPoolStats();
+
+    return 0;
+}
+
+int runServer(int argc, char* argv[])
+{
+    if (argc < 3)
+    {
+        std::cerr << "Usage: " << argv[0] << " --serve <socketPath> [--threads N] [--budget MS]" << std::endl;
+        return 1;
+    }
+
+    unsigned int numThreads = 0;
+    CarveOptions carveOptions;
+    for (int i = 3; i < argc; ++i)
+    {
+        if (std::string(argv[i]) == "--threads" && i + 1 < argc)
+        {
+            numThreads = parsePositiveCount(argv[i], argv[i + 1]);
+            ++i;
+        }
+        else if (std::string(argv[i]) == "--budget" && i + 1 < argc)
+        {
+            carveOptions.timeBudgetSeconds = std::stod(argv[++i]) / 1000.0;
+        }
+    }
+
+    // Block the shutdown signals before any thread starts so only sigwait sees them
+    sigset_t shutdownSignals;
+    sigemptyset(&shutdownSignals);
+    sigaddset(&shutdownSignals, SIGINT);
+    sigaddset(&shutdownSignals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &shutdownSignals, nullptr);
+
+    Server server(argv[2], numThreads, carveOptions);
+    server.start();
+    std::cout << "Listening on " << argv[2] << std::endl;
+
+    int signal = 0;
+    sigwait(&shutdownSignals, &signal);
+    server.stop();
+
+    ServerStats stats = server.stats();
+    std::cout << "Served " << stats.requests << " requests (" << stats.failures << " failed), latency mean "
+              << stats.meanSeconds() << "s min " << stats.minSeconds << "s max " << stats.maxSeconds << "s" << std::endl;
+    printBufferPoolStats();
+
+    return 0;
+}
+
+int run(int argc, char* argv[])
 {
-    if (argc != 4)
+    std::string mode = argc >= 2 ? argv[1] : "";
+    if (mode == "--batch" || mode == "--serve" || mode == "--sequence")
     {
-        std::cerr << "Usage: " << argv[0] << " <inputImagePath> <outputImagePath> <numSeams>" << std::endl;
+        try
+        {
+            if (mode == "--sequence")
+            {
+                return runSequence(argc, argv);
+            }
+            return mode == "--batch" ? runBatch(argc, argv) : runServer(argc, argv);
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    if (argc < 4)
+    {
+        std::cerr << "Usage: " << argv[0] << " [--profile[=json]] [--counters] <inputImagePath> <outputImagePath> <numSeams> [--columns B:E] [--mask maskImage] [--sigma S] [--blur exact|box] [--seam-mode exact|greedy|strips [--strips N]] [--budget MS] [--cache dir [--cache-size MB]] [--progress] [--tiled [--scratch dir]] [--memory-budget MB [--over-budget reject|downscale|tiled]]" << std::endl;
+        std::cerr << "       " << argv[0] << " --batch <manifest | inputDir outputDir numSeams> [--threads N] [--in-flight N]" << std::endl;
+        std::cerr << "       " << argv[0] << " --sequence <inputPattern> <outputPattern> <numFrames> <numSeams> [--start N] [--band R] [--keyframe K]" << std::endl;
+        std::cerr << "       " << argv[0] << " --serve <socketPath> [--threads N] [--budget MS]" << std::endl;
         return 1;
     }
 
@@ -41,7 +355,168 @@ int main(int argc, char* argv[])
 
     try
     {
-        stripImage(inputImagePath, outputImagePath, numSeams);
+        // Optional seam region, blur settings and the out-of-core path
+        CarveOptions options;
+        SeamRegion& region = options.region;
+        GrayImageData mask;
+        bool tiled = false;
+        TiledCarveOptions tiledOptions;
+        bool showProgress = false;
+        std::string cacheDirectory;
+        uint64_t cacheBytes = ResultCache::defaultMaxBytes;
+        uint64_t memoryBudgetBytes = 0;
+        OverBudgetPolicy overBudget = OverBudgetPolicy::Reject;
+        for (int i = 4; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            if (arg == "--columns" && i + 1 < argc)
+            {
+                std::string range = argv[++i];
+                size_t colon = range.find(':');
+                if (colon == std::string::npos)
+                {
+                    throw std::invalid_argument("--columns expects B:E");
+                }
+                region.columnBegin = std::stoul(range.substr(0, colon));
+                region.columnEnd = std::stoul(range.substr(colon + 1));
+            }
+            else if (arg == "--mask" && i + 1 < argc)
+            {
+                Image maskImage(argv[++i]);
+                mask = Filter::genGrayscale(maskImage.getRawImageData());
+                region.mask = &mask;
+            }
+            else if (arg == "--sigma" && i + 1 < argc)
+            {
+                options.blurSigma = std::stof(argv[++i]);
+                tiledOptions.blurSigma = options.blurSigma;
+            }
+            else if (arg == "--blur" && i + 1 < argc)
+            {
+                std::string mode = argv[++i];
+                if (mode != "exact" && mode != "box")
+                {
+                    throw std::invalid_argument("--blur expects exact or box");
+                }
+                options.blurMode = mode == "box" ? BlurMode::Box : BlurMode::Exact;
+            }
+            else if (arg == "--budget" && i + 1 < argc)
+            {
+                options.timeBudgetSeconds = std::stod(argv[++i]) / 1000.0;
+            }
+            else if (arg == "--seam-mode" && i + 1 < argc)
+            {
+                std::string mode = argv[++i];
+                if (mode != "exact" && mode != "greedy" && mode != "strips")
+                {
+                    throw std::invalid_argument("--seam-mode expects exact, greedy or strips");
+                }
+                region.seamMode = mode == "greedy" ? SeamMode::Greedy : mode == "strips" ? SeamMode::Strips : SeamMode::Exact;
+            }
+            else if (arg == "--strips" && i + 1 < argc)
+            {
+                region.numStrips = static_cast<unsigned int>(std::stoul(argv[++i]));
+            }
+            else if (arg == "--cache" && i + 1 < argc)
+            {
+                cacheDirectory = argv[++i];
+            }
+            else if (arg == "--cache-size" && i + 1 < argc)
+            {
+                cacheBytes = std::stoull(argv[++i]) << 20;
+            }
+            else if (arg == "--progress")
+            {
+                showProgress = true;
+            }
+            else if (arg == "--tiled")
+            {
+                tiled = true;
+            }
+            else if (arg == "--scratch" && i + 1 < argc)
+            {
+                tiledOptions.scratchDirectory = argv[++i];
+            }
+            else if (arg == "--memory-budget" && i + 1 < argc)
+            {
+                memoryBudgetBytes = std::stoull(argv[++i]) << 20;
+            }
+            else if (arg == "--over-budget" && i + 1 < argc)
+            {
+                std::string policy = argv[++i];
+                if (policy != "reject" && policy != "downscale" && policy != "tiled")
+                {
+                    throw std::invalid_argument("--over-budget expects reject, downscale or tiled");
+                }
+                overBudget = policy == "downscale" ? OverBudgetPolicy::Downscale : policy == "tiled" ? OverBudgetPolicy::Tiled : OverBudgetPolicy::Reject;
+            }
+            else
+            {
+                throw std::invalid_argument("Unknown option " + arg);
+            }
+        }
+
+        // Size the job from the input's header before anything is decoded, and fit it to the memory budget
+        unsigned int downscale = 1;
+        if (memoryBudgetBytes)
+        {
+            if (tiled)
+            {
+                throw std::invalid_argument("--memory-budget picks the strategy itself; use --over-budget tiled instead of --tiled");
+            }
+
+            ImageInfo info = Image::probe(inputImagePath);
+            MemoryBudget budget(memoryBudgetBytes, overBudget);
+            AdmissionDecision decision = budget.admit(info, numSeams, options, Image::formatForWriting(outputImagePath), tiledOptions);
+            if (decision.strategy == CarveStrategy::Downscaled)
+            {
+                std::cout << "Over the memory budget at full size; carving " << decision.numSeams << " seams at 1/" << decision.downscale
+                          << " scale (estimated " << (decision.estimatedBytes >> 20) << " MiB)" << std::endl;
+                downscale = decision.downscale;
+                numSeams = decision.numSeams;
+                options = decision.options;
+            }
+            else if (decision.strategy == CarveStrategy::Tiled)
+            {
+                std::cout << "Over the memory budget in memory; carving out of core with " << (decision.tiledOptions.bandBytes >> 20)
+                          << " MiB bands (estimated " << (decision.estimatedBytes >> 20) << " MiB)" << std::endl;
+                tiled = true;
+                tiledOptions = decision.tiledOptions;
+            }
+        }
+
+        CarveControl control;
+        CarveControlScope controlScope(control);
+        std::unique_ptr<ProgressMonitor> monitor;
+        if (showProgress)
+        {
+            monitor.reset(new ProgressMonitor(control));
+        }
+
+        if (tiled)
+        {
+            // Out-of-core path for images too large for memory; it has no region support yet, always runs the
+            // exact blur and seam search, and cannot stop early
+            if (region.mask || region.columnBegin || region.columnEnd)
+            {
+                throw std::invalid_argument("--tiled cannot be combined with --columns or --mask");
+            }
+            if (options.blurMode != BlurMode::Exact || region.seamMode != SeamMode::Exact || region.numStrips || options.timeBudgetSeconds > 0.0)
+            {
+                throw std::invalid_argument("--tiled cannot be combined with --blur box, --seam-mode, --strips or --budget");
+            }
+            TiledCarver::carveFile(inputImagePath, outputImagePath, numSeams, tiledOptions);
+        }
+        else
+        {
+            std::unique_ptr<ResultCache> cache;
+            if (!cacheDirectory.empty())
+            {
+                cache.reset(new ResultCache(cacheDirectory, cacheBytes));
+            }
+            // The cache is keyed on the full-size input, so a downscaled carve bypasses it
+            stripImage(inputImagePath, outputImagePath, numSeams, options, downscale > 1 ? nullptr : cache.get(), downscale);
+        }
     }
     catch (const std::exception& e)
     {
@@ -53,3 +528,51 @@ int main(int argc, char* argv[])
 
     return 0;
 }
+
+int main(int argc, char* argv[])
+{
+    // Strip --profile[=text|json] and --counters from anywhere on the command line before dispatching
+    std::string profileFormat;
+    bool counters = false;
+    int remaining = 0;
+    for (int i = 0; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--profile" || arg == "--profile=text" || arg == "--profile=json")
+        {
+            profileFormat = arg == "--profile=json" ? "json" : "text";
+            continue;
+        }
+        if (arg == "--counters")
+        {
+            counters = true;
+            continue;
+        }
+        argv[remaining++] = argv[i];
+    }
+
+    // Counters are reported with the stage timings, so they turn on the text report unless JSON was asked for
+    if (counters && profileFormat.empty())
+    {
+        profileFormat = "text";
+    }
+
+    Profiler::setEnabled(!profileFormat.empty());
+    if (counters)
+    {
+        Profiler::enableCounters(true);
+    }
+
+    int status = run(remaining, argv);
+
+    if (profileFormat == "json")
+    {
+        std::cerr << Profiler::toJson() << std::endl;
+    }
+    else if (profileFormat == "text")
+    {
+        std::cerr << Profiler::summary();
+    }
+
+    return status;
+}
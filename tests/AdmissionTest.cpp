@@ -0,0 +1,141 @@
+#include <StronkImage.h>
+#include <gtest/gtest.h>
+
+#include "TestImages.h"
+
+using namespace StronkImage;
+using TestImages::noisyImage;
+
+TEST(AdmissionTest, ProbeReadsOnlyTheHeader)
+{
+    Image image(noisyImage(23, 11, 1));
+    for (ImageFormat format : {ImageFormat::Jpeg, ImageFormat::Png, ImageFormat::Pam, ImageFormat::Ppm, ImageFormat::Raw})
+    {
+        std::vector<unsigned char> encoded = image.writeToMemory(format);
+        ImageInfo info = Image::probe(encoded.data(), encoded.size());
+        EXPECT_EQ(format, info.format);
+        EXPECT_EQ(23u, info.width);
+        EXPECT_EQ(11u, info.height);
+    }
+
+    // The pixels do not have to be present, only the header
+    std::vector<unsigned char> pam = image.writeToMemory(ImageFormat::Pam);
+    ImageInfo truncated = Image::probe(pam.data(), pam.size() - 100);
+    EXPECT_EQ(23u, truncated.width);
+
+    image.writeToFile("test_images/probe.png");
+    ImageInfo fromFile = Image::probe("test_images/probe.png");
+    EXPECT_EQ(ImageFormat::Png, fromFile.format);
+    EXPECT_EQ(11u, fromFile.height);
+
+    const unsigned char garbage[] = "not an image at all";
+    EXPECT_THROW(Image::probe(garbage, sizeof(garbage)), std::runtime_error);
+}
+
+TEST(AdmissionTest, EstimateFollowsTheBuffersOfEachStage)
+{
+    CarveOptions options;
+    uint64_t estimate = MemoryBudget::estimateInMemory(1000, 800, options, ImageFormat::Jpeg);
+
+    // At least the colour image and the energy map, and not wildly more
+    EXPECT_GE(estimate, 2u * 1000 * 800 * sizeof(RGBPixelBuf));
+    EXPECT_LE(estimate, 3u * 1000 * 800 * sizeof(RGBPixelBuf));
+
+    // Raw output is written from the pixels, while PNG needs a buffer of up to the raw size
+    EXPECT_LT(MemoryBudget::estimateInMemory(1000, 800, options, ImageFormat::Raw), MemoryBudget::estimateInMemory(1000, 800, options, ImageFormat::Png));
+
+    GrayImageData mask(1000, 800);
+    options.region.mask = &mask;
+    EXPECT_GT(MemoryBudget::estimateInMemory(1000, 800, options, ImageFormat::Jpeg), estimate);
+
+    // The tiled resident set depends on the bands, not on the height
+    TiledCarveOptions tiledOptions;
+    tiledOptions.bandBytes = size_t(1) << 20;
+    uint64_t tiled = MemoryBudget::estimateTiled(100000, 1000, tiledOptions);
+    EXPECT_LT(tiled, MemoryBudget::estimateInMemory(100000, 1000, CarveOptions(), ImageFormat::Jpeg) / 100);
+    EXPECT_LT(MemoryBudget::estimateTiled(100000, 100000, tiledOptions) - tiled, 1000000u);
+}
+
+TEST(AdmissionTest, PoliciesFitTheJobToTheBudget)
+{
+    ImageInfo input;
+    input.width = 4000;
+    input.height = 3000;
+    input.format = ImageFormat::Jpeg;
+    CarveOptions options;
+    uint64_t fullSize = MemoryBudget::estimateInMemory(4000, 3000, options, ImageFormat::Jpeg);
+
+    AdmissionDecision fits = MemoryBudget(fullSize).admit(input, 100, options, ImageFormat::Jpeg);
+    EXPECT_EQ(CarveStrategy::InMemory, fits.strategy);
+    EXPECT_EQ(100, fits.numSeams);
+
+    const uint64_t budget = fullSize / 5;
+    EXPECT_THROW(MemoryBudget(budget).admit(input, 100, options, ImageFormat::Jpeg), MemoryBudgetExceeded);
+
+    // The smallest factor that fits, with the seams and columns scaled with the image
+    options.region.columnBegin = 1000;
+    options.region.columnEnd = 3001;
+    AdmissionDecision downscaled = MemoryBudget(budget, OverBudgetPolicy::Downscale).admit(input, 100, options, ImageFormat::Jpeg);
+    EXPECT_EQ(CarveStrategy::Downscaled, downscaled.strategy);
+    EXPECT_EQ(3u, downscaled.downscale);
+    EXPECT_LE(downscaled.estimatedBytes, budget);
+    EXPECT_GT(MemoryBudget::estimateInMemory(2000, 1500, options, ImageFormat::Jpeg), budget);
+    EXPECT_EQ(33, downscaled.numSeams);
+    EXPECT_EQ(333u, downscaled.options.region.columnBegin);
+    EXPECT_EQ(1001u, downscaled.options.region.columnEnd);
+
+    // The tiled path has no regions, so columns rule it out
+    EXPECT_THROW(MemoryBudget(budget, OverBudgetPolicy::Tiled).admit(input, 100, options, ImageFormat::Jpeg), MemoryBudgetExceeded);
+    options.region = SeamRegion();
+
+    AdmissionDecision tiled = MemoryBudget(size_t(100) << 20, OverBudgetPolicy::Tiled).admit(input, 100, options, ImageFormat::Jpeg);
+    EXPECT_EQ(CarveStrategy::Tiled, tiled.strategy);
+    EXPECT_LE(tiled.estimatedBytes, size_t(100) << 20);
+    EXPECT_EQ(size_t(32) << 20, tiled.tiledOptions.bandBytes);
+    EXPECT_THROW(MemoryBudget(100000, OverBudgetPolicy::Tiled).admit(input, 100, options, ImageFormat::Jpeg), MemoryBudgetExceeded);
+
+    // Nor does it have the box blur, the other seam searches or a time budget
+    for (int variant = 0; variant < 4; ++variant)
+    {
+        CarveOptions unsupported;
+        unsupported.blurMode = variant == 0 ? BlurMode::Box : BlurMode::Exact;
+        unsupported.region.seamMode = variant == 1 ? SeamMode::Greedy : SeamMode::Exact;
+        unsupported.region.numStrips = variant == 2 ? 4 : 0;
+        unsupported.timeBudgetSeconds = variant == 3 ? 0.05 : 0.0;
+        EXPECT_THROW(MemoryBudget(size_t(100) << 20, OverBudgetPolicy::Tiled).admit(input, 100, unsupported, ImageFormat::Jpeg), MemoryBudgetExceeded)
+            << "variant " << variant;
+    }
+
+    // A mask has the full size, so it cannot follow the image down
+    GrayImageData mask(4000, 3000);
+    options.region.mask = &mask;
+    EXPECT_THROW(MemoryBudget(budget, OverBudgetPolicy::Downscale).admit(input, 100, options, ImageFormat::Jpeg), MemoryBudgetExceeded);
+}
+
+TEST(AdmissionTest, DownscaledLoadAveragesBlocks)
+{
+    ImageData image = noisyImage(7, 5, 2);
+    Image(image).writeToFile("test_images/downscale.pam");
+
+    ImageData downscaled = MemoryBudget::loadDownscaled("test_images/downscale.pam", 2);
+    ASSERT_EQ(4u, downscaled.getWidth());
+    ASSERT_EQ(3u, downscaled.getHeight());
+
+    // A full block: columns 2-3 and rows 2-3, rounded to nearest
+    RGBPixelBuf sum = {0, 0, 0, 0};
+    for (int y = 2; y < 4; ++y)
+    {
+        for (int x = 2; x < 4; ++x)
+        {
+            RGBPixelBuf pixel = image.getPixel(x, y);
+            sum = {sum.red + pixel.red, sum.green + pixel.green, sum.blue + pixel.blue, sum.opacity + pixel.opacity};
+        }
+    }
+    EXPECT_EQ((RGBPixelBuf{(sum.red + 2) / 4, (sum.green + 2) / 4, (sum.blue + 2) / 4, 255}), downscaled.getPixel(1, 1));
+
+    // The corner block holds only the pixel at (6, 4)
+    EXPECT_EQ(image.getPixel(6, 4), downscaled.getPixel(3, 2));
+
+    ImageData fullSize = MemoryBudget::loadDownscaled("test_images/downscale.pam", 1);
+    EXPECT_EQ(image.getPixel(3, 2), fullSize.getPixel(3, 2));
+}
@@ -0,0 +1,143 @@
+#include <StronkImage.h>
+#include <gtest/gtest.h>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+
+#include "TestImages.h"
+
+using namespace StronkImage;
+using TestImages::gradientImage;
+
+TEST(ThreadPoolTest, RunsNestedTasks)
+{
+    ThreadPool pool(3);
+    std::atomic<int> counter(0);
+
+    for (int i = 0; i < 10; ++i)
+    {
+        pool.submit([&pool, &counter]
+                    {
+            ++counter;
+            pool.submit([&counter] { ++counter; }); });
+    }
+
+    pool.wait();
+
+    EXPECT_EQ(20, counter.load());
+}
+
+TEST(ThreadPoolTest, WaitRethrowsEscapedErrors)
+{
+    ThreadPool pool(2);
+    std::atomic<int> counter(0);
+
+    pool.submit([] { throw std::runtime_error("lost job"); });
+    for (int i = 0; i < 5; ++i)
+    {
+        pool.submit([&counter] { ++counter; });
+    }
+
+    // The other tasks still run, and the error is reported once
+    EXPECT_THROW(pool.wait(), std::runtime_error);
+    EXPECT_EQ(5, counter.load());
+    EXPECT_NO_THROW(pool.wait());
+}
+
+TEST(ThreadPoolTest, RefusesAbsurdSizes)
+{
+    const unsigned int limit = ThreadPool::maxThreads;
+    EXPECT_THROW(ThreadPool(limit + 1), std::invalid_argument);
+    EXPECT_THROW(ThreadPool(static_cast<unsigned int>(-1)), std::invalid_argument);
+    EXPECT_EQ(limit, ThreadPool(limit).size());
+}
+
+TEST(BatchTest, ReadManifest)
+{
+    std::string manifestPath = "test_images/batch_manifest.txt";
+    {
+        std::ofstream manifest(manifestPath);
+        manifest << "# input output seams\n";
+        manifest << "a.png out/a.png 5\n";
+        manifest << "\n";
+        manifest << "b.jpg out/b.jpg 10\n";
+    }
+
+    std::vector<BatchJob> jobs = Batch::readManifest(manifestPath);
+
+    ASSERT_EQ(2, jobs.size());
+    EXPECT_EQ("a.png", jobs[0].inputPath);
+    EXPECT_EQ("out/a.png", jobs[0].outputPath);
+    EXPECT_EQ(5, jobs[0].numSeams);
+    EXPECT_EQ("b.jpg", jobs[1].inputPath);
+    EXPECT_EQ(10, jobs[1].numSeams);
+}
+
+TEST(BatchTest, ReadManifestMalformedLine)
+{
+    std::string manifestPath = "test_images/batch_manifest_bad.txt";
+    {
+        std::ofstream manifest(manifestPath);
+        manifest << "a.png out/a.png\n";
+    }
+
+    EXPECT_THROW(Batch::readManifest(manifestPath), std::runtime_error);
+}
+
+TEST(BatchTest, RunDirectoryWithLimitedInFlight)
+{
+    std::string inputDir = "test_images/batch_in";
+    std::string outputDir = "test_images/batch_out";
+    std::filesystem::create_directories(inputDir);
+
+    for (int i = 0; i < 5; ++i)
+    {
+        Image(gradientImage(40 + i, 30)).writeToFile(inputDir + "/image" + std::to_string(i) + ".png");
+    }
+
+    std::vector<BatchJob> jobs = Batch::jobsFromDirectory(inputDir, outputDir, 4);
+    ASSERT_EQ(5, jobs.size());
+
+    BatchOptions options;
+    options.numThreads = 2;
+    options.maxInFlight = 2;
+
+    std::vector<BatchResult> results = Batch::run(jobs, options);
+
+    ASSERT_EQ(5, results.size());
+    for (int i = 0; i < 5; ++i)
+    {
+        ASSERT_TRUE(results[i].success) << results[i].error;
+
+        Image output(results[i].job.outputPath);
+        EXPECT_EQ(40 + i - 4, output.getRawImageData().getWidth());
+        EXPECT_EQ(30, output.getRawImageData().getHeight());
+    }
+}
+
+TEST(BatchTest, DirectoryWritesGrayInputsAsPpm)
+{
+    std::string inputDir = "test_images/batch_gray_in";
+    std::filesystem::create_directories(inputDir);
+    std::ofstream(inputDir + "/gray.pgm", std::ios::binary) << "P5\n3 1\n255\n" << std::string("\x10\x80\xf0", 3);
+
+    std::vector<BatchJob> jobs = Batch::jobsFromDirectory(inputDir, "test_images/batch_gray_out", 1);
+    ASSERT_EQ(1, jobs.size());
+    EXPECT_EQ(".ppm", std::filesystem::path(jobs[0].outputPath).extension());
+}
+
+TEST(BatchTest, RunReportsFailuresWithoutAborting)
+{
+    Image(gradientImage(20, 20)).writeToFile("test_images/batch_ok.png");
+
+    std::vector<BatchJob> jobs = {
+        {"test_images/does_not_exist.png", "test_images/batch_missing_out.png", 2},
+        {"test_images/batch_ok.png", "test_images/batch_ok_out.png", 2}};
+
+    std::vector<BatchResult> results = Batch::run(jobs);
+
+    ASSERT_EQ(2, results.size());
+    EXPECT_FALSE(results[0].success);
+    EXPECT_FALSE(results[0].error.empty());
+    EXPECT_TRUE(results[1].success) << results[1].error;
+}
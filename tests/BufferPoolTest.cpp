@@ -0,0 +1,77 @@
+#include <StronkImage.h>
+#include <gtest/gtest.h>
+
+using namespace StronkImage;
+
+TEST(BufferPoolTest, SizeClassesBoundSlack)
+{
+    EXPECT_EQ(4096, BufferPool::sizeClass(1));
+    EXPECT_EQ(4096, BufferPool::sizeClass(4096));
+    EXPECT_EQ(5120, BufferPool::sizeClass(4097));
+    EXPECT_EQ(8192, BufferPool::sizeClass(8192));
+
+    for (size_t bytes = 4096; bytes < (size_t(1) << 24); bytes = bytes * 3 / 2 + 7)
+    {
+        size_t classBytes = BufferPool::sizeClass(bytes);
+        EXPECT_GE(classBytes, bytes);
+        EXPECT_LE(classBytes, bytes + bytes / 4);
+    }
+}
+
+TEST(BufferPoolTest, ReusesReleasedBuffers)
+{
+    BufferPool pool;
+
+    void *first = pool.acquire(100000);
+    pool.release(first, 100000);
+
+    // A slightly smaller request falls in the same class and gets the same buffer back
+    void *second = pool.acquire(99000);
+    EXPECT_EQ(first, second);
+
+    BufferPoolStats stats = pool.stats();
+    EXPECT_EQ(1, stats.hits);
+    EXPECT_EQ(1, stats.misses);
+    EXPECT_EQ(BufferPool::sizeClass(100000), stats.bytesInUse);
+    EXPECT_EQ(0, stats.bytesCached);
+
+    pool.release(second, 99000);
+    EXPECT_EQ(0, pool.stats().bytesInUse);
+}
+
+TEST(BufferPoolTest, TracksPeakAndRespectsCacheLimit)
+{
+    BufferPool pool(8192);
+
+    void *a = pool.acquire(4096);
+    void *b = pool.acquire(8192);
+    EXPECT_EQ(4096 + 8192, pool.stats().peakBytesInUse);
+
+    pool.release(b, 8192);
+    pool.release(a, 4096);
+
+    // Only the first release fits under the cache limit
+    BufferPoolStats stats = pool.stats();
+    EXPECT_EQ(8192, stats.bytesCached);
+    EXPECT_EQ(0, stats.bytesInUse);
+    EXPECT_EQ(4096 + 8192, stats.peakBytesInUse);
+
+    pool.trim();
+    EXPECT_EQ(0, pool.stats().bytesCached);
+}
+
+TEST(BufferPoolTest, ImageDataRecyclesBuffers)
+{
+    {
+        ImageData warmUp(300, 200);
+    }
+    uint64_t missesBefore = BufferPool::global().stats().misses;
+
+    for (int i = 0; i < 10; ++i)
+    {
+        ImageData image(300, 200, {1, 2, 3, 255});
+        EXPECT_EQ(RGBPixelBuf({1, 2, 3, 255}), image.getPixel(299, 199));
+    }
+
+    EXPECT_EQ(missesBefore, BufferPool::global().stats().misses);
+}
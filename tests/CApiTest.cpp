@@ -0,0 +1,154 @@
+#include <StronkImage.h>
+#include <StronkImageC.h>
+#include <gtest/gtest.h>
+
+#include "TestImages.h"
+
+using namespace StronkImage;
+using TestImages::noisyImage;
+
+namespace
+{
+    std::vector<unsigned char> encodedPng(const ImageData &imageData)
+    {
+        return Image(imageData).writeToMemory(ImageFormat::Png);
+    }
+
+    stronk_job makeJob(const unsigned char *input, size_t inputSize, unsigned int width, unsigned int height, stronk_format format)
+    {
+        stronk_job job = {};
+        job.input = input;
+        job.input_size = inputSize;
+        job.target_width = width;
+        job.target_height = height;
+        job.format = format;
+        return job;
+    }
+
+    uint64_t decodedHash(const unsigned char *data, size_t size)
+    {
+        Image image;
+        image.loadFromMemory(data, size);
+        return hashPixels(image.getRawImageData());
+    }
+}
+
+TEST(CApiTest, MatchesCarverThroughImageHandles)
+{
+    ImageData source = noisyImage(48, 40, 7);
+    std::vector<unsigned char> png = encodedPng(source);
+
+    stronk_context *context = nullptr;
+    ASSERT_EQ(STRONK_OK, stronk_context_create(nullptr, &context));
+
+    stronk_image *image = nullptr;
+    ASSERT_EQ(STRONK_OK, stronk_image_load(context, png.data(), png.size(), &image));
+    unsigned int width = 0, height = 0;
+    ASSERT_EQ(STRONK_OK, stronk_image_size(image, &width, &height));
+    EXPECT_EQ(48u, width);
+    EXPECT_EQ(40u, height);
+
+    ASSERT_EQ(STRONK_OK, stronk_image_carve(context, image, 40, 36));
+    ASSERT_EQ(STRONK_OK, stronk_image_size(image, &width, &height));
+    EXPECT_EQ(40u, width);
+    EXPECT_EQ(36u, height);
+
+    // The source was a PNG, so the default format is lossless and the pixels can be compared exactly
+    unsigned char *output = nullptr;
+    size_t outputSize = 0;
+    ASSERT_EQ(STRONK_OK, stronk_image_encode(context, image, STRONK_FORMAT_SOURCE, &output, &outputSize));
+    EXPECT_EQ(ImageFormat::Png, Image::formatFromSignature(output, outputSize));
+
+    ImageData expected(source);
+    Carver::carveTo(expected, 40, 36);
+    EXPECT_EQ(hashPixels(expected), decodedHash(output, outputSize));
+
+    stronk_buffer_free(output);
+    stronk_image_free(image);
+    stronk_context_destroy(context);
+}
+
+TEST(CApiTest, CarveManyReportsEachJob)
+{
+    stronk_options options;
+    stronk_options_init(&options);
+    options.num_threads = 2;
+    stronk_context *context = nullptr;
+    ASSERT_EQ(STRONK_OK, stronk_context_create(&options, &context));
+
+    std::vector<unsigned char> first = encodedPng(noisyImage(30, 20, 1));
+    std::vector<unsigned char> second = encodedPng(noisyImage(25, 25, 2));
+    const unsigned char garbage[] = {1, 2, 3, 4, 5, 6, 7, 8};
+
+    stronk_job jobs[3] = {makeJob(first.data(), first.size(), 24, 0, STRONK_FORMAT_JPEG),
+                          makeJob(second.data(), second.size(), 0, 20, STRONK_FORMAT_PNG),
+                          makeJob(garbage, sizeof(garbage), 10, 10, STRONK_FORMAT_PNG)};
+
+    EXPECT_NE(STRONK_OK, stronk_carve_many(context, jobs, 3));
+    EXPECT_STRNE("", stronk_last_error());
+
+    ASSERT_EQ(STRONK_OK, jobs[0].status);
+    EXPECT_EQ(ImageFormat::Jpeg, Image::formatFromSignature(jobs[0].output, jobs[0].output_size));
+    ASSERT_EQ(STRONK_OK, jobs[1].status);
+    ImageData expected = noisyImage(25, 25, 2);
+    Carver::carveTo(expected, 25, 20);
+    EXPECT_EQ(hashPixels(expected), decodedHash(jobs[1].output, jobs[1].output_size));
+
+    EXPECT_EQ(STRONK_ERROR_DECODE, jobs[2].status);
+    EXPECT_EQ(nullptr, jobs[2].output);
+
+    for (stronk_job &job : jobs)
+    {
+        stronk_buffer_free(job.output);
+    }
+    stronk_context_destroy(context);
+}
+
+TEST(CApiTest, ReportsInvalidArguments)
+{
+    EXPECT_EQ(STRONK_API_VERSION, stronk_api_version());
+    EXPECT_EQ(STRONK_ERROR_INVALID_ARGUMENT, stronk_context_create(nullptr, nullptr));
+    EXPECT_STRNE("", stronk_last_error());
+
+    stronk_context *context = nullptr;
+    ASSERT_EQ(STRONK_OK, stronk_context_create(nullptr, &context));
+    EXPECT_STREQ("", stronk_last_error());
+
+    std::vector<unsigned char> png = encodedPng(noisyImage(16, 16, 3));
+    unsigned char *output = nullptr;
+    size_t outputSize = 0;
+    EXPECT_EQ(STRONK_ERROR_INVALID_ARGUMENT, stronk_carve_buffer(context, png.data(), png.size(), 32, 16, STRONK_FORMAT_PNG, &output, &outputSize));
+    EXPECT_EQ(nullptr, output);
+    EXPECT_EQ(STRONK_OK, stronk_carve_buffer(context, png.data(), png.size(), 12, 0, STRONK_FORMAT_PNG, &output, &outputSize));
+    EXPECT_NE(nullptr, output);
+
+    stronk_buffer_free(output);
+    stronk_context_destroy(context);
+}
+
+TEST(CApiTest, OptionsCarryTheirSize)
+{
+    stronk_options options;
+    stronk_options_init(&options);
+    EXPECT_EQ(sizeof(stronk_options), options.struct_size);
+
+    stronk_context *context = nullptr;
+    ASSERT_EQ(STRONK_OK, stronk_context_create(&options, &context));
+    stronk_context_destroy(context);
+
+    // A struct that was never initialised is refused rather than read
+    stronk_options unset = {};
+    EXPECT_EQ(STRONK_ERROR_INVALID_ARGUMENT, stronk_context_create(&unset, &context));
+
+    // A caller built against a later header passes a longer struct; the fields it adds are ignored
+    struct
+    {
+        stronk_options known;
+        int addedLater;
+    } newer;
+    stronk_options_init(&newer.known);
+    newer.known.struct_size = sizeof(newer);
+    newer.addedLater = 42;
+    ASSERT_EQ(STRONK_OK, stronk_context_create(&newer.known, &context));
+    stronk_context_destroy(context);
+}
@@ -0,0 +1,110 @@
+#include <StronkImage.h>
+#include <gtest/gtest.h>
+#include <filesystem>
+
+using namespace StronkImage;
+
+namespace
+{
+    std::string freshDirectory(const std::string &name)
+    {
+        std::string directory = "test_images/" + name;
+        std::filesystem::remove_all(directory);
+        return directory;
+    }
+
+    size_t entryCount(const std::string &directory)
+    {
+        size_t count = 0;
+        for (const auto &entry : std::filesystem::directory_iterator(directory))
+        {
+            count += entry.is_regular_file();
+        }
+        return count;
+    }
+}
+
+TEST(CacheTest, KeysTrackInputAndParameters)
+{
+    const unsigned char input[] = {1, 2, 3, 4};
+    const unsigned char otherInput[] = {1, 2, 3, 5};
+    CarveOptions options;
+
+    uint64_t energyKey = ResultCache::energyKey(input, sizeof(input), options);
+    EXPECT_EQ(energyKey, ResultCache::energyKey(input, sizeof(input), options));
+    EXPECT_NE(energyKey, ResultCache::energyKey(otherInput, sizeof(otherInput), options));
+
+    CarveOptions blurred;
+    blurred.blurSigma = 2.0f;
+    EXPECT_NE(energyKey, ResultCache::energyKey(input, sizeof(input), blurred));
+
+    // The seam count, format and region only change the output key
+    uint64_t outputKey = ResultCache::outputKey(energyKey, 10, options, ImageFormat::Png);
+    EXPECT_NE(outputKey, ResultCache::outputKey(energyKey, 11, options, ImageFormat::Png));
+    EXPECT_NE(outputKey, ResultCache::outputKey(energyKey, 10, options, ImageFormat::Jpeg));
+
+    GrayImageData mask(4, 4);
+    std::fill(mask.pixels, mask.pixels + 16, 255);
+    CarveOptions masked;
+    masked.region.mask = &mask;
+    uint64_t maskedKey = ResultCache::outputKey(energyKey, 10, masked, ImageFormat::Png);
+    EXPECT_NE(outputKey, maskedKey);
+    mask.pixels[5] = 0;
+    EXPECT_NE(maskedKey, ResultCache::outputKey(energyKey, 10, masked, ImageFormat::Png));
+}
+
+TEST(CacheTest, StoresEnergyAndOutputs)
+{
+    ResultCache cache(freshDirectory("cache_entries"));
+
+    ImageData energyMap(5, 3);
+    for (unsigned int i = 0; i < 15; ++i)
+    {
+        Quantum value = i * 17;
+        energyMap.rgbPixelData[i] = {value, value, value, 255};
+    }
+
+    ImageData loaded;
+    EXPECT_FALSE(cache.loadEnergy(42, loaded));
+    cache.storeEnergy(42, energyMap);
+    ASSERT_TRUE(cache.loadEnergy(42, loaded));
+    EXPECT_EQ(hashPixels(energyMap), hashPixels(loaded));
+
+    std::vector<unsigned char> encoded = {9, 8, 7, 6, 5};
+    std::vector<unsigned char> loadedOutput;
+    EXPECT_FALSE(cache.loadOutput(42, loadedOutput));
+    cache.storeOutput(42, encoded);
+    ASSERT_TRUE(cache.loadOutput(42, loadedOutput));
+    EXPECT_EQ(encoded, loadedOutput);
+
+    CacheStats stats = cache.stats();
+    EXPECT_EQ(1u, stats.energyHits);
+    EXPECT_EQ(1u, stats.energyMisses);
+    EXPECT_EQ(1u, stats.outputHits);
+    EXPECT_EQ(1u, stats.outputMisses);
+}
+
+TEST(CacheTest, EvictsLeastRecentlyUsedEntries)
+{
+    std::string directory = freshDirectory("cache_eviction");
+    ResultCache cache(directory, 2500);
+    std::vector<unsigned char> entry(1000, 1);
+
+    cache.storeOutput(1, entry);
+    cache.storeOutput(2, entry);
+    std::filesystem::path first = std::filesystem::path(directory) / "0000000000000001.out";
+    std::filesystem::path second = std::filesystem::path(directory) / "0000000000000002.out";
+
+    // Age both entries, then read the first so the second becomes the least recently used
+    auto past = std::filesystem::file_time_type::clock::now() - std::chrono::hours(1);
+    std::filesystem::last_write_time(first, past - std::chrono::minutes(1));
+    std::filesystem::last_write_time(second, past);
+    std::vector<unsigned char> loaded;
+    ASSERT_TRUE(cache.loadOutput(1, loaded));
+
+    cache.storeOutput(3, entry);
+    EXPECT_EQ(2u, entryCount(directory));
+    EXPECT_TRUE(std::filesystem::exists(first));
+    EXPECT_FALSE(std::filesystem::exists(second));
+    EXPECT_EQ(1u, cache.stats().evictions);
+}
@@ -0,0 +1,105 @@
+#include <StronkImage.h>
+#include <gtest/gtest.h>
+#include <thread>
+
+#include "TestImages.h"
+
+using namespace StronkImage;
+using TestImages::noisyImage;
+
+TEST(CarveControlTest, ReportsStagesAndSeams)
+{
+    std::vector<CarveStage> stages;
+    int lastSeamsDone = -1;
+    CarveControl control([&](const CarveProgress &progress)
+                         {
+                             if (stages.empty() || stages.back() != progress.stage)
+                             {
+                                 stages.push_back(progress.stage);
+                             }
+                             EXPECT_GE(progress.seamsDone, lastSeamsDone);
+                             lastSeamsDone = progress.seamsDone; });
+
+    ImageData image = noisyImage(40, 30, 3);
+    {
+        CarveControlScope scope(control);
+        Carver::carve(image, 6);
+    }
+
+    // The grayscale conversion is fused into the blur, so it is not reported as a stage of its own
+    std::vector<CarveStage> expected = {CarveStage::Blur, CarveStage::Energy, CarveStage::Seams};
+    EXPECT_EQ(expected, stages);
+    CarveProgress progress = control.progress();
+    EXPECT_EQ(6, progress.seamsDone);
+    EXPECT_EQ(6, progress.seamsTotal);
+    EXPECT_EQ(CarveControl::current(), nullptr);
+}
+
+TEST(CarveControlTest, CancelStopsAtNextSeam)
+{
+    CarveControl *self = nullptr;
+    CarveControl control([&](const CarveProgress &progress)
+                         {
+                             if (progress.seamsDone == 3)
+                             {
+                                 self->cancel();
+                             } });
+    self = &control;
+
+    ImageData image = noisyImage(40, 30, 5);
+    CarveControlScope scope(control);
+    EXPECT_THROW(Carver::carve(image, 10), CarveCancelled);
+
+    // The seams removed before the cancellation stay removed, and the image stays consistent
+    EXPECT_EQ(37, image.getWidth());
+    EXPECT_EQ(3, control.progress().seamsDone);
+}
+
+TEST(CarveControlTest, CancelFromAnotherThread)
+{
+    CarveControl control;
+    ImageData image = noisyImage(300, 200, 9);
+    bool cancelled = false;
+
+    std::thread carver([&]
+                       {
+                           CarveControlScope scope(control);
+                           try
+                           {
+                               Carver::carve(image, 250);
+                           }
+                           catch (const CarveCancelled &)
+                           {
+                               cancelled = true;
+                           } });
+
+    while (control.progress().seamsDone < 2)
+    {
+        std::this_thread::yield();
+    }
+    control.cancel();
+    carver.join();
+
+    EXPECT_TRUE(cancelled);
+    EXPECT_LT(control.progress().seamsDone, 250);
+    EXPECT_EQ(300 - control.progress().seamsDone, image.getWidth());
+}
+
+TEST(CarveControlTest, ScopesNest)
+{
+    CarveControl outer, inner;
+    EXPECT_EQ(nullptr, CarveControl::current());
+    {
+        CarveControlScope outerScope(outer);
+        {
+            CarveControlScope innerScope(inner);
+            EXPECT_EQ(&inner, CarveControl::current());
+            inner.cancel();
+            EXPECT_THROW(carveCheckpoint(), CarveCancelled);
+        }
+        EXPECT_EQ(&outer, CarveControl::current());
+        EXPECT_NO_THROW(carveCheckpoint());
+    }
+    EXPECT_EQ(nullptr, CarveControl::current());
+    EXPECT_NO_THROW(carveCheckpoint());
+}
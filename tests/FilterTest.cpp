@@ -2,6 +2,8 @@
 #include <gtest/gtest.h>
 #include <unistd.h>
 
+#include "TestImages.h"
+
 #define PATH_MAX 2048
 
 using namespace StronkImage;
@@ -279,3 +281,680 @@ TEST(FilterRemoveSeamsTest, RemoveNoSeams)
     ASSERT_EQ(initialWidth, sourceImage.getWidth());
     ASSERT_EQ(energyMap.getWidth(), sourceImage.getWidth());
 }
+
+TEST(FilterFindSeamTest, BackpointerSeamIsOptimalAndConnected)
+{
+    const int width = 37;
+    const int height = 23;
+    ImageData energyMap(width, height);
+
+    TestImages::Noise noise(12345);
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            Quantum energy = noise.next() & 0xff;
+            energyMap.setPixel(x, y, {energy, energy, energy, 255});
+        }
+    }
+
+    // Reference: full cost matrix over the interior rows and columns
+    std::vector<std::vector<uint32_t>> cost(height, std::vector<uint32_t>(width, 0));
+    for (int y = 1; y < height - 1; ++y)
+    {
+        for (int x = 1; x < width - 1; ++x)
+        {
+            uint32_t best = cost[y - 1][x];
+            if (x > 1)
+                best = std::min(best, cost[y - 1][x - 1]);
+            if (x < width - 2)
+                best = std::min(best, cost[y - 1][x + 1]);
+            cost[y][x] = energyMap.getPixel(x, y).red + best;
+        }
+    }
+    uint32_t expectedCost = *std::min_element(cost[height - 2].begin() + 1, cost[height - 2].end() - 1);
+
+    std::vector<int> seam = Filter::findVerticalSeam(energyMap);
+
+    ASSERT_EQ(height, seam.size());
+    uint32_t seamCost = 0;
+    for (int y = 0; y < height; ++y)
+    {
+        ASSERT_GE(seam[y], 1);
+        ASSERT_LE(seam[y], width - 2);
+        if (y > 0)
+        {
+            ASSERT_LE(std::abs(seam[y] - seam[y - 1]), 1);
+        }
+        if (y > 0 && y < height - 1)
+        {
+            seamCost += energyMap.getPixel(seam[y], y).red;
+        }
+    }
+
+    EXPECT_EQ(expectedCost, seamCost);
+}
+
+TEST(FilterFindSeamTest, TooNarrowThrows)
+{
+    ImageData energyMap(2, 5, {0, 0, 0, 255});
+    EXPECT_THROW(Filter::findVerticalSeam(energyMap), std::invalid_argument);
+}
+
+// Colour image whose red channel records the original column of every pixel
+static ImageData columnIndexImage(int width, int height)
+{
+    ImageData image(width, height);
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            image.setPixel(x, y, {static_cast<Quantum>(x), 0, 0, 255});
+        }
+    }
+    return image;
+}
+
+TEST(FilterRegionSeamTest, SeamsStayInsideColumnRange)
+{
+    const int width = 40;
+    const int height = 15;
+    ImageData sourceImage = columnIndexImage(width, height);
+
+    // Cheapest energy lies outside the region so an unrestricted search would go there
+    ImageData energyMap(width, height);
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            Quantum energy = x >= 10 && x < 20 ? 200 + (x * 7 + y * 3) % 50 : 0;
+            energyMap.setPixel(x, y, {energy, energy, energy, 255});
+        }
+    }
+
+    SeamRegion region;
+    region.columnBegin = 10;
+    region.columnEnd = 20;
+    Filter::removeSeams(sourceImage, energyMap, 6, region);
+
+    ASSERT_EQ(width - 6, sourceImage.getWidth());
+    ASSERT_EQ(width - 6, energyMap.getWidth());
+    for (int y = 0; y < height; ++y)
+    {
+        // Columns left of the region keep their place and those right of it shift by exactly 6
+        for (int x = 0; x < 10; ++x)
+        {
+            ASSERT_EQ(static_cast<Quantum>(x), sourceImage.getPixel(x, y).red);
+        }
+        for (int x = 14; x < width - 6; ++x)
+        {
+            ASSERT_EQ(static_cast<Quantum>(x + 6), sourceImage.getPixel(x, y).red);
+        }
+    }
+}
+
+TEST(FilterRegionSeamTest, MaskedPixelsAreNeverRemoved)
+{
+    const int width = 20;
+    const int height = 12;
+    ImageData sourceImage = columnIndexImage(width, height);
+
+    // Column 7 has no energy at all but is protected by the mask
+    ImageData energyMap(width, height, {100, 100, 100, 255});
+    GrayImageData mask(width, height, 255);
+    for (int y = 0; y < height; ++y)
+    {
+        energyMap.setPixel(7, y, {0, 0, 0, 255});
+        mask.setPixel(7, y, 0);
+    }
+
+    SeamRegion region;
+    region.mask = &mask;
+    Filter::removeSeams(sourceImage, energyMap, 8, region);
+
+    ASSERT_EQ(width - 8, sourceImage.getWidth());
+    for (int y = 0; y < height; ++y)
+    {
+        bool kept = false;
+        for (unsigned int x = 0; x < sourceImage.getWidth(); ++x)
+        {
+            kept = kept || sourceImage.getPixel(x, y).red == 7;
+        }
+        ASSERT_TRUE(kept) << "row " << y;
+    }
+
+    // The caller's mask is left untouched
+    EXPECT_EQ(static_cast<unsigned int>(width), mask.getWidth());
+}
+
+TEST(FilterRegionSeamTest, FullyMaskedRegionThrows)
+{
+    ImageData sourceImage(10, 6, {1, 1, 1, 255});
+    ImageData energyMap(10, 6, {1, 1, 1, 255});
+    GrayImageData mask(10, 6, 255);
+    for (int y = 0; y < 6; ++y)
+    {
+        mask.setPixel(4, y, 0);
+    }
+
+    SeamRegion region;
+    region.columnBegin = 4;
+    region.columnEnd = 5;
+    region.mask = &mask;
+    EXPECT_THROW(Filter::removeSeams(sourceImage, energyMap, 1, region), std::runtime_error);
+}
+
+// Smooth gradients, a hard edge and noise, so the blur is compared on every kind of content
+static ImageData blurTestImage(int width, int height)
+{
+    ImageData image(width, height);
+    TestImages::Noise source(4242);
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            Quantum noise = (source.next() >> 24) % 40;
+            Quantum edge = x > width / 2 ? 120 : 0;
+            image.setPixel(x, y, {static_cast<Quantum>(x * 90 / width) + edge + noise, static_cast<Quantum>(y * 200 / height) + noise / 2, edge + noise, 255});
+        }
+    }
+    return image;
+}
+
+// A pixel protected by a mask must survive seam removal in every row, wherever the seams shifted it
+static void expectSurvivesInEveryRow(const ImageData &image, const RGBPixelBuf &pixel)
+{
+    for (unsigned int y = 0; y < image.getHeight(); ++y)
+    {
+        bool found = false;
+        for (unsigned int x = 0; x < image.getWidth(); ++x)
+        {
+            found = found || image.getPixel(x, y) == pixel;
+        }
+        EXPECT_TRUE(found) << "row " << y;
+    }
+}
+
+TEST(FilterBlurTest, BoxBlurWidthsMatchVariance)
+{
+    for (float sigma : {1.0f, 2.5f, 3.0f, 5.0f, 8.0f})
+    {
+        std::vector<int> widths = Filter::boxBlurWidths(sigma);
+        ASSERT_EQ(3u, widths.size());
+
+        float variance = 0.0f;
+        for (int width : widths)
+        {
+            ASSERT_EQ(1, width % 2);
+            variance += (width * width - 1) / 12.0f;
+        }
+        // Mixing the two neighbouring odd widths gets within one width step of the target
+        EXPECT_NEAR(sigma * sigma, variance, 2.0f * sigma + 1.0f) << sigma;
+    }
+}
+
+TEST(FilterBlurTest, BoxBlurStaysCloseToExactGaussian)
+{
+    const int width = 96;
+    const int height = 64;
+    const ImageData original = blurTestImage(width, height);
+
+    // The camera-noise range the box mode is meant for; below sigma 2 three boxes are too coarse
+    for (float sigma : {3.0f, 5.0f, 8.0f})
+    {
+        ImageData exact = original;
+        ImageData box = original;
+        Filter::gaussianBlur(exact, sigma, BlurMode::Exact);
+        Filter::gaussianBlur(box, sigma, BlurMode::Box);
+
+        double totalError = 0.0;
+        int maxError = 0;
+        for (int y = 0; y < height; ++y)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                RGBPixelBuf a = exact.getPixel(x, y);
+                RGBPixelBuf b = box.getPixel(x, y);
+                for (int error : {std::abs(int(a.red) - int(b.red)), std::abs(int(a.green) - int(b.green)), std::abs(int(a.blue) - int(b.blue))})
+                {
+                    maxError = std::max(maxError, error);
+                    totalError += error;
+                }
+            }
+        }
+
+        double meanError = totalError / (width * height * 3);
+        // Most of the mean is the exact path truncating where the box path rounds
+        EXPECT_LE(maxError, 6) << "sigma " << sigma;
+        EXPECT_LE(meanError, 0.75) << "sigma " << sigma;
+    }
+}
+
+TEST(FilterBlurTest, BoxBlurKeepsUniformImage)
+{
+    ImageData image(40, 30, {128, 77, 3, 255});
+    Filter::gaussianBlur(image, 6.0f, BlurMode::Box);
+    for (int y = 0; y < 30; ++y)
+    {
+        for (int x = 0; x < 40; ++x)
+        {
+            ASSERT_EQ(RGBPixelBuf({128, 77, 3, 255}), image.getPixel(x, y));
+        }
+    }
+}
+
+static GrayImageData noisyGrayscale(int width, int height)
+{
+    GrayImageData image(width, height);
+    TestImages::Noise noise(99);
+    for (int i = 0; i < width * height; ++i)
+    {
+        image.pixels[i] = static_cast<uint8_t>(noise.next() >> 24);
+    }
+    return image;
+}
+
+// The compile-time kernel must agree with the runtime matrix path on every pixel, including borders
+template <typename Kernel>
+static void expectMatchesRuntime(int width, int height)
+{
+    GrayImageData source = noisyGrayscale(width, height);
+    GrayImageData expected = Filter::ConvoluteSobelMatrix(source, Kernel::taps);
+    GrayImageData actual = convolve<Kernel>(source);
+
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            ASSERT_EQ(expected.getPixel(x, y), actual.getPixel(x, y)) << width << "x" << height << " at " << x << "," << y;
+        }
+    }
+}
+
+TEST(FilterKernelTest, CompileTimeKernelsMatchRuntimeConvolution)
+{
+    const int sizes[][2] = {{1, 1}, {2, 3}, {3, 2}, {17, 9}, {64, 33}};
+    for (const auto &size : sizes)
+    {
+        expectMatchesRuntime<Kernels::SobelX>(size[0], size[1]);
+        expectMatchesRuntime<Kernels::SobelY>(size[0], size[1]);
+        expectMatchesRuntime<Kernels::ScharrX>(size[0], size[1]);
+        expectMatchesRuntime<Kernels::ScharrY>(size[0], size[1]);
+        expectMatchesRuntime<Kernels::PrewittX>(size[0], size[1]);
+        expectMatchesRuntime<Kernels::PrewittY>(size[0], size[1]);
+    }
+}
+
+TEST(FilterKernelTest, GaussianKernelsAverageAndPreserveFlatAreas)
+{
+    GrayImageData flat(9, 7, 200);
+    GrayImageData blurred3 = convolve<Kernels::Gaussian3>(flat);
+    GrayImageData blurred5 = convolve<Kernels::Gaussian5>(flat);
+    for (int i = 0; i < 9 * 7; ++i)
+    {
+        ASSERT_EQ(200, blurred3.pixels[i]);
+        ASSERT_EQ(200, blurred5.pixels[i]);
+    }
+
+    // A single bright pixel spreads with the binomial weights, rounded to nearest
+    GrayImageData impulse(7, 7, 0);
+    impulse.setPixel(3, 3, 160);
+    GrayImageData spread = convolve<Kernels::Gaussian5>(impulse);
+    EXPECT_EQ(23, spread.getPixel(3, 3)); // 160 * 36 / 256 = 22.5
+    EXPECT_EQ(15, spread.getPixel(2, 3)); // 160 * 24 / 256 = 15
+    EXPECT_EQ(1, spread.getPixel(1, 1));  // 160 * 1 / 256 = 0.625
+}
+
+static_assert(Kernels::SobelX::taps[1][1] == 0 && sobelMatrixX[0][2] == 1, "Sobel constants are usable at compile time");
+
+TEST(FilterGrayscaleTest, FixedPointLumaMatchesReference)
+{
+    for (Quantum value = 0; value <= 255; ++value)
+    {
+        ASSERT_EQ(value, luma(value, value, value));
+    }
+
+    for (Quantum red = 0; red <= 255; red += 5)
+    {
+        for (Quantum green = 0; green <= 255; green += 3)
+        {
+            for (Quantum blue = 0; blue <= 255; blue += 7)
+            {
+                double exact = 0.299 * red + 0.587 * green + 0.114 * blue;
+                // Rounding plus the 16-bit quantisation of the weights stays well inside one grey level
+                ASSERT_LE(std::abs(luma(red, green, blue) - exact), 0.51);
+            }
+        }
+    }
+}
+
+TEST(FilterGrayscaleTest, SingleChannelMatchesInPlaceConversion)
+{
+    ImageData colourImage(7, 5);
+    for (int y = 0; y < 5; ++y)
+    {
+        for (int x = 0; x < 7; ++x)
+        {
+            colourImage.setPixel(x, y, {static_cast<Quantum>(x * 36), static_cast<Quantum>(y * 60), static_cast<Quantum>((x * y * 13) % 256), 255});
+        }
+    }
+
+    GrayImageData grayscale = Filter::genGrayscale(colourImage);
+    ImageData inPlace = colourImage;
+    Filter::genGrayscaleData(inPlace);
+
+    ASSERT_EQ(7, grayscale.getWidth());
+    ASSERT_EQ(5, grayscale.getHeight());
+    for (int y = 0; y < 5; ++y)
+    {
+        for (int x = 0; x < 7; ++x)
+        {
+            EXPECT_EQ(inPlace.getPixel(x, y).red, grayscale.getPixel(x, y));
+            EXPECT_EQ(inPlace.getPixel(x, y).blue, grayscale.getPixel(x, y));
+        }
+    }
+
+    // Both energy map entry points agree
+    ImageData fromColour = Filter::generateEnergyMap(colourImage);
+    ImageData fromGray = Filter::generateEnergyMap(grayscale);
+    for (int y = 0; y < 5; ++y)
+    {
+        for (int x = 0; x < 7; ++x)
+        {
+            EXPECT_EQ(fromColour.getPixel(x, y), fromGray.getPixel(x, y));
+        }
+    }
+}
+
+TEST(FilterResampleTest, AveragesInsideRangeAndKeepsTheRest)
+{
+    ImageData image(8, 2);
+    for (int y = 0; y < 2; ++y)
+    {
+        for (int x = 0; x < 8; ++x)
+        {
+            image.setPixel(x, y, {static_cast<Quantum>(x * 10), 50, 100, 255});
+        }
+    }
+
+    // Columns 2..5 become 2 columns, each the mean of a pair
+    Filter::resampleWidth(image, 2, 2, 6);
+    ASSERT_EQ(6, image.getWidth());
+    for (int y = 0; y < 2; ++y)
+    {
+        EXPECT_EQ(0u, image.getPixel(0, y).red);
+        EXPECT_EQ(10u, image.getPixel(1, y).red);
+        EXPECT_EQ(25u, image.getPixel(2, y).red);
+        EXPECT_EQ(45u, image.getPixel(3, y).red);
+        EXPECT_EQ(60u, image.getPixel(4, y).red);
+        EXPECT_EQ(70u, image.getPixel(5, y).red);
+        EXPECT_EQ(50u, image.getPixel(2, y).green);
+    }
+
+    EXPECT_THROW(Filter::resampleWidth(image, 6), std::invalid_argument);
+    EXPECT_THROW(Filter::resampleWidth(image, 1, 4, 4), std::invalid_argument);
+}
+
+TEST(CarverBudgetTest, PassedDeadlineStopsExactSeams)
+{
+    ImageData sourceImage = blurTestImage(40, 20);
+    ImageData energyMap = Carver::generateEnergyMap(sourceImage);
+
+    ImageData image(sourceImage);
+    EXPECT_EQ(0, Filter::removeSeams(image, energyMap, 5, SeamRegion(), nullptr, std::chrono::steady_clock::now()));
+    EXPECT_EQ(sourceImage.rgbPixelData[0], image.rgbPixelData[0]);
+    EXPECT_EQ(40, image.getWidth());
+    EXPECT_EQ(5, Filter::removeSeams(image, energyMap, 5, SeamRegion()));
+    EXPECT_EQ(35, image.getWidth());
+}
+
+TEST(CarverBudgetTest, ExhaustedBudgetFallsBackToResampling)
+{
+    ImageData sourceImage = blurTestImage(40, 30);
+
+    ImageData unlimited(sourceImage);
+    CarveResult result = Carver::carveTo(unlimited, 32, 26);
+    EXPECT_EQ(12, result.exactSeams);
+    EXPECT_EQ(0, result.resampledSeams);
+
+    CarveOptions options;
+    options.timeBudgetSeconds = 1e-9;
+    ImageData budgeted(sourceImage);
+    result = Carver::carveTo(budgeted, 32, 26, options);
+    EXPECT_EQ(0, result.exactSeams);
+    EXPECT_EQ(12, result.resampledSeams);
+    EXPECT_EQ(32, budgeted.getWidth());
+    EXPECT_EQ(26, budgeted.getHeight());
+
+    // A region is narrowed by the fallback as well, leaving the columns outside it alone
+    options.region.columnBegin = 10;
+    options.region.columnEnd = 30;
+    ImageData regional(sourceImage);
+    result = Carver::carve(regional, 5, options);
+    EXPECT_EQ(5, result.resampledSeams);
+    ASSERT_EQ(35, regional.getWidth());
+    for (int y = 0; y < 30; ++y)
+    {
+        EXPECT_EQ(sourceImage.getPixel(9, y), regional.getPixel(9, y));
+        EXPECT_EQ(sourceImage.getPixel(30, y), regional.getPixel(25, y));
+    }
+}
+
+TEST(FilterGreedySeamTest, ConnectedAndNeverCheaperThanExact)
+{
+    for (uint32_t size : {16u, 40u, 90u})
+    {
+        ImageData energyMap = Carver::generateEnergyMap(blurTestImage(size, size * 3 / 4));
+        std::vector<int> exact = Filter::findVerticalSeam(energyMap);
+        std::vector<int> greedy = Filter::findGreedySeam(energyMap);
+
+        ASSERT_EQ(energyMap.height, greedy.size());
+        for (size_t y = 0; y < greedy.size(); ++y)
+        {
+            EXPECT_GE(greedy[y], 1);
+            EXPECT_LE(greedy[y], static_cast<int>(size) - 2);
+            if (y > 0)
+            {
+                EXPECT_LE(std::abs(greedy[y] - greedy[y - 1]), 1);
+            }
+        }
+
+        // The exact search is optimal, and on this content greedy stays within twice its cost
+        uint64_t exactEnergy = Filter::seamEnergy(energyMap, exact);
+        uint64_t greedyEnergy = Filter::seamEnergy(energyMap, greedy);
+        EXPECT_GE(greedyEnergy, exactEnergy);
+        EXPECT_LE(greedyEnergy, 2 * exactEnergy + 255) << size;
+    }
+}
+
+TEST(FilterGreedySeamTest, FollowsAZeroEnergyChannel)
+{
+    // A winding zero-energy channel in a bright field is the only cheap path; greedy must find it exactly
+    const int width = 20, height = 15;
+    ImageData energyMap(width, height);
+    for (int y = 0; y < height; ++y)
+    {
+        int channel = 8 + std::abs((y / 3) % 4 - 2);
+        for (int x = 0; x < width; ++x)
+        {
+            Quantum value = x == channel ? 0 : 200;
+            energyMap.setPixel(x, y, {value, value, value, 255});
+        }
+    }
+
+    std::vector<int> greedy = Filter::findGreedySeam(energyMap);
+    EXPECT_EQ(0u, Filter::seamEnergy(energyMap, greedy));
+    EXPECT_EQ(Filter::seamEnergy(energyMap, Filter::findVerticalSeam(energyMap)), Filter::seamEnergy(energyMap, greedy));
+}
+
+TEST(FilterGreedySeamTest, RemoveSeamsHonoursRegionAndMask)
+{
+    const int width = 30, height = 20;
+    ImageData sourceImage = blurTestImage(width, height);
+    ImageData energyMap = Carver::generateEnergyMap(sourceImage);
+
+    // Protect column 12 with the mask and keep seams inside columns 10..19
+    GrayImageData mask(width, height);
+    std::fill(mask.pixels, mask.pixels + width * height, 255);
+    for (int y = 0; y < height; ++y)
+    {
+        mask.pixels[y * width + 12] = 0;
+        sourceImage.setPixel(12, y, {1, 2, 3, 255});
+    }
+
+    SeamRegion region;
+    region.columnBegin = 10;
+    region.columnEnd = 20;
+    region.mask = &mask;
+    region.seamMode = SeamMode::Greedy;
+
+    std::vector<std::vector<int>> seams;
+    EXPECT_EQ(4, Filter::removeSeams(sourceImage, energyMap, 4, region, &seams));
+    EXPECT_EQ(width - 4, sourceImage.getWidth());
+    for (const std::vector<int> &seam : seams)
+    {
+        for (int column : seam)
+        {
+            EXPECT_GE(column, 10);
+            EXPECT_LT(column, 20);
+        }
+    }
+
+    // The protected pixels survive, shifted left only by seams that passed to their left
+    expectSurvivesInEveryRow(sourceImage, {1, 2, 3, 255});
+}
+
+TEST(FilterStripSeamTest, ConnectedAndCloseToExact)
+{
+    for (uint32_t height : {300u, 700u})
+    {
+        ImageData energyMap = Carver::generateEnergyMap(blurTestImage(80, height));
+        std::vector<int> exact = Filter::findVerticalSeam(energyMap);
+        uint64_t exactEnergy = Filter::seamEnergy(energyMap, exact);
+
+        // A single strip is the exact search
+        EXPECT_EQ(exact, Filter::findStripSeam(energyMap, 1));
+
+        for (unsigned int numStrips : {2u, 4u, 8u})
+        {
+            std::vector<int> striped = Filter::findStripSeam(energyMap, numStrips);
+            ASSERT_EQ(energyMap.height, striped.size());
+            for (size_t y = 0; y < striped.size(); ++y)
+            {
+                EXPECT_GE(striped[y], 1);
+                EXPECT_LE(striped[y], 78);
+                if (y > 0)
+                {
+                    EXPECT_LE(std::abs(striped[y] - striped[y - 1]), 1) << numStrips << " strips, row " << y;
+                }
+            }
+
+            // Only the boundaries are chosen locally; on this content the seam stays within a quarter of the optimum
+            uint64_t stripedEnergy = Filter::seamEnergy(energyMap, striped);
+            EXPECT_GE(stripedEnergy, exactEnergy);
+            EXPECT_LE(stripedEnergy, exactEnergy + exactEnergy / 4) << numStrips << " strips";
+        }
+    }
+}
+
+TEST(FilterStripSeamTest, ShortImagesUseFewerStrips)
+{
+    // 100 rows leave room for one strip of Filter::minimumStripRows, so the search is exact
+    ImageData energyMap = Carver::generateEnergyMap(blurTestImage(40, 100));
+    EXPECT_EQ(Filter::findVerticalSeam(energyMap), Filter::findStripSeam(energyMap, 8));
+}
+
+TEST(FilterStripSeamTest, RemoveSeamsHonoursRegionAndMask)
+{
+    const int width = 40, height = 400;
+    ImageData sourceImage = blurTestImage(width, height);
+    ImageData energyMap = Carver::generateEnergyMap(sourceImage);
+
+    // Protect column 15 with the mask and keep seams inside columns 10..29
+    GrayImageData mask(width, height);
+    std::fill(mask.pixels, mask.pixels + width * height, 255);
+    for (int y = 0; y < height; ++y)
+    {
+        mask.pixels[y * width + 15] = 0;
+        sourceImage.setPixel(15, y, {1, 2, 3, 255});
+    }
+
+    SeamRegion region;
+    region.columnBegin = 10;
+    region.columnEnd = 30;
+    region.mask = &mask;
+    region.seamMode = SeamMode::Strips;
+    region.numStrips = 4;
+
+    std::vector<std::vector<int>> seams;
+    EXPECT_EQ(6, Filter::removeSeams(sourceImage, energyMap, 6, region, &seams));
+    EXPECT_EQ(width - 6, sourceImage.getWidth());
+    for (const std::vector<int> &seam : seams)
+    {
+        for (size_t y = 0; y < seam.size(); ++y)
+        {
+            EXPECT_GE(seam[y], 10);
+            EXPECT_LT(seam[y], 30);
+            if (y > 0)
+            {
+                EXPECT_LE(std::abs(seam[y] - seam[y - 1]), 1);
+            }
+        }
+    }
+
+    // The protected pixels survive in every row
+    expectSurvivesInEveryRow(sourceImage, {1, 2, 3, 255});
+}
+
+TEST(FilterRemoveSeamsTest, LazyDeletionMatchesSeamBySeamRemoval)
+{
+    ImageData sourceImage = blurTestImage(37, 19);
+    ImageData energyMap = Carver::generateEnergyMap(sourceImage);
+    GrayImageData mask(37, 19, 255);
+    for (int y = 0; y < 19; ++y)
+    {
+        mask.setPixel(12 + y % 3, y, 0);
+    }
+
+    for (bool restricted : {false, true})
+    {
+        SeamRegion region;
+        if (restricted)
+        {
+            region.columnBegin = 5;
+            region.columnEnd = 30;
+            region.mask = &mask;
+        }
+
+        ImageData carved = sourceImage;
+        ImageData carvedEnergy = energyMap;
+        std::vector<std::vector<int>> seams;
+        ASSERT_EQ(9, Filter::removeSeams(carved, carvedEnergy, 9, region, &seams));
+        ASSERT_EQ(9u, seams.size());
+
+        // Removing the reported seams one at a time from full images gives the same pixels, and without a
+        // region every seam is the one the search picks on the image as it was at that point
+        ImageData expected = sourceImage;
+        ImageData expectedEnergy = energyMap;
+        for (const std::vector<int> &seam : seams)
+        {
+            if (!restricted)
+            {
+                ASSERT_EQ(Filter::findVerticalSeam(expectedEnergy), seam);
+            }
+            expected.removeSeam(seam);
+            expectedEnergy.removeSeam(seam);
+        }
+
+        ASSERT_EQ(expected.getWidth(), carved.getWidth());
+        ASSERT_EQ(expectedEnergy.getWidth(), carvedEnergy.getWidth());
+        for (unsigned int y = 0; y < expected.getHeight(); ++y)
+        {
+            for (unsigned int x = 0; x < expected.getWidth(); ++x)
+            {
+                ASSERT_EQ(expected.getPixel(x, y), carved.getPixel(x, y)) << x << "," << y;
+                ASSERT_EQ(expectedEnergy.getPixel(x, y), carvedEnergy.getPixel(x, y)) << x << "," << y;
+            }
+        }
+    }
+}
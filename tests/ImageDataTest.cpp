@@ -1,5 +1,7 @@
 #include <StronkImage.h>
 #include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
 #include <stdexcept>
 
 using namespace StronkImage;
@@ -61,3 +63,139 @@ TEST(ImageDataTest, GetSetPixelValidPositions) {
     imageData.setPixel(1, 1, pixel);
     EXPECT_EQ(pixel, imageData.getPixel(1, 1));
 }
+
+// Test removeSeam shifts each row left in place and keeps the buffer
+TEST(ImageDataTest, RemoveSeamCompactsInPlace) {
+    ImageData image(4, 3);
+    for (int y = 0; y < 3; ++y) {
+        for (int x = 0; x < 4; ++x) {
+            image.setPixel(x, y, { static_cast<Quantum>(x), static_cast<Quantum>(y), 0, 255 });
+        }
+    }
+
+    RGBPixelBuf *buffer = image.rgbPixelData;
+    image.removeSeam({ 0, 2, 3 });
+
+    EXPECT_EQ(buffer, image.rgbPixelData);
+    ASSERT_EQ(3, image.getWidth());
+    EXPECT_EQ(1, image.getPixel(0, 0).red);
+    EXPECT_EQ(3, image.getPixel(2, 0).red);
+    EXPECT_EQ(1, image.getPixel(1, 1).red);
+    EXPECT_EQ(3, image.getPixel(2, 1).red);
+    EXPECT_EQ(2, image.getPixel(2, 2).red);
+    EXPECT_EQ(2, image.getPixel(0, 2).green);
+}
+
+// Test a seam with a bad entry in a later row is refused before any row is shifted
+TEST(ImageDataTest, RemoveSeamRejectsBadEntriesUpFront) {
+    ImageData image(4, 3);
+    for (int y = 0; y < 3; ++y) {
+        for (int x = 0; x < 4; ++x) {
+            image.setPixel(x, y, { static_cast<Quantum>(x), static_cast<Quantum>(y), 0, 255 });
+        }
+    }
+    ImageData original(image);
+
+    EXPECT_THROW(image.removeSeam({ 1, 1, 4 }), std::out_of_range);
+    EXPECT_THROW(image.removeSeam({ 1, -1, 1 }), std::out_of_range);
+    EXPECT_THROW(image.removeSeam({ 1, 1 }), std::invalid_argument);
+
+    ASSERT_EQ(4, image.getWidth());
+    EXPECT_EQ(hashPixels(original), hashPixels(image));
+}
+
+// Test moving an image hands over its buffer and leaves the source empty
+TEST(ImageDataTest, MoveLeavesSourceEmpty) {
+    ImageData source(5, 5, { 9, 9, 9, 255 });
+    RGBPixelBuf *buffer = source.rgbPixelData;
+
+    ImageData target(std::move(source));
+
+    EXPECT_EQ(buffer, target.rgbPixelData);
+    EXPECT_EQ(nullptr, source.rgbPixelData);
+    EXPECT_EQ(0, source.getWidth());
+}
+
+// FNV-1a must match the published test vectors, since reported checksums are compared across builds
+TEST(ImageDataTest, Fnv1aKnownVectors) {
+    EXPECT_EQ(fnvOffsetBasis, fnv1a("", 0));
+    EXPECT_EQ(0xaf63dc4c8601ec8cULL, fnv1a("a", 1));
+    EXPECT_EQ(0x85944171f73967e8ULL, fnv1a("foobar", 6));
+}
+
+// Test hashPixels reacts to pixel and size changes
+TEST(ImageDataTest, HashPixelsDetectsChanges) {
+    ImageData imageData(4, 3);
+    uint64_t original = hashPixels(imageData);
+    EXPECT_EQ(original, hashPixels(ImageData(imageData)));
+
+    imageData.setPixel(2, 1, { 1, 0, 0, 255 });
+    EXPECT_NE(original, hashPixels(imageData));
+    EXPECT_NE(hashPixels(ImageData(4, 3)), hashPixels(ImageData(3, 4)));
+}
+
+// Test PAM and raw files round trip losslessly through files and memory, and PPM drops only alpha
+TEST(ImageDataTest, UncompressedFormatsRoundTrip) {
+    ImageData imageData(7, 5);
+    for (int y = 0; y < 5; ++y) {
+        for (int x = 0; x < 7; ++x) {
+            imageData.setPixel(x, y, { static_cast<Quantum>(x * 30), static_cast<Quantum>(y * 50), static_cast<Quantum>(x + y), static_cast<Quantum>(255 - x) });
+        }
+    }
+
+    for (const char *path : { "test_images/roundtrip.pam", "test_images/roundtrip.raw", "test_images/roundtrip.ppm" }) {
+        ImageFormat format = Image::formatFromPath(path);
+        bool keepsAlpha = format != ImageFormat::Ppm;
+
+        Image(imageData).writeToFile(path);
+        Image fromFile(path);
+        std::vector<unsigned char> encoded = Image(imageData).writeToMemory(format);
+        EXPECT_EQ(format, Image::formatFromSignature(encoded.data(), encoded.size()));
+        Image fromMemory;
+        fromMemory.loadFromMemory(encoded.data(), encoded.size());
+
+        for (Image *loaded : { &fromFile, &fromMemory }) {
+            ASSERT_EQ(7u, loaded->getRawImageData().getWidth()) << path;
+            ASSERT_EQ(5u, loaded->getRawImageData().getHeight()) << path;
+            for (int y = 0; y < 5; ++y) {
+                for (int x = 0; x < 7; ++x) {
+                    RGBPixelBuf expected = imageData.getPixel(x, y);
+                    expected.opacity = keepsAlpha ? expected.opacity : 255;
+                    ASSERT_EQ(expected, loaded->getRawImageData().getPixel(x, y)) << path << " " << x << "," << y;
+                }
+            }
+        }
+    }
+}
+
+// Test Netpbm headers with comments and gray channels, and that bad headers are rejected
+TEST(ImageDataTest, NetpbmHeaderVariants) {
+    std::string pgm = "P5\n# a comment\n2 1\n255\n";
+    pgm += std::string("\x10\x80", 2);
+    Image gray;
+    gray.loadFromMemory(reinterpret_cast<const unsigned char *>(pgm.data()), pgm.size());
+    EXPECT_EQ((RGBPixelBuf{ 0x80, 0x80, 0x80, 255 }), gray.getRawImageData().getPixel(1, 0));
+
+    std::string pam = "P7\nWIDTH 1\nHEIGHT 1\nDEPTH 2\nMAXVAL 255\nTUPLTYPE GRAYSCALE_ALPHA\nENDHDR\n";
+    pam += std::string("\x20\x40", 2);
+    Image grayAlpha;
+    grayAlpha.loadFromMemory(reinterpret_cast<const unsigned char *>(pam.data()), pam.size());
+    EXPECT_EQ((RGBPixelBuf{ 0x20, 0x20, 0x20, 0x40 }), grayAlpha.getRawImageData().getPixel(0, 0));
+
+    for (std::string bad : { std::string("P6\n2 2\n255\n\x01\x02"), std::string("P6\n1 1\n65535\n\x01\x02\x03\x04\x05\x06"), std::string("P7\nWIDTH 1\nHEIGHT 1\nDEPTH 5\nMAXVAL 255\nENDHDR\n") }) {
+        Image image;
+        EXPECT_THROW(image.loadFromMemory(reinterpret_cast<const unsigned char *>(bad.data()), bad.size()), std::runtime_error);
+    }
+}
+
+// Test gray .pgm files are read but never written, since the writers always produce colour
+TEST(ImageDataTest, PgmIsOnlyRead) {
+    std::ofstream("test_images/gray.pgm", std::ios::binary) << "P5\n2 1\n255\n" << std::string("\x10\x80", 2);
+    Image gray("test_images/gray.pgm");
+    EXPECT_EQ((RGBPixelBuf{ 0x10, 0x10, 0x10, 255 }), gray.getRawImageData().getPixel(0, 0));
+
+    std::filesystem::remove("test_images/gray_out.pgm");
+    EXPECT_THROW(gray.writeToFile("test_images/gray_out.pgm"), std::runtime_error);
+    EXPECT_FALSE(std::filesystem::exists("test_images/gray_out.pgm"));
+    EXPECT_EQ(ImageFormat::Ppm, Image::formatForWriting("test_images/gray_out.ppm"));
+}
@@ -0,0 +1,193 @@
+#include <cmath>
+#include <cstring>
+
+#include <StronkImage.h>
+#include <gtest/gtest.h>
+
+#include "TestImages.h"
+
+using namespace StronkImage;
+using TestImages::noisyImage;
+
+namespace
+{
+    std::vector<std::string> stageNames(const std::vector<PipelineStage> &stages)
+    {
+        std::vector<std::string> names;
+        for (const PipelineStage &stage : stages)
+        {
+            names.push_back(stage.name());
+        }
+        return names;
+    }
+}
+
+TEST(PipelineTest, PlanReordersMergesAndFuses)
+{
+    Pipeline energy = Pipeline::energyMap(1.5f);
+
+    PipelineOptions literal;
+    literal.reorder = false;
+    literal.mergeBlurs = false;
+    literal.fuse = false;
+    EXPECT_EQ((std::vector<std::string>{"blur", "grayscale", "gradient"}), stageNames(energy.plan(literal)));
+    EXPECT_EQ((std::vector<std::string>{"grayscale+blur", "gradient"}), stageNames(energy.plan()));
+
+    // Redundant conversions and empty blurs are dropped, blurs on either side of the conversion merge,
+    // and the conversion a gradient needs is added
+    Pipeline cluttered;
+    cluttered.blur(3.0f).grayscale().grayscale().blur(4.0f).blur(0.0f).gradient();
+    std::vector<PipelineStage> planned = cluttered.plan();
+    ASSERT_EQ(2u, planned.size());
+    EXPECT_EQ("grayscale+blur", planned[0].name());
+    EXPECT_FLOAT_EQ(5.0f, planned[0].sigma);
+    EXPECT_EQ("gradient", planned[1].name());
+
+    EXPECT_EQ((std::vector<std::string>{"grayscale+gradient"}), stageNames(Pipeline().gradient().plan()));
+
+    Pipeline invalid;
+    invalid.gradient().blur(1.0f);
+    EXPECT_THROW(invalid.plan(), std::invalid_argument);
+}
+
+TEST(PipelineTest, OptimizedPlanMatchesLiteralPlan)
+{
+    ImageData image = noisyImage(61, 37, 11);
+
+    PipelineOptions literal;
+    literal.reorder = false;
+    literal.mergeBlurs = false;
+    literal.fuse = false;
+
+    for (BlurMode mode : {BlurMode::Exact, BlurMode::Box})
+    {
+        Pipeline energy = Pipeline::energyMap(2.0f, mode);
+        ImageData expected = energy.run(image, literal);
+        ImageData optimized = energy.run(image);
+
+        ASSERT_EQ(expected.getWidth(), optimized.getWidth());
+        ASSERT_EQ(expected.getHeight(), optimized.getHeight());
+
+        // Blurring the luminance instead of the channels only moves where the rounding happens, which the
+        // gradient amplifies by a few levels at most
+        int totalDifference = 0;
+        for (unsigned int y = 0; y < expected.getHeight(); ++y)
+        {
+            for (unsigned int x = 0; x < expected.getWidth(); ++x)
+            {
+                int difference = std::abs(static_cast<int>(expected.getPixel(x, y).red) - static_cast<int>(optimized.getPixel(x, y).red));
+                ASSERT_LE(difference, 8) << x << "," << y;
+                totalDifference += difference;
+            }
+        }
+        EXPECT_LT(totalDifference, 61 * 37);
+    }
+
+    // The input is never modified
+    EXPECT_EQ(noisyImage(61, 37, 11).getPixel(30, 20), image.getPixel(30, 20));
+}
+
+TEST(PipelineTest, FusedStagesMatchTheirSeparateParts)
+{
+    ImageData image = noisyImage(29, 17, 4);
+    GrayImageData grayscale = Filter::genGrayscale(image);
+
+    // The single-pass gradient is bit-identical to the two clamped convolutions combined
+    GrayImageData sobelX = convolve<Kernels::SobelX>(grayscale);
+    GrayImageData sobelY = convolve<Kernels::SobelY>(grayscale);
+    ImageData energyMap = Filter::generateEnergyMap(grayscale);
+    for (int y = 0; y < 17; ++y)
+    {
+        for (int x = 0; x < 29; ++x)
+        {
+            int gradientX = sobelX.row(y)[x];
+            int gradientY = sobelY.row(y)[x];
+            Quantum expected = static_cast<Quantum>(std::min(static_cast<int>(std::sqrt(gradientX * gradientX + gradientY * gradientY)), 255));
+            ASSERT_EQ(expected, energyMap.getPixel(x, y).red) << x << "," << y;
+        }
+    }
+
+    // Converting rows while blurring gives exactly the conversion followed by the blur
+    for (BlurMode mode : {BlurMode::Exact, BlurMode::Box})
+    {
+        GrayImageData blurred = grayscale;
+        Filter::gaussianBlur(blurred, 1.5f, mode);
+        GrayImageData fused = Filter::blurredGrayscale(image, 1.5f, mode);
+        for (int y = 0; y < 17; ++y)
+        {
+            for (int x = 0; x < 29; ++x)
+            {
+                ASSERT_EQ(blurred.row(y)[x], fused.row(y)[x]) << x << "," << y;
+            }
+        }
+    }
+}
+
+TEST(PipelineTest, GrayBlurTracksColourBlur)
+{
+    ImageData image = noisyImage(40, 30, 7);
+    ImageData colourBlurred = image;
+    Filter::gaussianBlur(colourBlurred, 1.0f);
+    GrayImageData expected = Filter::genGrayscale(colourBlurred);
+
+    GrayImageData blurred = Filter::blurredGrayscale(image, 1.0f);
+    for (int y = 0; y < 30; ++y)
+    {
+        for (int x = 0; x < 40; ++x)
+        {
+            ASSERT_LE(std::abs(static_cast<int>(expected.row(y)[x]) - static_cast<int>(blurred.row(y)[x])), 2) << x << "," << y;
+        }
+    }
+}
+
+TEST(PipelineTest, StreamingEnergyMatchesPipeline)
+{
+    ImageData image = noisyImage(53, 41, 9);
+    image.setPixel(0, 0, {255, 255, 255, 255});
+
+    for (float sigma : {0.0f, 1.5f})
+    {
+        for (BlurMode mode : {BlurMode::Exact, BlurMode::Box})
+        {
+            CarveOptions options;
+            options.blurSigma = sigma;
+            options.blurMode = mode;
+            ImageData expected = Carver::generateEnergyMap(image, options);
+
+            // Rows are asked for once each, from the top
+            int nextRow = 0;
+            ImageData streamed = Filter::streamEnergyMap(image, sigma, mode, [&nextRow](unsigned int y)
+                                                         { ASSERT_EQ(nextRow++, static_cast<int>(y)); });
+            EXPECT_EQ(41, nextRow);
+            ASSERT_EQ(0, std::memcmp(expected.rgbPixelData, streamed.rgbPixelData, 53 * 41 * sizeof(RGBPixelBuf))) << sigma;
+        }
+    }
+}
+
+TEST(PipelineTest, EnergyThreadFollowsTheDecoder)
+{
+    Image(noisyImage(97, 300, 5)).writeToFile("test_images/streamed.png");
+    Image decoded("test_images/streamed.png");
+    CarveOptions options;
+    options.blurSigma = 2.0f;
+    ImageData expected = Carver::generateEnergyMap(decoded.getRawImageData(), options);
+
+    for (unsigned int numThreads : {1u, 2u})
+    {
+        ImageData colourImage;
+        ImageData energyMap = Carver::loadWithEnergyMap("test_images/streamed.png", colourImage, options, numThreads);
+        ASSERT_EQ(97u, colourImage.getWidth());
+        ASSERT_EQ(300u, energyMap.getHeight());
+        EXPECT_EQ(0, std::memcmp(decoded.getRawImageData().rgbPixelData, colourImage.rgbPixelData, 97 * 300 * sizeof(RGBPixelBuf)));
+        EXPECT_EQ(0, std::memcmp(expected.rgbPixelData, energyMap.rgbPixelData, 97 * 300 * sizeof(RGBPixelBuf))) << numThreads;
+    }
+
+    // Failures on either thread reach the caller, and neither thread is left waiting
+    ImageData colourImage;
+    EXPECT_THROW(Carver::loadWithEnergyMap("test_images/missing.png", colourImage, options, 2), std::runtime_error);
+
+    CarveControl control;
+    CarveControlScope scope(control);
+    control.cancel();
+    EXPECT_THROW(Carver::loadWithEnergyMap("test_images/streamed.png", colourImage, options, 2), CarveCancelled);
+}
@@ -0,0 +1,134 @@
+#include <cstring>
+#include <sys/mman.h>
+
+#include <StronkImage.h>
+#include <gtest/gtest.h>
+
+using namespace StronkImage;
+
+namespace
+{
+    const StageProfile *findStage(const std::vector<StageProfile> &stages, const std::string &name)
+    {
+        for (const StageProfile &stage : stages)
+        {
+            if (stage.name == name)
+            {
+                return &stage;
+            }
+        }
+        return nullptr;
+    }
+}
+
+TEST(ProfilerTest, RecordsStagesOnlyWhenEnabled)
+{
+    if (!Profiler::compiledIn())
+    {
+        GTEST_SKIP() << "profiling compiled out";
+    }
+
+    ImageData image(16, 16, {10, 20, 30, 255});
+
+    Profiler::reset();
+    Profiler::setEnabled(false);
+    Filter::genGrayscaleData(image);
+    EXPECT_TRUE(Profiler::snapshot().empty());
+
+    Profiler::setEnabled(true);
+    Filter::genGrayscaleData(image);
+    Filter::genGrayscaleData(image);
+    ImageData sobel = Filter::ConvoluteSobelMatrix(image, sobelMatrixX);
+    Profiler::setEnabled(false);
+
+    std::vector<StageProfile> stages = Profiler::snapshot();
+
+    const StageProfile *grayscale = findStage(stages, "grayscale");
+    ASSERT_NE(nullptr, grayscale);
+    EXPECT_EQ(2, grayscale->calls);
+    EXPECT_EQ(0, grayscale->allocations);
+
+    // The Sobel pass allocates its output image from the buffer pool
+    const StageProfile *sobelStage = findStage(stages, "sobel");
+    ASSERT_NE(nullptr, sobelStage);
+    EXPECT_EQ(1, sobelStage->allocations);
+    EXPECT_GE(sobelStage->bytesAllocated, 16 * 16 * sizeof(RGBPixelBuf));
+
+    std::string json = Profiler::toJson();
+    EXPECT_NE(std::string::npos, json.find("\"name\":\"grayscale\""));
+    EXPECT_NE(std::string::npos, json.find("\"buffer_pool\""));
+
+    Profiler::reset();
+}
+
+TEST(ProfilerTest, SeamRemovalReportsSubStages)
+{
+    if (!Profiler::compiledIn())
+    {
+        GTEST_SKIP() << "profiling compiled out";
+    }
+
+    ImageData image(20, 10, {50, 60, 70, 255});
+    ImageData energyMap = Carver::generateEnergyMap(image);
+
+    Profiler::reset();
+    Profiler::setEnabled(true);
+    Filter::removeSeams(image, energyMap, 3);
+    Profiler::setEnabled(false);
+
+    std::vector<StageProfile> stages = Profiler::snapshot();
+    for (const char *name : {"dp", "traceback", "compaction"})
+    {
+        const StageProfile *stage = findStage(stages, name);
+        ASSERT_NE(nullptr, stage) << name;
+        EXPECT_EQ(3, stage->calls) << name;
+    }
+
+    Profiler::reset();
+}
+
+TEST(ProfilerTest, CountersJoinTheReportOrSayWhyNot)
+{
+    if (!Profiler::compiledIn())
+    {
+        GTEST_SKIP() << "profiling compiled out";
+    }
+
+    Profiler::reset();
+    Profiler::setEnabled(true);
+    bool available = Profiler::enableCounters(true);
+    {
+        // Freshly mapped pages fault in, so every event has work to count
+        ScopedTimer timer("counted");
+        const size_t size = 8 << 20;
+        void *pages = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        ASSERT_NE(MAP_FAILED, pages);
+        std::memset(pages, 1, size);
+        munmap(pages, size);
+    }
+    std::string summary = Profiler::summary();
+    std::string json = Profiler::toJson();
+    Profiler::enableCounters(false);
+    Profiler::setEnabled(false);
+
+    const StageProfile *stage = findStage(Profiler::snapshot(), "counted");
+    ASSERT_NE(nullptr, stage);
+    EXPECT_NE(std::string::npos, summary.find("counters: " + Profiler::countersStatus()));
+    EXPECT_NE(std::string::npos, json.find("\"counters\":{\"enabled\":"));
+
+    if (available)
+    {
+        EXPECT_EQ(1, stage->countedCalls);
+        EXPECT_GT(stage->counters.cycles + stage->counters.pageFaults, 0u);
+        EXPECT_NE(std::string::npos, json.find("\"counted_calls\":1"));
+    }
+    else
+    {
+        // Timings are still collected, and the report says why there are no counts
+        EXPECT_EQ(0, stage->countedCalls);
+        EXPECT_EQ(1, stage->calls);
+        EXPECT_EQ(0u, Profiler::countersStatus().find("unavailable"));
+    }
+
+    Profiler::reset();
+}
@@ -0,0 +1,128 @@
+#include <StronkImage.h>
+#include <gtest/gtest.h>
+#include <filesystem>
+
+#include "TestImages.h"
+
+using namespace StronkImage;
+using TestImages::barFrame;
+
+TEST(SequenceTest, GuidedSeamsStayInsideBand)
+{
+    ImageData first = barFrame(64, 40, 30, 1);
+    ImageData energyMap = Carver::generateEnergyMap(first);
+    std::vector<std::vector<int>> guides;
+    Filter::removeSeams(first, energyMap, 5, SeamRegion(), &guides);
+    ASSERT_EQ(5u, guides.size());
+
+    ImageData second = barFrame(64, 40, 31, 2);
+    ImageData secondEnergy = Carver::generateEnergyMap(second);
+    SeamRegion region;
+    region.guides = &guides;
+    region.bandRadius = 2;
+    std::vector<std::vector<int>> seams;
+    Filter::removeSeams(second, secondEnergy, 5, region, &seams);
+
+    ASSERT_EQ(59u, second.getWidth());
+    ASSERT_EQ(5u, seams.size());
+    for (size_t i = 0; i < seams.size(); ++i)
+    {
+        for (size_t y = 0; y < seams[i].size(); ++y)
+        {
+            ASSERT_LE(std::abs(seams[i][y] - guides[i][y]), 2) << "seam " << i << " row " << y;
+            if (y > 0)
+            {
+                ASSERT_LE(std::abs(seams[i][y] - seams[i][y - 1]), 1);
+            }
+        }
+    }
+}
+
+TEST(SequenceTest, WideBandMatchesFullSearch)
+{
+    ImageData previous = barFrame(48, 30, 20, 3);
+    ImageData previousEnergy = Carver::generateEnergyMap(previous);
+    std::vector<std::vector<int>> guides;
+    Filter::removeSeams(previous, previousEnergy, 4, SeamRegion(), &guides);
+
+    ImageData guided = barFrame(48, 30, 25, 4);
+    ImageData cold = guided;
+    ImageData guidedEnergy = Carver::generateEnergyMap(guided);
+    ImageData coldEnergy = guidedEnergy;
+
+    SeamRegion region;
+    region.guides = &guides;
+    region.bandRadius = 48;
+    Filter::removeSeams(guided, guidedEnergy, 4, region);
+    Filter::removeSeams(cold, coldEnergy, 4);
+
+    for (int y = 0; y < 30; ++y)
+    {
+        for (int x = 0; x < 44; ++x)
+        {
+            ASSERT_EQ(cold.getPixel(x, y), guided.getPixel(x, y));
+        }
+    }
+}
+
+TEST(SequenceTest, RepeatedFramesAndKeyframes)
+{
+    SequenceOptions options;
+    options.keyframeInterval = 2;
+    SequenceCarver carver(3, options);
+
+    ImageData output[5];
+    for (int index = 0; index < 5; ++index)
+    {
+        // Frames 1 and 2 are identical
+        output[index] = barFrame(32, 24, 10 + (index < 2 ? 0 : index), 7 + (index < 2 ? 0 : index));
+        carver.carveFrame(output[index]);
+        ASSERT_EQ(29u, output[index].getWidth());
+    }
+
+    for (int y = 0; y < 24; ++y)
+    {
+        for (int x = 0; x < 29; ++x)
+        {
+            ASSERT_EQ(output[0].getPixel(x, y), output[1].getPixel(x, y));
+        }
+    }
+
+    EXPECT_EQ(5u, carver.stats().frames);
+    EXPECT_EQ(1u, carver.stats().reusedFrames);
+    EXPECT_EQ(3u, carver.stats().keyframes);
+}
+
+TEST(SequenceTest, RunsNumberedFrames)
+{
+    for (int index = 1; index <= 3; ++index)
+    {
+        Image frame(barFrame(40, 20, 10 + index, index));
+        frame.writeToFile(SequenceCarver::framePath("test_images/sequence_in_%02d.png", index));
+    }
+
+    SequenceStats stats = SequenceCarver::run("test_images/sequence_in_%02d.png", "test_images/sequence_out_%02d.png", 1, 3, 6);
+    EXPECT_EQ(3u, stats.frames);
+    EXPECT_EQ(1u, stats.keyframes);
+
+    for (int index = 1; index <= 3; ++index)
+    {
+        Image carved(SequenceCarver::framePath("test_images/sequence_out_%02d.png", index));
+        EXPECT_EQ(34u, carved.getRawImageData().getWidth());
+    }
+
+    EXPECT_THROW(SequenceCarver::framePath("frame.png", 1), std::invalid_argument);
+}
+
+TEST(SequenceTest, FramePatternsAcceptOnlyOneNumber)
+{
+    EXPECT_EQ("frames/0007.png", SequenceCarver::framePath("frames/%04d.png", 7));
+    EXPECT_EQ("12.png", SequenceCarver::framePath("%d.png", 12));
+    EXPECT_EQ("  3.png", SequenceCarver::framePath("%3d.png", 3));
+    EXPECT_EQ("100%_05.png", SequenceCarver::framePath("100%%_%02d.png", 5));
+
+    for (const char *pattern : {"out/%s.png", "%d_%d.png", "%n", "%04x.png", "%.2d.png", "%-4d.png", "%99999d.png", "frame%", "100%%.png"})
+    {
+        EXPECT_THROW(SequenceCarver::framePath(pattern, 1), std::invalid_argument) << pattern;
+    }
+}
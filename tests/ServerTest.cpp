@@ -0,0 +1,231 @@
+#include <StronkImage.h>
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "TestImages.h"
+
+using namespace StronkImage;
+using TestImages::gradientImage;
+
+namespace
+{
+    const char *socketPath = "test_images/seamcarve_test.sock";
+}
+
+TEST(ImageMemoryTest, PngRoundTrip)
+{
+    ImageData imageData(4, 3, {10, 20, 30, 255});
+    imageData.setPixel(2, 1, {200, 100, 50, 128});
+
+    Image image(imageData);
+    std::vector<unsigned char> encoded = image.writeToMemory(ImageFormat::Png);
+    ASSERT_EQ(ImageFormat::Png, Image::formatFromSignature(encoded.data(), encoded.size()));
+
+    Image decoded;
+    decoded.loadFromMemory(encoded.data(), encoded.size());
+
+    for (int y = 0; y < 3; ++y)
+    {
+        for (int x = 0; x < 4; ++x)
+        {
+            EXPECT_EQ(imageData.getPixel(x, y), decoded.getRawImageData().getPixel(x, y));
+        }
+    }
+}
+
+TEST(ImageMemoryTest, CorruptDataThrows)
+{
+    std::vector<unsigned char> encoded = Image(gradientImage(8, 8)).writeToMemory(ImageFormat::Jpeg);
+    encoded.resize(encoded.size() / 4);
+
+    Image image;
+    EXPECT_THROW(image.loadFromMemory(encoded.data(), encoded.size()), std::runtime_error);
+
+    unsigned char garbage[16] = {1, 2, 3};
+    EXPECT_THROW(image.loadFromMemory(garbage, sizeof(garbage)), std::runtime_error);
+}
+
+TEST(ServerTest, CarvesRequestsOverSocket)
+{
+    Server server(socketPath, 2);
+    server.start();
+
+    Client client(socketPath);
+
+    CarveRequest request;
+    request.imageBytes = Image(gradientImage(40, 30)).writeToMemory(ImageFormat::Png);
+    request.targetWidth = 35;
+    request.targetHeight = 28;
+    request.outputFormat = ImageFormat::Png;
+
+    // Several requests share the same connection and warm server state
+    for (int i = 0; i < 3; ++i)
+    {
+        CarveResponse response = client.carve(request);
+        ASSERT_TRUE(response.success) << response.error;
+
+        Image result;
+        result.loadFromMemory(response.imageBytes.data(), response.imageBytes.size());
+        EXPECT_EQ(35, result.getRawImageData().getWidth());
+        EXPECT_EQ(28, result.getRawImageData().getHeight());
+    }
+
+    CarveRequest badRequest;
+    badRequest.imageBytes = {0, 1, 2, 3};
+    CarveResponse badResponse = client.carve(badRequest);
+    EXPECT_FALSE(badResponse.success);
+    EXPECT_FALSE(badResponse.error.empty());
+
+    ServerStats stats = client.stats();
+    EXPECT_EQ(4, stats.requests);
+    EXPECT_EQ(1, stats.failures);
+    EXPECT_LE(stats.minSeconds, stats.maxSeconds);
+    EXPECT_GT(stats.totalSeconds, 0.0);
+
+    server.stop();
+    EXPECT_THROW(Client{socketPath}, std::runtime_error);
+}
+
+TEST(ServerTest, IdleConnectionsDoNotHoldWorkers)
+{
+    // A single worker, with more persistent clients than workers sitting idle between requests
+    Server server(socketPath, 1);
+    server.start();
+
+    CarveRequest request;
+    request.imageBytes = Image(gradientImage(20, 16)).writeToMemory(ImageFormat::Png);
+    request.targetWidth = 18;
+    request.targetHeight = 16;
+
+    Client idleFirst(socketPath);
+    Client idleSecond(socketPath);
+    ASSERT_TRUE(idleFirst.carve(request).success);
+    ASSERT_TRUE(idleSecond.carve(request).success);
+
+    Client active(socketPath);
+    for (int i = 0; i < 3; ++i)
+    {
+        EXPECT_TRUE(active.carve(request).success);
+    }
+
+    // The idle clients are still served afterwards
+    EXPECT_TRUE(idleFirst.carve(request).success);
+    EXPECT_EQ(6u, idleSecond.stats().requests);
+}
+
+TEST(ServerTest, ClientsThatStopReadingDoNotHoldWorkers)
+{
+    Server server(socketPath, 1);
+    server.start();
+
+    // Ask for an uncompressed result far larger than the socket buffers, then never read it
+    std::vector<unsigned char> image = Image(gradientImage(800, 800)).writeToMemory(ImageFormat::Png);
+    struct
+    {
+        uint32_t magic, type, targetWidth, targetHeight, outputFormat, reserved;
+        uint64_t payloadLength;
+    } header = {0x51524353, 1, 799, 800, static_cast<uint32_t>(ImageFormat::Pam), 0, image.size()};
+
+    int stalled = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, socketPath, sizeof(address.sun_path) - 1);
+    ASSERT_EQ(0, ::connect(stalled, reinterpret_cast<sockaddr *>(&address), sizeof(address)));
+    ASSERT_EQ(static_cast<ssize_t>(sizeof(header)), ::write(stalled, &header, sizeof(header)));
+    ASSERT_EQ(static_cast<ssize_t>(image.size()), ::write(stalled, image.data(), image.size()));
+
+    // Once the stalled request is answered, the only worker is free for everyone else
+    Client active(socketPath);
+    while (active.stats().requests == 0)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    CarveRequest request;
+    request.imageBytes = Image(gradientImage(20, 16)).writeToMemory(ImageFormat::Png);
+    request.targetWidth = 18;
+    request.targetHeight = 16;
+    for (int i = 0; i < 2; ++i)
+    {
+        EXPECT_TRUE(active.carve(request).success);
+    }
+
+    // Stopping does not wait for the stalled client either
+    server.stop();
+    ::close(stalled);
+}
+
+TEST(ServerTest, OnlyReplacesStaleSockets)
+{
+    const char *path = "test_images/seamcarve_path_test.sock";
+    ::unlink(path);
+
+    // A regular file is never deleted
+    {
+        std::ofstream(path) << "keep";
+    }
+    EXPECT_THROW(Server(path).start(), std::runtime_error);
+    EXPECT_TRUE(std::filesystem::is_regular_file(path));
+    ::unlink(path);
+
+    // Nor is the socket of a server that is still running
+    Server running(path, 1);
+    running.start();
+    EXPECT_THROW(Server(path).start(), std::runtime_error);
+    Client client(path);
+    EXPECT_EQ(0u, client.stats().requests);
+    running.stop();
+
+    // A socket left behind by a server that is gone is replaced
+    int stale = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+    ASSERT_EQ(0, ::bind(stale, reinterpret_cast<sockaddr *>(&address), sizeof(address)));
+    ::close(stale);
+    Server replacement(path, 1);
+    EXPECT_NO_THROW(replacement.start());
+    replacement.stop();
+}
+
+TEST(ServerTest, FailedStartRemovesItsSocket)
+{
+    const char *path = "test_images/seamcarve_start_test.sock";
+    ::unlink(path);
+
+    // Leave a single free descriptor, so the socket is bound but the wake-up pipe cannot be created
+    int lowestFree = ::dup(0);
+    ::close(lowestFree);
+    rlimit original;
+    ASSERT_EQ(0, ::getrlimit(RLIMIT_NOFILE, &original));
+    rlimit tight = original;
+    tight.rlim_cur = lowestFree + 1;
+    ASSERT_EQ(0, ::setrlimit(RLIMIT_NOFILE, &tight));
+
+    Server server(path, 1);
+    EXPECT_THROW(server.start(), std::runtime_error);
+    ::setrlimit(RLIMIT_NOFILE, &original);
+
+    EXPECT_FALSE(std::filesystem::exists(path));
+}
+
+TEST(ServerTest, RejectsEnlargement)
+{
+    CarveRequest request;
+    request.imageBytes = Image(gradientImage(10, 10)).writeToMemory(ImageFormat::Png);
+    request.targetWidth = 20;
+    request.targetHeight = 10;
+
+    CarveResponse response = Server::process(request);
+    EXPECT_FALSE(response.success);
+}
@@ -0,0 +1,83 @@
+#pragma once
+#ifndef STRONKIMAGE_TEST_IMAGES
+#define STRONKIMAGE_TEST_IMAGES
+
+#include <cstdint>
+#include <cstdlib>
+
+#include <StronkImage.h>
+
+// Deterministic images shared by the tests
+namespace TestImages
+{
+    using StronkImage::ImageData;
+    using StronkImage::Quantum;
+
+    // xorshift32, so every test image is the same on every platform
+    class Noise
+    {
+    private:
+        uint32_t state;
+
+    public:
+        explicit Noise(uint32_t seed) : state(seed ? seed : 1) {}
+
+        uint32_t next()
+        {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            return state;
+        }
+    };
+
+    // Smooth red and green ramps across and down the image, for tests that only need a valid image
+    inline ImageData gradientImage(int width, int height)
+    {
+        ImageData image(width, height);
+        for (int y = 0; y < height; ++y)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                image.setPixel(x, y, {static_cast<Quantum>((x * 255) / width), static_cast<Quantum>((y * 255) / height), 128, 255});
+            }
+        }
+        return image;
+    }
+
+    // A diagonal gradient with up to 31 levels of noise per channel
+    inline ImageData noisyImage(int width, int height, uint32_t seed)
+    {
+        ImageData image(width, height);
+        Noise noise(seed);
+        for (int y = 0; y < height; ++y)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                uint32_t sample = noise.next();
+                Quantum base = static_cast<Quantum>((x * 4 + y * 2) % 200);
+                image.setPixel(x, y, {base + (sample & 31), base + ((sample >> 8) & 31), base + ((sample >> 16) & 31), 255});
+            }
+        }
+        return image;
+    }
+
+    // A noisy dark frame with a bright vertical bar at barX, so seams have structure to follow between frames
+    inline ImageData barFrame(int width, int height, int barX, uint32_t seed)
+    {
+        ImageData frame(width, height);
+        Noise noise(seed);
+        for (int y = 0; y < height; ++y)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                Quantum level = noise.next() % 24;
+                Quantum value = std::abs(x - barX) < 3 ? 230 - level : 40 + level;
+                frame.setPixel(x, y, {value, value, static_cast<Quantum>(value / 2), 255});
+            }
+        }
+        return frame;
+    }
+}
+
+#endif
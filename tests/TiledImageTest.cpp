@@ -0,0 +1,105 @@
+#include <StronkImage.h>
+#include <gtest/gtest.h>
+
+#include "TestImages.h"
+
+using namespace StronkImage;
+using TestImages::noisyImage;
+
+TEST(TiledImageTest, RoundTripsAndRemovesSeams)
+{
+    ImageData imageData = noisyImage(23, 11, 5);
+    TiledImage tiled = TiledImage::fromImageData(imageData);
+
+    ASSERT_EQ(23u, tiled.width);
+    ASSERT_EQ(92u, tiled.pitch());
+
+    std::vector<int> seam(11);
+    for (int y = 0; y < 11; ++y)
+    {
+        seam[y] = (y * 3) % 23;
+    }
+    imageData.removeSeam(seam);
+    tiled.removeSeam(seam, 2);
+
+    // Rows keep their pitch, the contents match the in-memory compaction
+    ASSERT_EQ(92u, tiled.pitch());
+    ImageData roundTrip = tiled.toImageData();
+    ASSERT_EQ(22u, roundTrip.getWidth());
+    for (int y = 0; y < 11; ++y)
+    {
+        for (int x = 0; x < 22; ++x)
+        {
+            ASSERT_EQ(imageData.getPixel(x, y), roundTrip.getPixel(x, y));
+        }
+    }
+}
+
+TEST(TiledImageTest, RemoveSeamRejectsBadEntriesUpFront)
+{
+    ImageData imageData = noisyImage(6, 4, 8);
+    TiledImage tiled = TiledImage::fromImageData(imageData);
+
+    // The bad entry is in the last row, after the rows a shifting pass would already have moved
+    EXPECT_THROW(tiled.removeSeam({1, 2, 3, 6}), std::out_of_range);
+    EXPECT_THROW(tiled.removeSeam({1, -1, 3, 2}), std::out_of_range);
+    EXPECT_THROW(tiled.removeSeam({1, 2, 3}), std::invalid_argument);
+
+    ASSERT_EQ(6u, tiled.width);
+    EXPECT_EQ(hashPixels(imageData), hashPixels(tiled.toImageData()));
+}
+
+TEST(TiledImageTest, StreamedEnergyMatchesInMemoryPipeline)
+{
+    ImageData imageData = noisyImage(70, 45, 9);
+    ImageData expected = Carver::generateEnergyMap(imageData);
+
+    // A tiny band forces evictions between every few rows
+    TiledCarveOptions options;
+    options.bandBytes = 256;
+    TiledImage energy = TiledCarver::generateEnergyMap(TiledImage::fromImageData(imageData), options);
+
+    // The separable blur may round a channel differently from the 2D kernel, nothing more
+    int differing = 0;
+    for (int y = 0; y < 45; ++y)
+    {
+        for (int x = 0; x < 70; ++x)
+        {
+            int difference = std::abs(static_cast<int>(energy.row(y)[x]) - static_cast<int>(expected.getPixel(x, y).red));
+            ASSERT_LE(difference, 8) << x << "," << y;
+            differing += difference != 0;
+        }
+    }
+    EXPECT_LT(differing, 70 * 45 / 20);
+}
+
+TEST(TiledImageTest, SeamMatchesInMemorySearch)
+{
+    ImageData energyData = Carver::generateEnergyMap(noisyImage(41, 29, 3));
+    TiledImage energy(41, 29, 1);
+    for (int y = 0; y < 29; ++y)
+    {
+        for (int x = 0; x < 41; ++x)
+        {
+            energy.row(y)[x] = static_cast<uint8_t>(energyData.getPixel(x, y).red);
+        }
+    }
+
+    TiledImage directions((41 + 3) / 4, 29, 1);
+    EXPECT_EQ(Filter::findVerticalSeam(energyData), TiledCarver::findVerticalSeam(energy, directions, 4));
+}
+
+TEST(TiledImageTest, CarvesFileThroughScanlines)
+{
+    Image input(noisyImage(60, 30, 11));
+    input.writeToFile("test_images/tiled_input.png");
+
+    TiledCarveOptions options;
+    options.bandBytes = 1024;
+    options.scratchDirectory = "test_images";
+    TiledCarver::carveFile("test_images/tiled_input.png", "test_images/tiled_output.png", 12, options);
+
+    Image output("test_images/tiled_output.png");
+    EXPECT_EQ(48u, output.getRawImageData().getWidth());
+    EXPECT_EQ(30u, output.getRawImageData().getHeight());
+}